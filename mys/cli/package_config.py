@@ -1,3 +1,4 @@
+import glob
 import os
 import re
 
@@ -16,10 +17,34 @@ RE_SEMANTIC_VERSION = re.compile(
     r"(?:\+([0-9a-zA-Z-]+(?:\.[0-9a-zA-Z-]+)*))?$")
 
 
+# Builtin packages that are only added as dependencies when imported,
+# as building them takes time.
+OPTIONAL_BUILTIN_PACKAGES = ['file', 'net']
+
+RE_IMPORT_OPTIONAL_BUILTIN = re.compile(
+    r'^(?:from|import)\s+(' + '|'.join(OPTIONAL_BUILTIN_PACKAGES) + r')\b',
+    re.MULTILINE)
+
+
 def is_semantic_version(version):
     return RE_SEMANTIC_VERSION.match(version) is not None
 
 
+def imported_optional_builtin_packages(path):
+    """Returns optional builtin packages imported from by any source file
+    in given package.
+
+    """
+
+    names = set()
+
+    for src in glob.glob(os.path.join(path, 'src', '**', '*.mys'), recursive=True):
+        with open(src) as fin:
+            names.update(RE_IMPORT_OPTIONAL_BUILTIN.findall(fin.read()))
+
+    return sorted(names)
+
+
 class Author:
 
     def __init__(self, name, email):
@@ -74,6 +99,11 @@ class PackageConfig:
             'fiber': {'path': os.path.join(MYS_DIR, 'lib/packages/fiber')}
         }
 
+        for name in imported_optional_builtin_packages(path):
+            dependencies[name] = {
+                'path': os.path.join(MYS_DIR, 'lib/packages', name)
+            }
+
         if 'dependencies' in config:
             dependencies.update(config['dependencies'])
 
@@ -51,11 +51,18 @@ class PackagesFinder:
     def download_dependency_dependencies(self, config):
         packages = []
 
-        for name in config['dependencies']:
+        for name, info in config['dependencies'].items():
             if name not in self.handled_dependencies:
                 self.handled_dependencies.append(name)
-                packages.append(
-                    prepare_download_dependency_from_registry(name, 'latest'))
+
+                if isinstance(info, dict) and 'path' in info:
+                    self.download_dependency_dependencies(
+                        self.load_package_config(
+                            os.path.join(config.path, info['path']),
+                            info))
+                else:
+                    packages.append(
+                        prepare_download_dependency_from_registry(name, 'latest'))
 
         self.download_and_extract_dependencies(packages)
 
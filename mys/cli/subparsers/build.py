@@ -2,6 +2,7 @@ from ..utils import BuildConfig
 from ..utils import add_coverage_argument
 from ..utils import add_debug_symbols_argument
 from ..utils import add_jobs_argument
+from ..utils import add_multi_core_argument
 from ..utils import add_no_ccache_argument
 from ..utils import add_optimize_argument
 from ..utils import add_unsafe_argument
@@ -19,6 +20,7 @@ def do_build(_parser, args, _mys_config):
                                args.no_ccache,
                                args.coverage,
                                args.unsafe,
+                               args.multi_core,
                                args.jobs,
                                args.url)
     is_application, build_dir, _ = build_prepare(build_config)
@@ -37,4 +39,5 @@ def add_subparser(subparsers):
     add_url_argument(subparser)
     add_coverage_argument(subparser)
     add_unsafe_argument(subparser)
+    add_multi_core_argument(subparser)
     subparser.set_defaults(func=do_build)
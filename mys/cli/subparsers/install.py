@@ -114,6 +114,7 @@ def do_install(_parser, args, _mys_config):
                                args.no_ccache,
                                False,
                                True,
+                               False,
                                args.jobs,
                                args.url)
     root = os.path.abspath(os.path.expanduser(args.root))
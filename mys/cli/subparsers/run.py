@@ -10,6 +10,7 @@ from ..utils import BuildConfig
 from ..utils import add_coverage_argument
 from ..utils import add_debug_symbols_argument
 from ..utils import add_jobs_argument
+from ..utils import add_multi_core_argument
 from ..utils import add_no_ccache_argument
 from ..utils import add_optimize_argument
 from ..utils import add_unsafe_argument
@@ -44,6 +45,7 @@ def do_run(_parser, args, _mys_config):
                                args.no_ccache,
                                args.coverage,
                                args.unsafe,
+                               args.multi_core,
                                args.jobs,
                                args.url)
     is_application, build_dir, _ = build_prepare(build_config)
@@ -80,5 +82,6 @@ def add_subparser(subparsers):
     add_url_argument(subparser)
     add_coverage_argument(subparser)
     add_unsafe_argument(subparser)
+    add_multi_core_argument(subparser)
     subparser.add_argument('args', nargs='*')
     subparser.set_defaults(func=do_run)
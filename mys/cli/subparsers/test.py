@@ -4,6 +4,7 @@ from ..run import run
 from ..utils import BuildConfig
 from ..utils import add_coverage_argument
 from ..utils import add_jobs_argument
+from ..utils import add_multi_core_argument
 from ..utils import add_no_ccache_argument
 from ..utils import add_optimize_argument
 from ..utils import add_unsafe_argument
@@ -21,6 +22,7 @@ def do_test(_parser, args, _mys_config):
                                args.no_ccache,
                                args.coverage,
                                args.unsafe,
+                               args.multi_core,
                                args.jobs,
                                args.url)
     _, build_dir, _ = build_prepare(build_config)
@@ -41,6 +43,9 @@ def do_test(_parser, args, _mys_config):
     if args.unsafe:
         command += ['UNSAFE=yes']
 
+    if args.multi_core:
+        command += ['MULTI_CORE=yes']
+
     if args.optimize == 'debug':
         command += ['TRACEBACK=yes']
 
@@ -67,6 +72,7 @@ def add_subparser(subparsers):
     add_url_argument(subparser)
     add_coverage_argument(subparser)
     add_unsafe_argument(subparser)
+    add_multi_core_argument(subparser)
     subparser.add_argument(
         'test_pattern',
         nargs='?',
@@ -1,5 +1,6 @@
 import os
 
+from ...transpiler import Features
 from ...transpiler import Source
 from ...transpiler import transpile
 from ..utils import add_coverage_argument
@@ -32,7 +33,8 @@ def do_transpile(_parser, args, _mys_config):
                                   cpp_path,
                                   args.main[i] == 'yes'))
 
-    generated = transpile(sources, args.coverage)
+    features = Features()
+    generated = transpile(sources, args.coverage, features)
 
     for source, (hpp_1_code, hpp_2_code, cpp_code) in zip(sources, generated):
         os.makedirs(os.path.dirname(source.hpp_path), exist_ok=True)
@@ -41,6 +43,28 @@ def do_transpile(_parser, args, _mys_config):
         create_file(source.hpp_path, hpp_2_code)
         create_file(source.cpp_path, cpp_code)
 
+    create_features_file(os.path.join(args.outdir, 'include', 'mys_features.hpp'),
+                         features)
+
+
+def create_features_file(path, features):
+    """Create given features header, unless it already has given
+    features, as all objects are rebuilt when it is changed.
+
+    """
+
+    code = features.format_hpp()
+
+    try:
+        with open(path, 'r') as fin:
+            if fin.read() == code:
+                return
+    except FileNotFoundError:
+        pass
+
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    create_file(path, code)
+
 
 def add_subparser(subparsers):
     subparser = subparsers.add_parser(
@@ -55,6 +55,7 @@ class BuildConfig:
                  no_ccache,
                  coverage,
                  unsafe,
+                 multi_core,
                  jobs,
                  url):
         self.debug = debug
@@ -64,6 +65,7 @@ class BuildConfig:
         self.no_ccache = no_ccache
         self.coverage = coverage
         self.unsafe = unsafe
+        self.multi_core = multi_core
         self.jobs = jobs
         self.url = url
 
@@ -235,6 +237,9 @@ def create_makefile(config, dependencies_configs, build_config):
     if build_config.unsafe:
         combo += '-unsafe'
 
+    if build_config.multi_core:
+        combo += '-multi-core'
+
     build_dir = f'build/{combo}'
 
     os.makedirs(f'{build_dir}/cpp', exist_ok=True)
@@ -390,6 +395,9 @@ def build_app(build_config, is_application, build_dir):
     if build_config.unsafe:
         command += ['UNSAFE=yes']
 
+    if build_config.multi_core:
+        command += ['MULTI_CORE=yes']
+
     if build_config.optimize == 'debug':
         command += ['TRACEBACK=yes']
 
@@ -451,6 +459,13 @@ def add_unsafe_argument(subparser):
         help='Less runtime checks in favour of better performance.')
 
 
+def add_multi_core_argument(subparser):
+    subparser.add_argument(
+        '--multi-core',
+        action='store_true',
+        help='Run fibers on all CPU cores instead of only one.')
+
+
 def _add_lines(coverage_data, path, linenos):
     coverage_data.add_lines(
         {path: {lineno: None for lineno in linenos}})
@@ -1,7 +1,345 @@
+#include <cstring>
+#include <cxxabi.h>
+#include <iomanip>
+#include <mutex>
+#include <sys/mman.h>
+#include <thread>
+#include <typeinfo>
+#include <unistd.h>
 #include "mys.hpp"
 
+#if defined(MYS_MULTI_CORE)
+#    include <atomic>
+#endif
+
+// Fibers switch stacks in user space. Hand-written assembly is used on
+// x86-64 and AArch64 ELF targets, ucontext everywhere else. Define
+// MYS_FIBER_UCONTEXT to always use ucontext.
+#if !defined(MYS_FIBER_UCONTEXT)
+#    if !defined(__ELF__) || !(defined(__x86_64__) || defined(__aarch64__))
+#        define MYS_FIBER_UCONTEXT
+#    endif
+#endif
+
+#if defined(MYS_FIBER_UCONTEXT)
+#    include <ucontext.h>
+#else
+extern "C" {
+
+// Pushes callee-saved registers on current stack, stores the stack
+// pointer in *from_sp_p and pops the registers of the fiber to
+// continue from to_sp.
+void mys_fiber_switch(void **from_sp_p, void *to_sp);
+
+}
+
+#    if defined(__x86_64__)
+asm(R"(
+    .pushsection .text
+    .globl mys_fiber_switch
+    .hidden mys_fiber_switch
+    .type mys_fiber_switch, @function
+    .p2align 4
+mys_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size mys_fiber_switch, .-mys_fiber_switch
+    .popsection
+)");
+#    else
+asm(R"(
+    .pushsection .text
+    .globl mys_fiber_switch
+    .hidden mys_fiber_switch
+    .type mys_fiber_switch, %function
+    .p2align 4
+mys_fiber_switch:
+    sub sp, sp, #160
+    stp x19, x20, [sp, #0]
+    stp x21, x22, [sp, #16]
+    stp x23, x24, [sp, #32]
+    stp x25, x26, [sp, #48]
+    stp x27, x28, [sp, #64]
+    stp x29, x30, [sp, #80]
+    stp d8, d9, [sp, #96]
+    stp d10, d11, [sp, #112]
+    stp d12, d13, [sp, #128]
+    stp d14, d15, [sp, #144]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp x19, x20, [sp, #0]
+    ldp x21, x22, [sp, #16]
+    ldp x23, x24, [sp, #32]
+    ldp x25, x26, [sp, #48]
+    ldp x27, x28, [sp, #64]
+    ldp x29, x30, [sp, #80]
+    ldp d8, d9, [sp, #96]
+    ldp d10, d11, [sp, #112]
+    ldp d12, d13, [sp, #128]
+    ldp d14, d15, [sp, #144]
+    add sp, sp, #160
+    ret
+    .size mys_fiber_switch, .-mys_fiber_switch
+    .popsection
+)");
+#    endif
+#endif
+
+// Default virtual size of fiber stacks, excluding the guard page.
+// Memory is only committed when used.
+#if !defined(MYS_FIBER_STACK_SIZE)
+#    define MYS_FIBER_STACK_SIZE (1024 * 1024)
+#endif
+
+#if !defined(MYS_FIBER_STACK_SIZE_MIN)
+#    define MYS_FIBER_STACK_SIZE_MIN (16 * 1024)
+#endif
+
+// Fiber priorities, lower values run first. The idle fiber has the
+// lowest priority.
+#define MYS_FIBER_PRIOS 128
+#define MYS_FIBER_PRIO_IDLE (MYS_FIBER_PRIOS - 1)
+
+// Maximum number of unused stacks kept for reuse.
+#if !defined(MYS_FIBER_STACK_POOL_SIZE)
+#    define MYS_FIBER_STACK_POOL_SIZE 1024
+#endif
+
 namespace mys {
 
+// Per-thread C++ exception handling state. It is swapped with the
+// stack as fibers may be suspended in catch blocks.
+struct ExceptionGlobals {
+    void *caught_exceptions_p;
+    unsigned int uncaught_exceptions;
+};
+
+static ExceptionGlobals *exception_globals()
+{
+    return (ExceptionGlobals *)abi::__cxa_get_globals();
+}
+
+// A mmap-ed stack with a guard page at its lowest address.
+struct FiberStack {
+    void *base_p;
+    size_t size;
+
+    FiberStack()
+    {
+        base_p = NULL;
+        size = 0;
+    }
+
+    char *top() const
+    {
+        return (char *)base_p + size;
+    }
+};
+
+// Stacks of stopped fibers are kept for reuse by new fibers with the
+// same stack size, up to MYS_FIBER_STACK_POOL_SIZE stacks. All workers
+// get and put stacks in multi-core applications, so the free stacks
+// and the statistics are locked.
+class StackPool {
+private:
+    std::unordered_map<size_t, std::vector<void *>> m_free;
+    size_t m_page_size;
+#if defined(MYS_MULTI_CORE)
+    std::mutex m_mutex;
+#endif
+
+    void map(FiberStack& stack)
+    {
+        stack.base_p = mmap(NULL,
+                            stack.size,
+                            PROT_READ | PROT_WRITE,
+#if defined(MAP_STACK)
+                            MAP_STACK |
+#endif
+#if defined(MAP_NORESERVE)
+                            MAP_NORESERVE |
+#endif
+                            MAP_PRIVATE | MAP_ANONYMOUS,
+                            -1,
+                            0);
+
+        // Each stack is two memory mappings, limited by
+        // vm.max_map_count on Linux.
+        if ((stack.base_p == MAP_FAILED)
+            || (mprotect(stack.base_p, m_page_size, PROT_NONE) != 0)) {
+            print_traceback();
+            std::cerr
+                << "\nPanic(message=\"Fiber stack allocation failed after "
+                << m_statistics.in_use
+                << " stacks. Too many fibers?\")\n";
+            abort();
+        }
+    }
+
+    StackPoolStatistics m_statistics;
+
+public:
+    StackPool()
+    {
+        m_page_size = sysconf(_SC_PAGESIZE);
+        m_statistics.in_use = 0;
+        m_statistics.free = 0;
+        m_statistics.allocated = 0;
+        m_statistics.reused = 0;
+    }
+
+    // Get a stack with at least given usable size.
+    void get(FiberStack& stack, size_t stack_size)
+    {
+#if defined(MYS_MULTI_CORE)
+        std::lock_guard<std::mutex> guard(m_mutex);
+#endif
+
+        if (stack_size == 0) {
+            stack_size = MYS_FIBER_STACK_SIZE;
+        } else if (stack_size < MYS_FIBER_STACK_SIZE_MIN) {
+            stack_size = MYS_FIBER_STACK_SIZE_MIN;
+        }
+
+        stack.size = m_page_size + ((stack_size + m_page_size - 1)
+                                    & ~(m_page_size - 1));
+        auto& free = m_free[stack.size];
+
+        if (free.empty()) {
+            map(stack);
+            m_statistics.allocated++;
+        } else {
+            stack.base_p = free.back();
+            free.pop_back();
+            m_statistics.free--;
+            m_statistics.reused++;
+        }
+
+        m_statistics.in_use++;
+    }
+
+    void put(FiberStack& stack)
+    {
+        if (stack.base_p == NULL) {
+            return;
+        }
+
+#if defined(MYS_MULTI_CORE)
+        std::lock_guard<std::mutex> guard(m_mutex);
+#endif
+
+        if (m_statistics.free < MYS_FIBER_STACK_POOL_SIZE) {
+            m_free[stack.size].push_back(stack.base_p);
+            m_statistics.free++;
+        } else {
+            munmap(stack.base_p, stack.size);
+        }
+
+        stack.base_p = NULL;
+        m_statistics.in_use--;
+    }
+
+    StackPoolStatistics statistics()
+    {
+#if defined(MYS_MULTI_CORE)
+        std::lock_guard<std::mutex> guard(m_mutex);
+#endif
+
+        return m_statistics;
+    }
+};
+
+// Never destroyed, as fibers may still run on other threads when the
+// application exits.
+static StackPool& stack_pool = *new StackPool();
+
+#if defined(MYS_MULTI_CORE)
+
+struct Worker;
+
+#endif
+
+// Counts of durations in buckets of powers of two microseconds, as
+// described for SchedulerStatistics.
+class Histogram {
+private:
+#if defined(MYS_MULTI_CORE)
+    std::atomic<u64> m_buckets[MYS_HISTOGRAM_BUCKETS];
+#else
+    u64 m_buckets[MYS_HISTOGRAM_BUCKETS];
+#endif
+
+public:
+    Histogram()
+    {
+        reset();
+    }
+
+    void add(u64 nanoseconds)
+    {
+        u64 microseconds = nanoseconds / 1000;
+        int bucket = 0;
+
+        if (microseconds > 0) {
+            bucket = std::min(64 - __builtin_clzll(microseconds),
+                              MYS_HISTOGRAM_BUCKETS - 1);
+        }
+
+        m_buckets[bucket]++;
+    }
+
+    void reset()
+    {
+        for (int i = 0; i < MYS_HISTOGRAM_BUCKETS; i++) {
+            m_buckets[i] = 0;
+        }
+    }
+
+    void get(u64 *buckets_p)
+    {
+        for (int i = 0; i < MYS_HISTOGRAM_BUCKETS; i++) {
+            buckets_p[i] = m_buckets[i];
+        }
+    }
+};
+
+// Statistics are only recorded when enabled, so that the scheduler
+// only checks this flag when disabled.
+#if defined(MYS_MULTI_CORE)
+static std::atomic<bool> statistics_enabled(false);
+#else
+static bool statistics_enabled = false;
+#endif
+static Histogram& ready_latency = *new Histogram();
+static Histogram& idle_time = *new Histogram();
+
+struct SchedulerFiber;
+
+// All scheduler fibers, for printing statistics.
+static std::vector<SchedulerFiber *>& scheduler_fibers =
+    *new std::vector<SchedulerFiber *>();
+static SpinLock& scheduler_fibers_lock = *new SpinLock();
+
 struct SchedulerFiber {
     enum State {
         CURRENT = 0,
@@ -11,343 +349,2119 @@ struct SchedulerFiber {
         STOPPED
     };
 
-    mys::shared_ptr<Fiber> m_fiber;
-    uv_thread_t thread;
-    uv_cond_t cond;
-    SchedulerFiber *next_p;
-    SchedulerFiber *waiter_p;
-    int prio;
-    State state;
-    uv_timer_t handle;
-    TracebackEntry *traceback_top_p;
-    TracebackEntry *traceback_bottom_p;
-    bool cancelled;
-    int signum;
+    mys::shared_ptr<Fiber> m_fiber;
+#if defined(MYS_FIBER_UCONTEXT)
+    ucontext_t context;
+#else
+    void *sp;
+#endif
+    FiberStack stack;
+    ExceptionGlobals exception_globals;
+    SchedulerFiber *next_p;
+    int prio;
+    TracebackEntry *traceback_top_p;
+    TracebackEntry *traceback_bottom_p;
+    // Protects the state, joiners and flags below in multi-core builds,
+    // as the fiber may be resumed and cancelled from any thread.
+    SpinLock lock;
+    State state;
+    // Fibers waiting for this fiber to stop.
+    WaitList joiners;
+    bool cancelled;
+    int signum;
+#if defined(MYS_MULTI_CORE)
+    // Worker that last ran the fiber.
+    Worker *worker_p;
+    // Resumed while running, so the next suspend returns at once.
+    bool resume_pending;
+#endif
+    // Mangled class name of the fiber.
+    const char *name_p;
+    FiberStatistics statistics;
+    // When the fiber was last made ready and switched to.
+    u64 ready_timestamp;
+    u64 run_timestamp;
+
+    SchedulerFiber(const mys::shared_ptr<Fiber>& fiber)
+    {
+#if defined(MYS_MULTI_CORE)
+        worker_p = NULL;
+#endif
+        reset(fiber);
+
+        // Worker contexts have no fiber.
+        if (fiber) {
+            std::lock_guard<SpinLock> guard(scheduler_fibers_lock);
+            scheduler_fibers.push_back(this);
+        }
+    }
+
+    void reset(const mys::shared_ptr<Fiber>& fiber)
+    {
+        m_fiber = fiber;
+        state = State::SUSPENDED;
+        prio = 0;
+        cancelled = false;
+        signum = -1;
+#if defined(MYS_MULTI_CORE)
+        resume_pending = false;
+#endif
+        name_p = fiber ? typeid(*fiber.get()).name() : "";
+        reset_statistics(uv_hrtime());
+    }
+
+    void reset_statistics(u64 now)
+    {
+        memset(&statistics, 0, sizeof(statistics));
+        ready_timestamp = now;
+        run_timestamp = now;
+    }
+};
+
+// Ready fibers in one FIFO per priority, with a bit per priority
+// telling which FIFOs are non-empty. Priority 0 is the most
+// significant bit of the first word, so counting leading zeros finds
+// the highest priority, that is the lowest value.
+class ReadyQueue {
+private:
+    struct Fifo {
+        SchedulerFiber *head_p;
+        SchedulerFiber *tail_p;
+    };
+
+    Fifo m_fifos[MYS_FIBER_PRIOS];
+    u64 m_bitmap[MYS_FIBER_PRIOS / 64];
+    size_t m_size;
+
+public:
+    ReadyQueue()
+    {
+        memset(&m_fifos[0], 0, sizeof(m_fifos));
+        memset(&m_bitmap[0], 0, sizeof(m_bitmap));
+        m_size = 0;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    size_t size() const
+    {
+        return m_size;
+    }
+
+    void push(SchedulerFiber *fiber_p)
+    {
+        int prio = fiber_p->prio;
+        Fifo& fifo = m_fifos[prio];
+
+        fiber_p->next_p = NULL;
+
+        if (fifo.tail_p == NULL) {
+            fifo.head_p = fiber_p;
+            m_bitmap[prio / 64] |= (1ULL << 63) >> (prio % 64);
+        } else {
+            fifo.tail_p->next_p = fiber_p;
+        }
+
+        fifo.tail_p = fiber_p;
+        m_size++;
+    }
+
+    // Remove and return the first fiber with highest priority, or
+    // NULL if empty.
+    SchedulerFiber *pop()
+    {
+        int prio;
+
+        for (prio = 0; prio < MYS_FIBER_PRIOS; prio += 64) {
+            if (m_bitmap[prio / 64] != 0) {
+                break;
+            }
+        }
+
+        if (prio == MYS_FIBER_PRIOS) {
+            return NULL;
+        }
+
+        prio += __builtin_clzll(m_bitmap[prio / 64]);
+        Fifo& fifo = m_fifos[prio];
+        SchedulerFiber *fiber_p = fifo.head_p;
+
+        fifo.head_p = fiber_p->next_p;
+
+        if (fifo.head_p == NULL) {
+            fifo.tail_p = NULL;
+            m_bitmap[prio / 64] &= ~((1ULL << 63) >> (prio % 64));
+        }
+
+        m_size--;
+
+        return fiber_p;
+    }
+};
+
+// Scheduler fibers of destroyed fibers, reused by new fibers. Fibers
+// are created and destroyed on all workers in multi-core applications.
+static std::vector<SchedulerFiber *>& free_scheduler_fibers =
+    *new std::vector<SchedulerFiber *>();
+#if defined(MYS_MULTI_CORE)
+static SpinLock& free_scheduler_fibers_lock = *new SpinLock();
+#endif
+
+// Called when given fiber is made ready to run.
+static void record_ready(SchedulerFiber *fiber_p)
+{
+    if (statistics_enabled) {
+        fiber_p->ready_timestamp = uv_hrtime();
+    }
+}
+
+// Called when switching to given fiber, with statistics enabled.
+static void record_switch_in(SchedulerFiber *fiber_p, u64 now)
+{
+    u64 latency = now - fiber_p->ready_timestamp;
+
+    fiber_p->statistics.ready_time += latency;
+    fiber_p->statistics.switches_in++;
+    fiber_p->run_timestamp = now;
+
+    // The idle fiber is ready whenever other fibers are.
+    if (fiber_p->prio != MYS_FIBER_PRIO_IDLE) {
+        ready_latency.add(latency);
+    }
+}
+
+// Called when switching from given fiber, with statistics enabled.
+static void record_switch_out(SchedulerFiber *fiber_p, u64 now)
+{
+    fiber_p->statistics.run_time += now - fiber_p->run_timestamp;
+    fiber_p->statistics.switches_out++;
+}
+
+static void start_fiber_main();
+
+// Prepare given fiber to run given function on a stack from the pool
+// the first time it is switched to.
+static void init_context(SchedulerFiber *fiber_p,
+                         size_t stack_size,
+                         void (*entry)())
+{
+    stack_pool.get(fiber_p->stack, stack_size);
+#if defined(MYS_FIBER_UCONTEXT)
+    getcontext(&fiber_p->context);
+    fiber_p->context.uc_stack.ss_sp = fiber_p->stack.base_p;
+    fiber_p->context.uc_stack.ss_size = fiber_p->stack.size;
+    fiber_p->context.uc_link = NULL;
+    makecontext(&fiber_p->context, entry, 0);
+#elif defined(__x86_64__)
+    // Registers popped by mys_fiber_switch(), MXCSR and x87 control
+    // word defaults, and the return address. The stack is aligned as
+    // if the entry function was called.
+    u64 *sp_p = (u64 *)fiber_p->stack.top() - 9;
+
+    memset(sp_p, 0, 9 * sizeof(u64));
+    sp_p[0] = 0x1f80 | (0x037fULL << 32);
+    sp_p[7] = (u64)entry;
+    fiber_p->sp = sp_p;
+#else
+    // Registers loaded by mys_fiber_switch(), with the link register
+    // pointing to the entry function.
+    u64 *sp_p = (u64 *)fiber_p->stack.top() - 20;
+
+    memset(sp_p, 0, 20 * sizeof(u64));
+    sp_p[11] = (u64)entry;
+    fiber_p->sp = sp_p;
+#endif
+}
+
+static void switch_context(SchedulerFiber *in_p, SchedulerFiber *out_p)
+{
+#if defined(MYS_FIBER_UCONTEXT)
+    swapcontext(&out_p->context, &in_p->context);
+#else
+    mys_fiber_switch(&out_p->sp, in_p->sp);
+#endif
+}
+
+#if defined(MYS_MULTI_CORE)
+
+// Fibers run on one worker thread per core. Each worker has its own
+// run queue and steals from other workers when it runs out of fibers.
+// Fibers yield to their worker's scheduler context, which puts them
+// back in a run queue once they are no longer running on their stack.
+// All I/O and timers are handled by one reactor thread running the
+// libuv loop.
+
+enum class SwitchReason {
+    YIELD,
+    SUSPEND,
+    STOP
+};
+
+struct Worker {
+    size_t index;
+    SchedulerFiber *current_p;
+    // The worker's own context, running schedule().
+    SchedulerFiber *scheduler_p;
+    SwitchReason reason;
+    ExceptionGlobals *exception_globals_p;
+    std::mutex mutex;
+    ReadyQueue ready;
+};
+
+static thread_local Worker *this_worker_p = NULL;
+
+// A fiber may continue on another thread after a context switch, so
+// the current worker must not be cached over switches.
+static __attribute__((noinline)) Worker *this_worker()
+{
+    asm volatile("" ::: "memory");
+
+    return this_worker_p;
+}
+
+static __attribute__((noinline)) void save_traceback(SchedulerFiber *fiber_p)
+{
+    fiber_p->traceback_top_p = mys::traceback_top_p;
+    fiber_p->traceback_bottom_p = mys::traceback_bottom_p;
+}
+
+static __attribute__((noinline)) void restore_traceback(SchedulerFiber *fiber_p)
+{
+    mys::traceback_top_p = fiber_p->traceback_top_p;
+    mys::traceback_bottom_p = fiber_p->traceback_bottom_p;
+}
+
+struct Scheduler {
+    std::vector<Worker *> workers;
+    // Number of fibers in all run queues.
+    std::atomic<int> number_of_ready;
+    std::atomic<int> number_of_idle;
+    uv_mutex_t idle_mutex;
+    uv_cond_t idle_cond;
+    // Functions to call in the reactor thread.
+    std::mutex calls_mutex;
+    std::vector<std::function<void()>> calls;
+    uv_async_t calls_async;
+
+    Scheduler()
+        : number_of_ready(0), number_of_idle(0)
+    {
+        uv_mutex_init(&idle_mutex);
+        uv_cond_init(&idle_cond);
+    }
+
+    // Called with the fiber's lock held.
+    void ready_push(SchedulerFiber *fiber_p)
+    {
+        Worker *worker_p = this_worker();
+
+        if (worker_p == NULL) {
+            worker_p = fiber_p->worker_p;
+
+            if (worker_p == NULL) {
+                worker_p = workers[0];
+            }
+        }
+
+        fiber_p->state = SchedulerFiber::State::READY;
+        record_ready(fiber_p);
+
+        {
+            std::lock_guard<std::mutex> guard(worker_p->mutex);
+            worker_p->ready.push(fiber_p);
+        }
+
+        number_of_ready++;
+
+        if (number_of_idle > 0) {
+            uv_mutex_lock(&idle_mutex);
+            uv_cond_signal(&idle_cond);
+            uv_mutex_unlock(&idle_mutex);
+        }
+    }
+
+    SchedulerFiber *ready_pop(Worker *worker_p)
+    {
+        SchedulerFiber *fiber_p;
+        std::lock_guard<std::mutex> guard(worker_p->mutex);
+
+        fiber_p = worker_p->ready.pop();
+
+        if (fiber_p != NULL) {
+            number_of_ready--;
+        }
+
+        return fiber_p;
+    }
+
+    // Move half of the fibers in another worker's run queue to given
+    // worker's run queue.
+    bool steal(Worker *worker_p)
+    {
+        size_t number_of_workers = workers.size();
+
+        for (size_t i = 1; i < number_of_workers; i++) {
+            Worker *victim_p = workers[(worker_p->index + i) % number_of_workers];
+            std::vector<SchedulerFiber *> stolen;
+
+            {
+                std::lock_guard<std::mutex> guard(victim_p->mutex);
+                size_t count = (victim_p->ready.size() + 1) / 2;
+
+                while (count > 0) {
+                    stolen.push_back(victim_p->ready.pop());
+                    count--;
+                }
+            }
+
+            if (!stolen.empty()) {
+                std::lock_guard<std::mutex> guard(worker_p->mutex);
+
+                for (auto fiber_p : stolen) {
+                    worker_p->ready.push(fiber_p);
+                }
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Next fiber for given worker to run. Waits for one if there is
+    // none.
+    SchedulerFiber *take(Worker *worker_p)
+    {
+        SchedulerFiber *fiber_p;
+
+        while (true) {
+            fiber_p = ready_pop(worker_p);
+
+            if (fiber_p != NULL) {
+                return fiber_p;
+            }
+
+            if (steal(worker_p)) {
+                continue;
+            }
+
+            u64 idle_start = statistics_enabled ? uv_hrtime() : 0;
+
+            uv_mutex_lock(&idle_mutex);
+            number_of_idle++;
+
+            while (number_of_ready == 0) {
+                uv_cond_wait(&idle_cond, &idle_mutex);
+            }
+
+            number_of_idle--;
+            uv_mutex_unlock(&idle_mutex);
+
+            if (idle_start != 0) {
+                idle_time.add(uv_hrtime() - idle_start);
+            }
+        }
+    }
+
+    // Runs fibers forever in given worker's scheduler context.
+    void schedule(Worker *worker_p)
+    {
+        SchedulerFiber *fiber_p;
+
+        worker_p->exception_globals_p = exception_globals();
+
+        while (true) {
+            // The main thread's worker is first switched to by the main
+            // fiber.
+            fiber_p = worker_p->current_p;
+
+            if (fiber_p != NULL) {
+                worker_p->current_p = NULL;
+                switched_out(fiber_p, worker_p->reason);
+            }
+
+            fiber_p = take(worker_p);
+
+            if (statistics_enabled) {
+                record_switch_in(fiber_p, uv_hrtime());
+            }
+
+            fiber_p->lock.lock();
+            fiber_p->state = SchedulerFiber::State::CURRENT;
+            fiber_p->worker_p = worker_p;
+            fiber_p->lock.unlock();
+            worker_p->current_p = fiber_p;
+            switch_context(fiber_p, worker_p->scheduler_p);
+        }
+    }
+
+    // Called by the worker once the fiber no longer runs on its stack.
+    void switched_out(SchedulerFiber *fiber_p, SwitchReason reason)
+    {
+        if (statistics_enabled) {
+            record_switch_out(fiber_p, uv_hrtime());
+        }
+
+        switch (reason) {
+
+        case SwitchReason::YIELD:
+            fiber_p->lock.lock();
+            ready_push(fiber_p);
+            fiber_p->lock.unlock();
+            break;
+
+        case SwitchReason::SUSPEND:
+            fiber_p->lock.lock();
+
+            if (fiber_p->resume_pending) {
+                fiber_p->resume_pending = false;
+                ready_push(fiber_p);
+            } else {
+                fiber_p->state = SchedulerFiber::State::SUSPENDED;
+            }
+
+            fiber_p->lock.unlock();
+            break;
+
+        case SwitchReason::STOP:
+            stopped(fiber_p);
+            break;
+        }
+    }
+
+    // Joiners are resumed once the stack is back in the pool.
+    void stopped(SchedulerFiber *fiber_p)
+    {
+        stack_pool.put(fiber_p->stack);
+        fiber_p->lock.lock();
+        fiber_p->state = SchedulerFiber::State::STOPPED;
+        fiber_p->joiners.wake_all();
+        fiber_p->lock.unlock();
+        fiber_p->m_fiber = nullptr;
+    }
+
+    // Switch from current fiber to its worker's scheduler context.
+    bool reschedule(SwitchReason reason)
+    {
+        Worker *worker_p = this_worker();
+        SchedulerFiber *fiber_p = worker_p->current_p;
+        ExceptionGlobals *globals_p = worker_p->exception_globals_p;
+
+        save_traceback(fiber_p);
+        fiber_p->exception_globals = *globals_p;
+        globals_p->caught_exceptions_p = NULL;
+        globals_p->uncaught_exceptions = 0;
+        worker_p->reason = reason;
+        switch_context(worker_p->scheduler_p, fiber_p);
+
+        // Possibly continuing on another worker.
+        *this_worker()->exception_globals_p = fiber_p->exception_globals;
+        restore_traceback(fiber_p);
+
+        fiber_p->lock.lock();
+        bool cancelled = fiber_p->cancelled;
+        int signum = fiber_p->signum;
+        fiber_p->cancelled = false;
+        fiber_p->lock.unlock();
+
+        if (cancelled) {
+            switch (signum) {
+            case SIGINT:
+                mys::make_shared<InterruptError>()->__throw();
+                break;
+            }
+        }
+
+        return cancelled;
+    }
+
+    bool suspend()
+    {
+        return reschedule(SwitchReason::SUSPEND);
+    }
+
+    // A fiber resumed while still running is put in a run queue when
+    // it suspends.
+    void resume(SchedulerFiber *fiber_p)
+    {
+        fiber_p->lock.lock();
+
+        switch (fiber_p->state) {
+
+        case SchedulerFiber::State::SUSPENDED:
+            ready_push(fiber_p);
+            break;
+
+        case SchedulerFiber::State::CURRENT:
+            fiber_p->resume_pending = true;
+            break;
+
+        default:
+            break;
+        }
+
+        fiber_p->lock.unlock();
+    }
+
+    void cancel(SchedulerFiber *fiber_p, int signum)
+    {
+        fiber_p->lock.lock();
+
+        if (fiber_p->state != SchedulerFiber::State::STOPPED) {
+            fiber_p->cancelled = true;
+            fiber_p->signum = signum;
+
+            switch (fiber_p->state) {
+
+            case SchedulerFiber::State::SUSPENDED:
+                ready_push(fiber_p);
+                break;
+
+            case SchedulerFiber::State::CURRENT:
+                fiber_p->resume_pending = true;
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        fiber_p->lock.unlock();
+    }
+
+    // Call given function in the reactor thread.
+    void call_in_reactor(std::function<void()> function)
+    {
+        {
+            std::lock_guard<std::mutex> guard(calls_mutex);
+            calls.push_back(std::move(function));
+        }
+
+        uv_async_send(&calls_async);
+    }
+
+    SchedulerFiber *current()
+    {
+        return this_worker()->current_p;
+    }
+};
+
+// Never destroyed, as workers may still run when the application
+// exits.
+static Scheduler& scheduler = *new Scheduler();
+
+static void call_functions(uv_async_t *handle_p)
+{
+    std::vector<std::function<void()>> calls;
+
+    {
+        std::lock_guard<std::mutex> guard(scheduler.calls_mutex);
+        std::swap(calls, scheduler.calls);
+    }
+
+    for (auto& function : calls) {
+        function();
+    }
+}
+
+static void reactor_main()
+{
+    uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+}
+
+static void worker_main(Worker *worker_p)
+{
+    this_worker_p = worker_p;
+    scheduler.schedule(worker_p);
+}
+
+// Entry of the main thread's worker, which runs on a stack from the
+// pool as the main fiber runs on the main thread's stack.
+static void start_main_worker()
+{
+    scheduler.schedule(this_worker());
+}
+
+// One worker per core, unless MYS_FIBER_WORKERS is set in the
+// environment.
+static size_t number_of_workers()
+{
+    const char *value_p = getenv("MYS_FIBER_WORKERS");
+    long value = 0;
+
+    if (value_p != NULL) {
+        value = atol(value_p);
+    }
+
+    if (value <= 0) {
+        value = std::thread::hardware_concurrency();
+    }
+
+    if (value <= 0) {
+        value = 1;
+    }
+
+    return value;
+}
+
+#else
+
+struct Scheduler {
+    SchedulerFiber *current_p;
+    ReadyQueue ready;
+    // Stopped fiber whose stack is released by the next fiber to run,
+    // as a stack cannot be released while running on it.
+    SchedulerFiber *stopped_p;
+
+    SchedulerFiber *ready_pop()
+    {
+        SchedulerFiber *fiber_p = ready.pop();
+
+        if (fiber_p == NULL) {
+            std::cout << "error: no ready fiber" << std::endl;
+            exit(1);
+        }
+
+        return fiber_p;
+    }
+
+    void ready_push(SchedulerFiber *fiber_p)
+    {
+        record_ready(fiber_p);
+        ready.push(fiber_p);
+    }
+
+    // Returns the stack of the stopped fiber to the pool, and drops
+    // the reference to its fiber object.
+    void release_stopped()
+    {
+        if (stopped_p != NULL) {
+            SchedulerFiber *fiber_p = stopped_p;
+
+            stopped_p = NULL;
+            stack_pool.put(fiber_p->stack);
+            fiber_p->m_fiber = nullptr;
+        }
+    }
+
+    void swap(SchedulerFiber *in_p, SchedulerFiber *out_p)
+    {
+        ExceptionGlobals *globals_p = exception_globals();
+
+        out_p->traceback_top_p = mys::traceback_top_p;
+        out_p->traceback_bottom_p = mys::traceback_bottom_p;
+        out_p->exception_globals = *globals_p;
+        switch_context(in_p, out_p);
+
+        // Switched back to the out fiber.
+        *globals_p = out_p->exception_globals;
+        mys::traceback_top_p = out_p->traceback_top_p;
+        mys::traceback_bottom_p = out_p->traceback_bottom_p;
+        release_stopped();
+    }
+
+    bool reschedule(bool end = false)
+    {
+        SchedulerFiber *in_p;
+        SchedulerFiber *out_p;
+
+        in_p = ready_pop();
+        in_p->state = SchedulerFiber::State::CURRENT;
+        out_p = current_p;
+
+        if (in_p != out_p) {
+            if (statistics_enabled) {
+                u64 now = uv_hrtime();
+
+                record_switch_out(out_p, now);
+                record_switch_in(in_p, now);
+            }
+
+            current_p = in_p;
+
+            if (end) {
+                stopped_p = out_p;
+            }
+
+            swap(in_p, out_p);
+        }
+
+        bool cancelled = current_p->cancelled;
+        current_p->cancelled = false;
+
+        if (cancelled) {
+            switch (current_p->signum) {
+            case SIGINT:
+                mys::make_shared<InterruptError>()->__throw();
+                break;
+            }
+        }
+
+        return cancelled;
+    }
+
+    bool suspend()
+    {
+        current_p->state = SchedulerFiber::State::SUSPENDED;
+
+        return reschedule();
+    }
+
+    void resume(SchedulerFiber *fiber_p)
+    {
+        if (fiber_p->state == SchedulerFiber::State::SUSPENDED) {
+            fiber_p->state = SchedulerFiber::State::READY;
+            ready_push(fiber_p);
+        } else {
+            std::cout
+                << "error: trying to resume a fiber that is not suspended"
+                << std:: endl;
+            exit(1);
+        }
+    }
+
+    void cancel(SchedulerFiber *fiber_p, int signum)
+    {
+        if (fiber_p->state == SchedulerFiber::State::STOPPED) {
+            return;
+        }
+
+        fiber_p->cancelled = true;
+        fiber_p->signum = signum;
+
+        if (fiber_p->state != SchedulerFiber::State::READY) {
+            fiber_p->state = SchedulerFiber::State::READY;
+            ready_push(fiber_p);
+        }
+    }
+
+    SchedulerFiber *current()
+    {
+        return current_p;
+    }
+};
+
+static Scheduler scheduler;
+
+class Idle final : public Fiber {
+public:
+    Idle()
+    {
+    }
+
+    void run()
+    {
+        int res;
+
+        while (true) {
+            u64 idle_start = statistics_enabled ? uv_hrtime() : 0;
+
+            res = uv_run(uv_default_loop(), UV_RUN_ONCE);
+
+            if (idle_start != 0) {
+                idle_time.add(uv_hrtime() - idle_start);
+            }
+
+            if ((res == 0) && scheduler.ready.empty()) {
+                std::cout
+                    << "error: all fibers suspended and no pending IO"
+                    << std::endl;
+                exit(1);
+            }
+
+            // The idle fiber is always ready to run (at lowest
+            // priority).
+            scheduler.current_p->state = SchedulerFiber::State::READY;
+            scheduler.ready_push(scheduler.current_p);
+            scheduler.reschedule();
+        }
+    }
+};
+
+static mys::shared_ptr<Idle> idle_fiber;
+
+#endif
+
+class Main final : public Fiber {
+public:
+    Main()
+    {
+    }
+
+    void run()
+    {
+    }
+};
+
+static mys::shared_ptr<Main> main_fiber;
+
+bool suspend(SuspendReason reason)
+{
+    if (statistics_enabled) {
+        scheduler.current()->statistics.suspends[(int)reason]++;
+    }
+
+    return scheduler.suspend();
+}
+
+void resume(const mys::shared_ptr<Fiber>& fiber)
+{
+    scheduler.resume((SchedulerFiber *)fiber->data_p);
+}
+
+void cancel(const mys::shared_ptr<Fiber>& fiber)
+{
+    scheduler.cancel((SchedulerFiber *)fiber->data_p, -1);
+}
+
+bool yield()
+{
+#if defined(MYS_MULTI_CORE)
+    return scheduler.reschedule(SwitchReason::YIELD);
+#else
+    scheduler.current_p->state = SchedulerFiber::State::READY;
+    scheduler.ready_push(scheduler.current_p);
+
+    return scheduler.reschedule();
+#endif
+}
+
+mys::shared_ptr<Fiber> current()
+{
+    return scheduler.current()->m_fiber;
+}
+
+// Fiber entry function, running on the fiber's own stack. Never
+// returns, as a stopped fiber is never switched to again.
+static void start_fiber_main()
+{
+    SchedulerFiber *fiber_p = scheduler.current();
+    ExceptionGlobals *globals_p = exception_globals();
+
+    globals_p->caught_exceptions_p = NULL;
+    globals_p->uncaught_exceptions = 0;
+#if !defined(MYS_MULTI_CORE)
+    scheduler.release_stopped();
+#endif
+
+    __MYS_TRACEBACK_INIT();
+    fiber_p->traceback_top_p = traceback_top_p;
+    fiber_p->traceback_bottom_p = traceback_bottom_p;
+
+    try {
+        fiber_p->m_fiber->run();
+    } catch (const __Error &e) {
+        __MYS_TRACEBACK_RESTORE();
+        print_error_traceback(e.m_error, std::cerr);
+        std::cerr << PrintString(e.m_error->__str__()) << std::endl;
+        abort();
+    }
+
+#if defined(MYS_MULTI_CORE)
+    scheduler.reschedule(SwitchReason::STOP);
+#else
+    fiber_p->state = SchedulerFiber::State::STOPPED;
+    fiber_p->joiners.wake_all();
+    scheduler.reschedule(true);
+#endif
+    abort();
+}
+
+static void start_detailed(SchedulerFiber *fiber_p, size_t stack_size)
+{
+    init_context(fiber_p, stack_size, start_fiber_main);
+    scheduler.resume(fiber_p);
+}
+
+void start(const mys::shared_ptr<Fiber>& fiber, u64 stack_size)
+{
+    SchedulerFiber *fiber_p = NULL;
+
+    if (fiber->data_p != NULL) {
+        return;
+    }
+
+    {
+#if defined(MYS_MULTI_CORE)
+        std::lock_guard<SpinLock> guard(free_scheduler_fibers_lock);
+#endif
+
+        if (!free_scheduler_fibers.empty()) {
+            fiber_p = free_scheduler_fibers.back();
+            free_scheduler_fibers.pop_back();
+        }
+    }
+
+    if (fiber_p == NULL) {
+        fiber_p = new SchedulerFiber(fiber);
+    } else {
+        fiber_p->reset(fiber);
+    }
+
+    fiber->data_p = fiber_p;
+    start_detailed(fiber_p, stack_size);
+}
+
+StackPoolStatistics stack_pool_statistics()
+{
+    return stack_pool.statistics();
+}
+
+void enable_statistics(bool enabled)
+{
+    if (enabled) {
+        u64 now = uv_hrtime();
+
+        {
+            std::lock_guard<SpinLock> guard(scheduler_fibers_lock);
+
+            for (auto fiber_p : scheduler_fibers) {
+                fiber_p->reset_statistics(now);
+            }
+        }
+
+        ready_latency.reset();
+        idle_time.reset();
+    }
+
+    statistics_enabled = enabled;
+}
+
+FiberStatistics fiber_statistics(const mys::shared_ptr<Fiber>& fiber)
+{
+    FiberStatistics statistics;
+
+    if (fiber->data_p == NULL) {
+        memset(&statistics, 0, sizeof(statistics));
+    } else {
+        statistics = ((SchedulerFiber *)fiber->data_p)->statistics;
+    }
+
+    return statistics;
+}
+
+SchedulerStatistics scheduler_statistics()
+{
+    SchedulerStatistics statistics;
+
+    ready_latency.get(&statistics.ready_latency[0]);
+    idle_time.get(&statistics.idle_time[0]);
+
+    return statistics;
+}
+
+static void print_histogram(std::ostream& os, const char *name_p, u64 *buckets_p)
+{
+    os << name_p << ":\n";
+
+    for (int i = 0; i < MYS_HISTOGRAM_BUCKETS; i++) {
+        if (buckets_p[i] == 0) {
+            continue;
+        }
+
+        std::string limit;
+
+        if (i < MYS_HISTOGRAM_BUCKETS - 1) {
+            limit = "< " + std::to_string(1ULL << i);
+        } else {
+            limit = ">= " + std::to_string(1ULL << (i - 1));
+        }
+
+        os << "  " << std::setw(14) << std::left << (limit + " us")
+           << std::right << std::setw(12) << buckets_p[i] << "\n";
+    }
+}
+
+static const char *state_name(SchedulerFiber *fiber_p)
+{
+    switch (fiber_p->state) {
+    case SchedulerFiber::State::CURRENT:
+        return "current";
+    case SchedulerFiber::State::RESUMED:
+        return "resumed";
+    case SchedulerFiber::State::READY:
+        return "ready";
+    case SchedulerFiber::State::SUSPENDED:
+        return "suspended";
+    default:
+        return "stopped";
+    }
+}
+
+void print_statistics(std::ostream& os)
+{
+    SchedulerStatistics statistics = scheduler_statistics();
+
+    print_histogram(os, "Ready latency", &statistics.ready_latency[0]);
+    print_histogram(os, "Idle time", &statistics.idle_time[0]);
+    os << "Fibers:\n"
+       << "  NAME                           STATE      RUN (ms)  READY (ms)      IN     OUT"
+       << "   SLEEP    WAIT    JOIN      IO   OTHER\n";
+
+    std::lock_guard<SpinLock> guard(scheduler_fibers_lock);
+
+    for (auto fiber_p : scheduler_fibers) {
+        if (fiber_p->state == SchedulerFiber::State::STOPPED) {
+            continue;
+        }
+
+        int status;
+        char *name_p = abi::__cxa_demangle(fiber_p->name_p, NULL, NULL, &status);
+        std::string name = (status == 0) ? name_p : fiber_p->name_p;
+        FiberStatistics& fs = fiber_p->statistics;
+
+        free(name_p);
+
+        // Keep the end of long names, as it is the class name.
+        if (name.rfind("mys::", 0) == 0) {
+            name = name.substr(5);
+        }
+
+        if (name.size() > 30) {
+            name = "..." + name.substr(name.size() - 27);
+        }
+
+        os << "  " << std::setw(30) << std::left << name
+           << " " << std::setw(9) << state_name(fiber_p) << std::right
+           << std::fixed << std::setprecision(3)
+           << std::setw(10) << fs.run_time / 1e6
+           << std::setw(12) << fs.ready_time / 1e6
+           << std::setw(8) << fs.switches_in
+           << std::setw(8) << fs.switches_out
+           << std::setw(8) << fs.suspends[(int)SuspendReason::SLEEP]
+           << std::setw(8) << fs.suspends[(int)SuspendReason::WAIT]
+           << std::setw(8) << fs.suspends[(int)SuspendReason::JOIN]
+           << std::setw(8) << fs.suspends[(int)SuspendReason::IO]
+           << std::setw(8) << fs.suspends[(int)SuspendReason::OTHER]
+           << "\n";
+    }
+
+    os.flush();
+}
+
+// Resume given fiber waiting for a wait list or a timer.
+static void resume_waiting(SchedulerFiber *fiber_p)
+{
+#if defined(MYS_MULTI_CORE)
+    scheduler.resume(fiber_p);
+#else
+    // Already ready to run if cancelled or woken.
+    if (fiber_p->state == SchedulerFiber::State::SUSPENDED) {
+        scheduler.resume(fiber_p);
+    }
+#endif
+}
+
+// Timers of sleeping and waiting fibers in a hierarchical timer wheel
+// with millisecond ticks. The first level has one slot per tick for the
+// next 64 ticks, and slots of each following level are 64 times as long
+// as slots of the level below. Timers are moved down one level when the
+// time of their slot is reached. One libuv timer is armed for the next
+// tick with timers to expire or move, so all timers expiring at the
+// same tick are expired together.
+#define MYS_TIMER_WHEEL_LEVELS 4
+#define MYS_TIMER_WHEEL_BITS 6
+#define MYS_TIMER_WHEEL_SLOTS (1 << MYS_TIMER_WHEEL_BITS)
+
+class TimerWheel {
+private:
+    // Protects everything but the libuv timer, which is only used by
+    // the reactor.
+    SpinLock m_lock;
+    FiberTimer *m_slots[MYS_TIMER_WHEEL_LEVELS][MYS_TIMER_WHEEL_SLOTS];
+    // A bit per slot telling which slots are non-empty.
+    u64 m_bitmaps[MYS_TIMER_WHEEL_LEVELS];
+    // Timers expiring at or before m_now, not yet expired.
+    FiberTimer *m_due_p;
+    // Timers expiring up to and including this tick are expired, or
+    // in m_due_p.
+    u64 m_now;
+    // Tick the libuv timer is armed for, or UINT64_MAX if not armed.
+    u64 m_armed;
+    uv_timer_t m_handle;
+
+    static void on_timer(uv_timer_t *handle_p);
+    void link(FiberTimer *timer_p);
+    void unlink(FiberTimer *timer_p);
+    void expire(FiberTimer *&list_p, FiberTimer *&expired_p);
+    u64 next_tick();
+    FiberTimer *advance(u64 now);
+    void arm();
+
+public:
+    TimerWheel()
+    {
+        memset(&m_slots[0][0], 0, sizeof(m_slots));
+        memset(&m_bitmaps[0], 0, sizeof(m_bitmaps));
+        m_due_p = NULL;
+        m_now = 0;
+        m_armed = UINT64_MAX;
+    }
+
+    // Called before the libuv loop runs.
+    void init()
+    {
+        uv_timer_init(uv_default_loop(), &m_handle);
+        m_handle.data = this;
+        m_now = uv_hrtime() / 1000000;
+    }
+
+    void start(FiberTimer *timer_p, f64 seconds);
+    void stop(FiberTimer *timer_p);
+};
+
+// Never destroyed, as fibers may still use timers when the application
+// exits.
+static TimerWheel& timer_wheel = *new TimerWheel();
+
+void TimerWheel::link(FiberTimer *timer_p)
+{
+    FiberTimer **head_pp;
+
+    if (timer_p->m_expiry <= m_now) {
+        head_pp = &m_due_p;
+    } else {
+        u64 delta = timer_p->m_expiry - m_now;
+        u64 expiry = timer_p->m_expiry;
+        int level = (63 - __builtin_clzll(delta)) / MYS_TIMER_WHEEL_BITS;
+
+        // Timers beyond the last level are put in its last slot, and
+        // moved to the right slot when it is reached.
+        if (level >= MYS_TIMER_WHEEL_LEVELS) {
+            level = MYS_TIMER_WHEEL_LEVELS - 1;
+            expiry = m_now
+                + (1ULL << (MYS_TIMER_WHEEL_LEVELS * MYS_TIMER_WHEEL_BITS)) - 1;
+        }
+
+        int slot = ((expiry >> (level * MYS_TIMER_WHEEL_BITS))
+                    & (MYS_TIMER_WHEEL_SLOTS - 1));
+        head_pp = &m_slots[level][slot];
+        m_bitmaps[level] |= (1ULL << slot);
+    }
+
+    timer_p->m_head_pp = head_pp;
+    timer_p->m_prev_p = NULL;
+    timer_p->m_next_p = *head_pp;
+
+    if (*head_pp != NULL) {
+        (*head_pp)->m_prev_p = timer_p;
+    }
+
+    *head_pp = timer_p;
+}
+
+void TimerWheel::unlink(FiberTimer *timer_p)
+{
+    FiberTimer **head_pp = timer_p->m_head_pp;
+
+    if (timer_p->m_prev_p != NULL) {
+        timer_p->m_prev_p->m_next_p = timer_p->m_next_p;
+    } else {
+        *head_pp = timer_p->m_next_p;
+
+        if ((*head_pp == NULL) && (head_pp != &m_due_p)) {
+            size_t index = head_pp - &m_slots[0][0];
+
+            m_bitmaps[index / MYS_TIMER_WHEEL_SLOTS] &=
+                ~(1ULL << (index % MYS_TIMER_WHEEL_SLOTS));
+        }
+    }
+
+    if (timer_p->m_next_p != NULL) {
+        timer_p->m_next_p->m_prev_p = timer_p->m_prev_p;
+    }
+}
+
+// Move all timers in given list to given list of expired timers.
+void TimerWheel::expire(FiberTimer *&list_p, FiberTimer *&expired_p)
+{
+    FiberTimer *timer_p = list_p;
+    FiberTimer *next_p;
+
+    while (timer_p != NULL) {
+        next_p = timer_p->m_next_p;
+        timer_p->m_state = FiberTimer::FIRING;
+        timer_p->m_next_p = expired_p;
+        expired_p = timer_p;
+        timer_p = next_p;
+    }
+
+    list_p = NULL;
+}
+
+// The next tick with timers to expire or move, or UINT64_MAX if there
+// are no timers. The slots of each level are searched from the slot
+// after the current one, wrapping around.
+u64 TimerWheel::next_tick()
+{
+    u64 next = UINT64_MAX;
+
+    if (m_due_p != NULL) {
+        return m_now;
+    }
+
+    for (int level = 0; level < MYS_TIMER_WHEEL_LEVELS; level++) {
+        u64 bitmap = m_bitmaps[level];
+
+        if (bitmap == 0) {
+            continue;
+        }
+
+        int shift = level * MYS_TIMER_WHEEL_BITS;
+        u64 block = m_now >> shift;
+        int current = block & (MYS_TIMER_WHEEL_SLOTS - 1);
+        u64 later = 0;
+
+        if (current < MYS_TIMER_WHEEL_SLOTS - 1) {
+            later = bitmap & (~0ULL << (current + 1));
+        }
+
+        block -= current;
+
+        if (later != 0) {
+            block += __builtin_ctzll(later);
+        } else {
+            block += MYS_TIMER_WHEEL_SLOTS + __builtin_ctzll(bitmap);
+        }
+
+        next = std::min(next, block << shift);
+    }
+
+    return next;
+}
+
+// Returns a list of all timers expiring at or before given tick.
+// Timers in slots reached on the way are moved to lower levels.
+FiberTimer *TimerWheel::advance(u64 now)
+{
+    FiberTimer *expired_p = NULL;
+
+    while (true) {
+        u64 tick = next_tick();
+
+        if (tick > now) {
+            break;
+        }
+
+        if (tick > m_now) {
+            m_now = tick;
+
+            for (int level = MYS_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+                int shift = level * MYS_TIMER_WHEEL_BITS;
+
+                if ((m_now & ((1ULL << shift) - 1)) != 0) {
+                    continue;
+                }
+
+                int slot = (m_now >> shift) & (MYS_TIMER_WHEEL_SLOTS - 1);
+                FiberTimer *timer_p = m_slots[level][slot];
+                FiberTimer *next_p;
+
+                m_slots[level][slot] = NULL;
+                m_bitmaps[level] &= ~(1ULL << slot);
+
+                while (timer_p != NULL) {
+                    next_p = timer_p->m_next_p;
+                    link(timer_p);
+                    timer_p = next_p;
+                }
+            }
+
+            int slot = m_now & (MYS_TIMER_WHEEL_SLOTS - 1);
+            expire(m_slots[0][slot], expired_p);
+            m_bitmaps[0] &= ~(1ULL << slot);
+        }
+
+        expire(m_due_p, expired_p);
+    }
+
+    // No timers expire in between, so their slots are still right.
+    if (now > m_now) {
+        m_now = now;
+    }
+
+    return expired_p;
+}
+
+// Arm the libuv timer for the next tick with timers. Called by the
+// reactor.
+void TimerWheel::arm()
+{
+    u64 tick;
+
+    m_lock.lock();
+    tick = next_tick();
+    m_armed = tick;
+    m_lock.unlock();
+
+    if (tick == UINT64_MAX) {
+        uv_timer_stop(&m_handle);
+    } else {
+        u64 now = uv_hrtime() / 1000000;
+
+        uv_timer_start(&m_handle, on_timer, tick > now ? tick - now : 0, 0);
+    }
+}
+
+// Expired fibers are resumed without the lock held, so that the wheel's
+// lock is never held while taking other locks. A fiber stopping a
+// timer that is being expired waits for it to be resumed.
+void TimerWheel::on_timer(uv_timer_t *handle_p)
+{
+    TimerWheel *wheel_p = (TimerWheel *)handle_p->data;
+    FiberTimer *timer_p;
+    FiberTimer *next_p;
+
+    wheel_p->m_lock.lock();
+    timer_p = wheel_p->advance(uv_hrtime() / 1000000);
+    wheel_p->m_armed = UINT64_MAX;
+    wheel_p->m_lock.unlock();
+
+    while (timer_p != NULL) {
+        next_p = timer_p->m_next_p;
+        resume_waiting((SchedulerFiber *)timer_p->m_fiber_p);
+        timer_p->m_state = FiberTimer::EXPIRED;
+        timer_p = next_p;
+    }
+
+    wheel_p->arm();
+}
+
+void TimerWheel::start(FiberTimer *timer_p, f64 seconds)
+{
+    u64 now_ns = uv_hrtime();
+    u64 now = now_ns / 1000000;
+    bool rearm;
+
+    // Rounded up to the next tick, so timers never expire early.
+    timer_p->m_expiry = ((now_ns + (u64)std::min(seconds * 1e9, 1e18) + 999999)
+                         / 1000000);
+    m_lock.lock();
+
+    // Skip ticks without timers, so that new timers are put in as low
+    // levels as possible.
+    if ((now > m_now) && (next_tick() > now)) {
+        m_now = now;
+    }
+
+    link(timer_p);
+    timer_p->m_state = FiberTimer::RUNNING;
+    rearm = (next_tick() < m_armed);
+
+    if (rearm) {
+        m_armed = next_tick();
+    }
+
+    m_lock.unlock();
+
+    if (rearm) {
+        call_in_reactor([this]() {
+            arm();
+        });
+    }
+}
+
+void TimerWheel::stop(FiberTimer *timer_p)
+{
+    m_lock.lock();
+
+    if (timer_p->m_state == FiberTimer::RUNNING) {
+        unlink(timer_p);
+        timer_p->m_state = FiberTimer::STOPPED;
+    }
+
+    m_lock.unlock();
+
+#if defined(MYS_MULTI_CORE)
+    while (timer_p->m_state == FiberTimer::FIRING) {
+        std::this_thread::yield();
+    }
+#endif
+}
+
+FiberTimer::FiberTimer(f64 seconds)
+    : m_fiber_p(NULL), m_seconds(seconds), m_state(STOPPED)
+{
+}
+
+FiberTimer::~FiberTimer()
+{
+    stop();
+}
+
+void FiberTimer::start()
+{
+    if ((m_state != STOPPED) || (m_seconds < 0.0)) {
+        return;
+    }
+
+    m_fiber_p = scheduler.current();
+    timer_wheel.start(this, m_seconds);
+}
+
+void FiberTimer::stop()
+{
+    int state = m_state;
+
+    if ((state == RUNNING) || (state == FIRING)) {
+        timer_wheel.stop(this);
+    }
+}
+
+bool FiberTimer::has_expired()
+{
+    int state = m_state;
+
+    return (m_seconds == 0.0) || (state == FIRING) || (state == EXPIRED);
+}
+
+int join(const mys::shared_ptr<Fiber>& fiber, f64 timeout)
+{
+    SchedulerFiber *fiber_p = (SchedulerFiber *)fiber->data_p;
+    FiberTimer timer(timeout);
+    std::lock_guard<SpinLock> guard(fiber_p->lock);
+    bool woken;
+
+    while (fiber_p->state != SchedulerFiber::State::STOPPED) {
+        int status = fiber_p->joiners.wait(fiber_p->lock,
+                                           woken,
+                                           timer,
+                                           SuspendReason::JOIN);
+
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    return 0;
+}
+
+bool sleep(f64 seconds)
+{
+    FiberTimer timer(std::max(seconds, 0.0));
+
+    timer.start();
+
+    return suspend(SuspendReason::SLEEP);
+}
+
+void call_in_reactor(std::function<void()> function)
+{
+#if defined(MYS_MULTI_CORE)
+    scheduler.call_in_reactor(std::move(function));
+#else
+    function();
+#endif
+}
+
+Operation::Operation() : m_done(true), result(0)
+{
+}
+
+void Operation::lock()
+{
+#if defined(MYS_MULTI_CORE)
+    m_mutex.lock();
+#endif
+}
+
+void Operation::unlock()
+{
+#if defined(MYS_MULTI_CORE)
+    m_mutex.unlock();
+#endif
+}
+
+void Operation::start()
+{
+    m_done = false;
+}
+
+void Operation::complete(ssize_t value)
+{
+    lock();
+    result = value;
+    m_done = true;
+
+    if (m_fiber) {
+        resume(m_fiber);
+    }
+
+    unlock();
+}
+
+// The fiber may be resumed more than once in multi-core builds if
+// cancelled, so it waits until the operation is done.
+bool Operation::wait(std::function<void()> abort)
+{
+    bool cancelled = false;
+
+    lock();
+
+    while (!m_done) {
+        m_fiber = current();
+        unlock();
+        bool suspend_cancelled = suspend(SuspendReason::IO);
+        lock();
+        m_fiber = nullptr;
+
+        if (suspend_cancelled && !cancelled) {
+            cancelled = true;
+
+            if (abort) {
+                unlock();
+                call_in_reactor(abort);
+                lock();
+            }
+        }
+    }
+
+    unlock();
+
+    return cancelled;
+}
+
+ssize_t call_in_reactor_and_wait(std::function<ssize_t()> function)
+{
+    Operation operation;
+
+    operation.start();
+    call_in_reactor([&operation, &function]() {
+        operation.complete(function());
+    });
+
+    if (operation.wait()) {
+        return UV_ECANCELED;
+    }
+
+    return operation.result;
+}
+
+// A function called by a fiber in the thread pool. Lives on the
+// fiber's stack.
+struct ThreadCall {
+    const std::function<void()> *function_p;
+    mys::shared_ptr<Error> error;
+    Operation operation;
+    ThreadCall *next_p;
+};
+
+// Threads calling functions for fibers, started on first use. Calls
+// are taken from the queue in the order they were made. Completed calls
+// are passed to the reactor, which is woken by an async handle and
+// resumes their fibers.
+class ThreadPool {
+private:
+    uv_mutex_t m_mutex;
+    uv_cond_t m_cond;
+    ThreadCall *m_head_p;
+    ThreadCall *m_tail_p;
+    ThreadCall *m_completed_p;
+    std::once_flag m_started;
+    uv_async_t m_async;
+#if !defined(MYS_MULTI_CORE)
+    // Number of calls not yet completed by the reactor. The async
+    // handle only keeps the loop running when non-zero.
+    size_t m_pending;
+#endif
+
+    static void on_async(uv_async_t *handle_p);
+
+    // One thread per core, unless MYS_FIBER_THREADS is set in the
+    // environment.
+    static size_t number_of_threads()
+    {
+        const char *value_p = getenv("MYS_FIBER_THREADS");
+        long value = 0;
+
+        if (value_p != NULL) {
+            value = atol(value_p);
+        }
+
+        if (value <= 0) {
+            value = std::thread::hardware_concurrency();
+        }
+
+        if (value <= 0) {
+            value = 1;
+        }
+
+        return value;
+    }
+
+    void thread_main();
+
+public:
+    void init();
+    void call(ThreadCall& call);
+};
+
+void ThreadPool::init()
+{
+    m_head_p = NULL;
+    m_tail_p = NULL;
+    m_completed_p = NULL;
+    uv_mutex_init(&m_mutex);
+    uv_cond_init(&m_cond);
+    uv_async_init(uv_default_loop(), &m_async, on_async);
+    m_async.data = this;
+#if !defined(MYS_MULTI_CORE)
+    m_pending = 0;
+    uv_unref((uv_handle_t *)&m_async);
+#endif
+}
+
+void ThreadPool::thread_main()
+{
+    // Mys code called by the threads needs a traceback of its own.
+    __MYS_TRACEBACK_INIT();
+
+    while (true) {
+        ThreadCall *call_p;
+
+        uv_mutex_lock(&m_mutex);
+
+        while (m_head_p == NULL) {
+            uv_cond_wait(&m_cond, &m_mutex);
+        }
+
+        call_p = m_head_p;
+        m_head_p = call_p->next_p;
+
+        if (m_head_p == NULL) {
+            m_tail_p = NULL;
+        }
+
+        uv_mutex_unlock(&m_mutex);
+
+        try {
+            (*call_p->function_p)();
+        } catch (const __Error& e) {
+            __MYS_TRACEBACK_RESTORE();
+            call_p->error = e.m_error;
+        }
+
+        uv_mutex_lock(&m_mutex);
+        bool wake = (m_completed_p == NULL);
+        call_p->next_p = m_completed_p;
+        m_completed_p = call_p;
+        uv_mutex_unlock(&m_mutex);
+
+        if (wake) {
+            uv_async_send(&m_async);
+        }
+    }
+}
+
+void ThreadPool::on_async(uv_async_t *handle_p)
+{
+    ThreadPool *pool_p = (ThreadPool *)handle_p->data;
+    ThreadCall *call_p;
+
+    uv_mutex_lock(&pool_p->m_mutex);
+    call_p = pool_p->m_completed_p;
+    pool_p->m_completed_p = NULL;
+    uv_mutex_unlock(&pool_p->m_mutex);
+
+    while (call_p != NULL) {
+        // The call is gone once its fiber runs.
+        ThreadCall *next_p = call_p->next_p;
+        call_p->operation.complete(0);
+        call_p = next_p;
+#if !defined(MYS_MULTI_CORE)
+        pool_p->m_pending--;
+#endif
+    }
 
-    SchedulerFiber(const mys::shared_ptr<Fiber>& fiber)
-    {
-        m_fiber = fiber;
-        uv_cond_init(&cond);
-        state = State::SUSPENDED;
-        prio = 0;
-        waiter_p = NULL;
-        uv_timer_init(uv_default_loop(), &handle);
-        handle.data = this;
-        cancelled = false;
-        signum = -1;
+#if !defined(MYS_MULTI_CORE)
+    if (pool_p->m_pending == 0) {
+        uv_unref((uv_handle_t *)&pool_p->m_async);
     }
-};
+#endif
+}
 
-struct Scheduler {
-    // To ensure that only one fiber is running at a time.
-    uv_mutex_t mutex;
-    SchedulerFiber *current_p;
-    SchedulerFiber *ready_head_p;
+void ThreadPool::call(ThreadCall& call)
+{
+    std::call_once(m_started, [this]() {
+        for (size_t i = 0; i < number_of_threads(); i++) {
+            std::thread(&ThreadPool::thread_main, this).detach();
+        }
+    });
 
-    SchedulerFiber *ready_pop()
-    {
-        SchedulerFiber *elem_p;
+#if !defined(MYS_MULTI_CORE)
+    // Fibers run in the reactor's thread.
+    if (m_pending == 0) {
+        uv_ref((uv_handle_t *)&m_async);
+    }
 
-        elem_p = ready_head_p;
+    m_pending++;
+#endif
 
-        if (elem_p == NULL) {
-            std::cout << "error: no ready fiber" << std::endl;
-            exit(1);
-        }
+    call.operation.start();
+    call.next_p = NULL;
 
-        ready_head_p = elem_p->next_p;
+    uv_mutex_lock(&m_mutex);
 
-        return elem_p;
+    if (m_tail_p == NULL) {
+        m_head_p = &call;
+    } else {
+        m_tail_p->next_p = &call;
     }
 
-    void ready_push(SchedulerFiber *elem_p)
-    {
-        SchedulerFiber *curr_p;
-        SchedulerFiber *prev_p;
-        int prio;
+    m_tail_p = &call;
+    uv_cond_signal(&m_cond);
+    uv_mutex_unlock(&m_mutex);
+}
 
-        elem_p->next_p = NULL;
+static ThreadPool& thread_pool = *new ThreadPool();
 
-        if (ready_head_p == NULL) {
-            /* Empty list. */
-            ready_head_p = elem_p;
-        } else {
-            /* Add in prio order, with highest prio first. */
-            curr_p = ready_head_p;
-            prev_p = NULL;
-            prio = elem_p->prio;
-
-            while (curr_p != NULL) {
-                if (prio < curr_p->prio) {
-                    /* Insert before the 'curr_p' element. */
-                    if (prev_p != NULL) {
-                        elem_p->next_p = prev_p->next_p;
-                        prev_p->next_p = elem_p;
-                    } else {
-                        elem_p->next_p = ready_head_p;
-                        ready_head_p = elem_p;
-                    }
-
-                    return;
-                }
+// The function cannot be interrupted, so a cancelled fiber waits for it
+// to return.
+bool call_in_thread(const std::function<void()>& function,
+                    mys::shared_ptr<Error>& error)
+{
+    ThreadCall call;
 
-                prev_p = curr_p;
-                curr_p = curr_p->next_p;
-            }
+    call.function_p = &function;
+    thread_pool.call(call);
+    bool cancelled = call.operation.wait();
+    error = call.error;
 
-            /* End of the list. */
-            prev_p->next_p = elem_p;
-        }
+    return cancelled;
+}
+
+WaitList::WaitList() : m_head_p(nullptr), m_tail_p(nullptr)
+{
+}
+
+void WaitList::remove(Waiter& waiter)
+{
+    if (waiter.prev_p != nullptr) {
+        waiter.prev_p->next_p = waiter.next_p;
+    } else {
+        m_head_p = waiter.next_p;
     }
 
-    void swap(SchedulerFiber *in_p, SchedulerFiber *out_p, bool end)
-    {
-        // Signal scheduled fiber to start;
-        out_p->traceback_top_p = mys::traceback_top_p;
-        out_p->traceback_bottom_p = mys::traceback_bottom_p;
-        uv_cond_signal(&in_p->cond);
+    if (waiter.next_p != nullptr) {
+        waiter.next_p->prev_p = waiter.prev_p;
+    } else {
+        m_tail_p = waiter.prev_p;
+    }
+}
 
-        if (!end) {
-            // Pause current fiber.
-            uv_cond_wait(&out_p->cond, &mutex);
-        }
+// A fiber resumed by something else than the wait list or the timer,
+// for example by a cancel racing with a wakeup in multi-core builds,
+// waits again.
+int WaitList::wait(SpinLock& lock,
+                   bool& woken,
+                   FiberTimer& timer,
+                   SuspendReason reason)
+{
+    Waiter waiter;
+    bool cancelled;
 
-        mys::traceback_top_p = out_p->traceback_top_p;
-        mys::traceback_bottom_p = out_p->traceback_bottom_p;
+    woken = false;
+
+    if (timer.has_expired()) {
+        return UV_ETIMEDOUT;
     }
 
-    bool reschedule(bool end = false)
-    {
-        SchedulerFiber *in_p;
-        SchedulerFiber *out_p;
+    timer.start();
+    waiter.fiber_p = scheduler.current();
+    waiter.woken = false;
+    waiter.next_p = nullptr;
+    waiter.prev_p = m_tail_p;
 
-        in_p = ready_pop();
-        in_p->state = SchedulerFiber::State::CURRENT;
-        out_p = current_p;
+    if (m_tail_p != nullptr) {
+        m_tail_p->next_p = &waiter;
+    } else {
+        m_head_p = &waiter;
+    }
 
-        if (in_p != out_p) {
-            current_p = in_p;
-            swap(in_p, out_p, end);
+    m_tail_p = &waiter;
+
+    try {
+        do {
+            lock.unlock();
+            cancelled = suspend(reason);
+            lock.lock();
+        } while (!cancelled && !waiter.woken && !timer.has_expired());
+    } catch (...) {
+        lock.lock();
+
+        if (!waiter.woken) {
+            remove(waiter);
         }
 
-        bool cancelled = current_p->cancelled;
-        current_p->cancelled = false;
+        woken = waiter.woken;
 
-        if (cancelled) {
-            switch (current_p->signum) {
-            case SIGINT:
-                mys::make_shared<InterruptError>()->__throw();
-                break;
-            }
-        }
+        throw;
+    }
 
-        return cancelled;
+    if (!waiter.woken) {
+        remove(waiter);
     }
 
-    bool suspend()
-    {
-        current_p->state = SchedulerFiber::State::SUSPENDED;
+    woken = waiter.woken;
 
-        return reschedule();
+    if (cancelled) {
+        return UV_ECANCELED;
     }
 
-    void resume(SchedulerFiber *fiber_p)
-    {
-        if (fiber_p->state == SchedulerFiber::State::SUSPENDED) {
-            fiber_p->state = SchedulerFiber::State::READY;
-            ready_push(fiber_p);
-        } else {
-            std::cout
-                << "error: trying to resume a fiber that is not suspended"
-                << std:: endl;
-            exit(1);
-        }
+    if (woken) {
+        return 0;
     }
 
-    void cancel(SchedulerFiber *fiber_p, int signum)
-    {
-        if (fiber_p->state == SchedulerFiber::State::STOPPED) {
-            return;
-        }
+    return UV_ETIMEDOUT;
+}
 
-        fiber_p->cancelled = true;
-        fiber_p->signum = signum;
+bool WaitList::wake_one()
+{
+    Waiter *waiter_p = m_head_p;
 
-        if (fiber_p->state != SchedulerFiber::State::READY) {
-            fiber_p->state = SchedulerFiber::State::READY;
-            ready_push(fiber_p);
-        }
+    if (waiter_p == nullptr) {
+        return false;
     }
-};
 
-static Scheduler scheduler;
+    remove(*waiter_p);
+    waiter_p->woken = true;
 
-class Main final : public Fiber {
-public:
-    Main()
-    {
+    // Resumed with the list's lock held, as the waiter is gone once it
+    // sees it was woken.
+    resume_waiting((SchedulerFiber *)waiter_p->fiber_p);
+
+    return true;
+}
+
+void WaitList::wake_all()
+{
+    while (wake_one()) {
     }
+}
 
-    void run()
-    {
+int FiberQueue::wait(WaitList& list, FiberTimer& timer)
+{
+    bool woken;
+    int status;
+
+    try {
+        status = list.wait(m_lock, woken, timer);
+    } catch (...) {
+        if (woken) {
+            list.wake_one();
+        }
+
+        throw;
     }
-};
 
-class Idle final : public Fiber {
-public:
-    Idle()
-    {
+    if ((status != 0) && woken) {
+        list.wake_one();
     }
 
-    void run()
-    {
-        int res;
+    return status;
+}
 
-        while (true) {
-            res = uv_run(uv_default_loop(), UV_RUN_ONCE);
+int FiberLock::acquire(f64 timeout)
+{
+    FiberTimer timer(timeout);
+    std::lock_guard<SpinLock> guard(m_lock);
+    bool woken;
+    int status;
 
-            if ((res == 0) && (scheduler.ready_head_p == NULL)) {
-                std::cout
-                    << "error: all fibers suspended and no pending IO"
-                    << std::endl;
-                exit(1);
-            }
+    if (!m_is_acquired) {
+        m_is_acquired = true;
 
-            // The idle fiber is always ready to run (at lowest
-            // priority).
-            scheduler.current_p->state = SchedulerFiber::State::READY;
-            scheduler.ready_push(scheduler.current_p);
-            scheduler.reschedule();
+        return 0;
+    }
+
+    // Woken fibers own the lock.
+    try {
+        status = m_waiters.wait(m_lock, woken, timer);
+    } catch (...) {
+        if (woken) {
+            release_locked();
         }
+
+        throw;
     }
-};
 
-static mys::shared_ptr<Main> main_fiber;
-static mys::shared_ptr<Idle> idle_fiber;
+    if ((status != 0) && woken) {
+        release_locked();
+    }
 
-bool suspend()
-{
-    return scheduler.suspend();
+    return status;
 }
 
-void resume(const mys::shared_ptr<Fiber>& fiber)
+bool FiberLock::try_acquire()
 {
-    scheduler.resume((SchedulerFiber *)fiber->data_p);
+    std::lock_guard<SpinLock> guard(m_lock);
+
+    if (m_is_acquired) {
+        return false;
+    }
+
+    m_is_acquired = true;
+
+    return true;
 }
 
-void cancel(const mys::shared_ptr<Fiber>& fiber)
+void FiberLock::release_locked()
 {
-    scheduler.cancel((SchedulerFiber *)fiber->data_p, -1);
+    if (!m_waiters.wake_one()) {
+        m_is_acquired = false;
+    }
 }
 
-bool yield()
+void FiberLock::release()
 {
-    scheduler.current_p->state = SchedulerFiber::State::READY;
-    scheduler.ready_push(scheduler.current_p);
+    std::lock_guard<SpinLock> guard(m_lock);
 
-    return scheduler.reschedule();
+    release_locked();
 }
 
-mys::shared_ptr<Fiber> current()
+void FiberEvent::set()
 {
-    return scheduler.current_p->m_fiber;
+    std::lock_guard<SpinLock> guard(m_lock);
+
+    m_is_set = true;
+    m_waiters.wake_all();
 }
 
-// Fiber (currently thread) entry function.
-static void start_fiber_main(void *arg_p)
+void FiberEvent::clear()
 {
-    SchedulerFiber *fiber_p = (SchedulerFiber *)arg_p;
+    std::lock_guard<SpinLock> guard(m_lock);
+
+    m_is_set = false;
+}
 
-    uv_mutex_lock(&scheduler.mutex);
+int FiberEvent::wait(f64 timeout)
+{
+    FiberTimer timer(timeout);
+    std::lock_guard<SpinLock> guard(m_lock);
+    bool woken;
 
-    if (fiber_p->state != SchedulerFiber::State::CURRENT) {
-        uv_cond_wait(&fiber_p->cond, &scheduler.mutex);
+    if (m_is_set) {
+        return 0;
     }
 
-    __MYS_TRACEBACK_INIT();
-    fiber_p->traceback_top_p = traceback_top_p;
-    fiber_p->traceback_bottom_p = traceback_bottom_p;
+    return m_waiters.wait(m_lock, woken, timer);
+}
 
-    try {
-        fiber_p->m_fiber->run();
-    } catch (const __Error &e) {
-        __MYS_TRACEBACK_RESTORE();
-        print_error_traceback(e.m_error, std::cerr);
-        std::cerr << PrintString(e.m_error->__str__()) << std::endl;
-        abort();
+int FiberSemaphore::acquire(f64 timeout)
+{
+    FiberTimer timer(timeout);
+    std::lock_guard<SpinLock> guard(m_lock);
+    bool woken;
+    int status;
+
+    if (m_count > 0) {
+        m_count--;
+
+        return 0;
     }
 
-    fiber_p->state = SchedulerFiber::State::STOPPED;
-    SchedulerFiber *waiter_p = fiber_p->waiter_p;
+    // Woken fibers are given the released value.
+    try {
+        status = m_waiters.wait(m_lock, woken, timer);
+    } catch (...) {
+        if (woken) {
+            release_locked();
+        }
 
-    while (waiter_p != NULL) {
-        scheduler.resume(waiter_p);
-        waiter_p = waiter_p->waiter_p;
+        throw;
     }
 
-    fiber_p->waiter_p = NULL;
-    scheduler.reschedule(true);
-    uv_mutex_unlock(&scheduler.mutex);
+    if ((status != 0) && woken) {
+        release_locked();
+    }
+
+    return status;
 }
 
-static void start_detailed(SchedulerFiber *fiber_p)
+bool FiberSemaphore::try_acquire()
 {
-    if (uv_thread_create(&fiber_p->thread, start_fiber_main, fiber_p) != 0) {
-        throw std::exception();
+    std::lock_guard<SpinLock> guard(m_lock);
+
+    if (m_count == 0) {
+        return false;
     }
 
-    scheduler.resume(fiber_p);
+    m_count--;
+
+    return true;
 }
 
-void start(const mys::shared_ptr<Fiber>& fiber)
+void FiberSemaphore::release_locked()
 {
-    if (fiber->data_p != NULL) {
-        return;
+    if (!m_waiters.wake_one()) {
+        m_count++;
     }
+}
 
-    auto fiber_p = new SchedulerFiber(fiber);
+void FiberSemaphore::release()
+{
+    std::lock_guard<SpinLock> guard(m_lock);
 
-    fiber->data_p = fiber_p;
-    start_detailed(fiber_p);
+    release_locked();
 }
 
-bool join(const mys::shared_ptr<Fiber>& fiber)
+int FiberCondition::wait(FiberLock& lock, f64 timeout)
 {
-    SchedulerFiber *fiber_p = (SchedulerFiber *)fiber->data_p;
-    bool cancelled = false;
+    FiberTimer timer(timeout);
+    bool woken;
+    int status;
 
-    if (fiber_p->state != SchedulerFiber::State::STOPPED) {
-        scheduler.current_p->waiter_p = fiber_p->waiter_p;
-        fiber_p->waiter_p = scheduler.current_p;
-        cancelled = suspend();
+    {
+        std::lock_guard<SpinLock> guard(m_lock);
 
-        if (cancelled) {
-            std::cout << "ToDo: Remove ourselves for wait list" << std::endl;
+        // Released after joining the wait list, so no notification is
+        // missed.
+        lock.release();
+
+        try {
+            status = m_waiters.wait(m_lock, woken, timer);
+        } catch (...) {
+            if (woken) {
+                m_waiters.wake_one();
+            }
+
+            throw;
+        }
+
+        // Pass the notification on to another waiter.
+        if ((status != 0) && woken) {
+            m_waiters.wake_one();
         }
     }
 
-    return cancelled;
-}
+    // So that the timer does not resume the fiber while acquiring the
+    // lock.
+    timer.stop();
 
-static void sleep_complete(uv_timer_t *handle_p)
-{
-    scheduler.resume((SchedulerFiber *)(handle_p->data));
+    while (lock.acquire() != 0) {
+        status = UV_ECANCELED;
+    }
+
+    return status;
 }
 
-bool sleep(f64 seconds)
+void FiberCondition::notify(i64 count)
 {
-    uv_timer_start(&scheduler.current_p->handle,
-                   sleep_complete,
-                   1000 * seconds,
-                   0);
-
-    bool cancelled = suspend();
+    std::lock_guard<SpinLock> guard(m_lock);
 
-    if (uv_is_active((uv_handle_t *)&scheduler.current_p->handle)) {
-        uv_timer_stop(&scheduler.current_p->handle);
+    while ((count > 0) && m_waiters.wake_one()) {
+        count--;
     }
+}
 
-    return cancelled;
+void FiberCondition::notify_all()
+{
+    std::lock_guard<SpinLock> guard(m_lock);
+
+    m_waiters.wake_all();
 }
 
 static uv_signal_t sigint;
@@ -357,14 +2471,83 @@ static void handle_signal(uv_signal_t *handle_p, int signum)
     scheduler.cancel((SchedulerFiber *)main_fiber->data_p, signum);
 }
 
+static uv_signal_t sigusr1;
+
+static void handle_sigusr1(uv_signal_t *handle_p, int signum)
+{
+    print_statistics(std::cerr);
+}
+
+static void init_statistics()
+{
+    const char *value_p = getenv("MYS_FIBER_STATISTICS");
+
+    if ((value_p != NULL) && (strcmp(value_p, "yes") == 0)) {
+        enable_statistics(true);
+    }
+
+    uv_signal_init(uv_default_loop(), &sigusr1);
+    uv_signal_start(&sigusr1, handle_sigusr1, SIGUSR1);
+    // Do not keep the loop alive.
+    uv_unref((uv_handle_t *)&sigusr1);
+}
+
+#if defined(MYS_MULTI_CORE)
+
+void init()
+{
+    size_t count = number_of_workers();
+
+    uv_signal_init(uv_default_loop(), &sigint);
+    // ToDo: Let the user install signal handlers instead.
+    // uv_signal_start_oneshot(&sigint, handle_signal, SIGINT);
+    timer_wheel.init();
+    thread_pool.init();
+    init_statistics();
+    uv_async_init(uv_default_loop(), &scheduler.calls_async, call_functions);
+
+    for (size_t i = 0; i < count; i++) {
+        Worker *worker_p = new Worker();
+        worker_p->index = i;
+        worker_p->current_p = NULL;
+        worker_p->scheduler_p = new SchedulerFiber(nullptr);
+        scheduler.workers.push_back(worker_p);
+    }
+
+    // The main fiber runs on the main thread's stack, so the main
+    // thread's worker gets a stack of its own.
+    Worker *worker_p = scheduler.workers[0];
+    this_worker_p = worker_p;
+    worker_p->exception_globals_p = exception_globals();
+    init_context(worker_p->scheduler_p, 0, start_main_worker);
+
+    main_fiber = mys::make_shared<Main>();
+    auto fiber_p = new SchedulerFiber(main_fiber);
+    main_fiber->data_p = fiber_p;
+    fiber_p->state = SchedulerFiber::State::CURRENT;
+    fiber_p->worker_p = worker_p;
+    fiber_p->traceback_top_p = traceback_top_p;
+    fiber_p->traceback_bottom_p = traceback_bottom_p;
+    worker_p->current_p = fiber_p;
+
+    for (size_t i = 1; i < count; i++) {
+        std::thread(worker_main, scheduler.workers[i]).detach();
+    }
+
+    std::thread(reactor_main).detach();
+}
+
+#else
+
 void init()
 {
     uv_signal_init(uv_default_loop(), &sigint);
     // ToDo: Let the user install signal handlers instead.
     // uv_signal_start_oneshot(&sigint, handle_signal, SIGINT);
-    uv_mutex_init(&scheduler.mutex);
-    uv_mutex_lock(&scheduler.mutex);
-    scheduler.ready_head_p = NULL;
+    timer_wheel.init();
+    thread_pool.init();
+    init_statistics();
+    scheduler.stopped_p = NULL;
 
     main_fiber = mys::make_shared<Main>();
     main_fiber->data_p = new SchedulerFiber(main_fiber);
@@ -376,15 +2559,29 @@ void init()
     idle_fiber = mys::make_shared<Idle>();
     auto fiber_p = new SchedulerFiber(idle_fiber);
     idle_fiber->data_p = fiber_p;
-    fiber_p->prio = 127;
-    start_detailed(fiber_p);
+    fiber_p->prio = MYS_FIBER_PRIO_IDLE;
+    start_detailed(fiber_p, 0);
 }
 
+#endif
+
 Fiber::Fiber()
 {
     data_p = NULL;
 }
 
+// The scheduler holds a reference to the fiber until it is stopped, so
+// its scheduler fiber is no longer used.
+Fiber::~Fiber()
+{
+    if (data_p != NULL) {
+#if defined(MYS_MULTI_CORE)
+        std::lock_guard<SpinLock> guard(free_scheduler_fibers_lock);
+#endif
+        free_scheduler_fibers.push_back((SchedulerFiber *)data_p);
+    }
+}
+
 String Fiber::__str__()
 {
     std::stringstream ss;
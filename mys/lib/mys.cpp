@@ -4,6 +4,7 @@
 
 #include "unicodectype.cpp"
 #include "fiber.cpp"
+#include "uring.cpp"
 #include "memory.cpp"
 #include "whereami.c"
 
@@ -17,8 +18,8 @@ extern void package_main(int argc, const char *argv[]);
 
 namespace mys {
 
-TracebackEntry *traceback_bottom_p;
-TracebackEntry *traceback_top_p;
+thread_local TracebackEntry *traceback_bottom_p;
+thread_local TracebackEntry *traceback_top_p;
 TracebackEntry traceback_entry;
 
 static void ignore_sigpipe()
@@ -1352,7 +1353,7 @@ SharedTuple<String, String, String> String::partition(const Char& chr) const
 {
     auto i = std::find(m_string->begin(), m_string->end(), chr);
     if (i == m_string->end()) {
-        return mys::make_shared<Tuple<String, String, String>>(*this, "", "");
+        return Tuple<String, String, String>(*this, "", "");
     }
 
     String a("");
@@ -1362,7 +1363,7 @@ SharedTuple<String, String, String> String::partition(const Char& chr) const
     String c("");
     c.m_string->insert(c.m_string->end(), i + 1, m_string->end());
 
-    return mys::make_shared<Tuple<String, String, String>>(a, b, c);
+    return Tuple<String, String, String>(a, b, c);
 }
 
 SharedTuple<String, String, String> String::partition(const String& str) const
@@ -1374,7 +1375,7 @@ SharedTuple<String, String, String> String::partition(const String& str) const
     auto i = std::search(m_string->begin(), m_string->end(),
                          str.m_string->begin(), str.m_string->end());
     if (i == m_string->end()) {
-        return mys::make_shared<Tuple<String, String, String>>(*this, "", "");
+        return Tuple<String, String, String>(*this, "", "");
     }
 
     String a("");
@@ -1382,7 +1383,7 @@ SharedTuple<String, String, String> String::partition(const String& str) const
     String b("");
     b.m_string->insert(b.m_string->end(), i + str.__len__(), m_string->end());
 
-    return mys::make_shared<Tuple<String, String, String>>(a, str, b);
+    return Tuple<String, String, String>(a, str, b);
 }
 
 String String::replace(const Char& old, const Char& _new) const
@@ -1499,7 +1500,11 @@ RegexMatch String::match(const Regex& regex) const
 
 mys::shared_ptr<List<String>> String::split() const
 {
-    return Regex("\\s+", "").split(*this);
+    // Per thread, as copies of its strings change reference counts
+    // that are not atomic in single-core applications.
+    thread_local const Regex whitespace("\\s+", "");
+
+    return whitespace.split(*this);
 }
 
 mys::shared_ptr<List<String>> String::split(const Regex& regex) const
@@ -1784,7 +1789,7 @@ SharedTuple<i64, i64> RegexMatch::span(int index) const
         mys::make_shared<IndexError>("no such group")->__throw();
     }
 
-    return mys::make_shared<Tuple<i64, i64>>(
+    return Tuple<i64, i64>(
         ovector[index * 2], ovector[index * 2 + 1]);
 }
 
@@ -1805,6 +1810,8 @@ String Regex::get_error(int error)
 }
 
 Regex::Regex(const String& regex, const String& flags)
+    : m_pattern(regex),
+      m_flags(flags)
 {
     int pcreError;
     PCRE2_SIZE pcreErrorOffset;
@@ -1859,11 +1866,53 @@ Regex::Regex(const String& regex, const String& flags)
                      [](pcre2_code *code) {
                          pcre2_code_free(code);
                      });
+
+    // Fall back to the interpreter if JIT is not available.
+    m_jit = (pcre2_jit_compile(compiled_p, PCRE2_JIT_COMPLETE) == 0);
 }
 
-RegexMatch Regex::match(const String& string) const
+RegexScratch::RegexScratch(bool jit)
+    : m_match_data(nullptr),
+      m_context_p(pcre2_match_context_create(NULL)),
+      m_jit_stack_p(nullptr)
+{
+    // The default JIT stack is on the machine stack, which is small
+    // in fibers.
+    if (jit) {
+        m_jit_stack_p = pcre2_jit_stack_create(32 * 1024, 512 * 1024, NULL);
+        pcre2_jit_stack_assign(m_context_p, NULL, m_jit_stack_p);
+    }
+}
+
+RegexScratch::~RegexScratch()
+{
+    if (m_jit_stack_p != nullptr) {
+        pcre2_jit_stack_free(m_jit_stack_p);
+    }
+
+    pcre2_match_context_free(m_context_p);
+}
+
+RegexScratch& Regex::scratch() const
 {
-    std::shared_ptr<pcre2_match_data> match_data;
+    thread_local RegexScratch scratch(true);
+
+    return scratch;
+}
+
+// Match data of another pattern may have another number of groups.
+static bool is_match_data_of(pcre2_match_data *match_data_p, pcre2_code *code_p)
+{
+    uint32_t capture_count;
+
+    pcre2_pattern_info(code_p, PCRE2_INFO_CAPTURECOUNT, &capture_count);
+
+    return pcre2_get_ovector_count(match_data_p) == capture_count + 1;
+}
+
+bool Regex::search(const String& string, PCRE2_SIZE offset, uint32_t options) const
+{
+    RegexScratch& scratch = this->scratch();
     PCRE2_SPTR string_sptr = reinterpret_cast<PCRE2_SPTR>(string.m_string->data());
     PCRE2_SIZE length = string.m_string->size();
     PCRE2_UCHAR empty[] = { 0 };
@@ -1873,21 +1922,86 @@ RegexMatch Regex::match(const String& string) const
         string_sptr = empty;
     }
 
-    match_data.reset(pcre2_match_data_create_from_pattern(m_compiled.get(), NULL),
-                     [](pcre2_match_data *data) {
-                         pcre2_match_data_free(data);
-                     });
+    if (scratch.m_match_data
+        && !is_match_data_of(scratch.m_match_data.get(), m_compiled.get())) {
+        scratch.m_match_data.reset();
+    }
+
+    if (!scratch.m_match_data) {
+        scratch.m_match_data.reset(
+            pcre2_match_data_create_from_pattern(m_compiled.get(), NULL),
+            [](pcre2_match_data *data) {
+                pcre2_match_data_free(data);
+            });
+    }
+
+    if (m_jit) {
+        error = pcre2_jit_match(m_compiled.get(), string_sptr, length, offset,
+                                options, scratch.m_match_data.get(),
+                                scratch.m_context_p);
+    } else {
+        error = pcre2_match(m_compiled.get(), string_sptr, length, offset,
+                            options, scratch.m_match_data.get(),
+                            scratch.m_context_p);
+    }
 
-    error = pcre2_match(m_compiled.get(), string_sptr, length, 0, 0,
-                        match_data.get(), NULL);
     if (error == PCRE2_ERROR_NOMATCH) {
-        return RegexMatch();
+        return false;
     }
     else if (error < 0) {
         mys::make_shared<IndexError>(get_error(error))->__throw();
     }
 
-    return RegexMatch(match_data, m_compiled, string);
+    return true;
+}
+
+bool Regex::search_next(const String& string,
+                        PCRE2_SIZE& offset,
+                        uint32_t& options) const
+{
+    if (!search(string, offset, options)) {
+        return false;
+    }
+
+    PCRE2_SIZE *ovector = scratch_ovector();
+
+    // An empty match must not be found again at the same offset.
+    offset = ovector[1];
+    options = (ovector[0] == ovector[1]) ? PCRE2_NOTEMPTY_ATSTART : 0;
+
+    return true;
+}
+
+PCRE2_SIZE *Regex::scratch_ovector() const
+{
+    return pcre2_get_ovector_pointer(scratch().m_match_data.get());
+}
+
+RegexMatch Regex::take_match(const String& string) const
+{
+    // The match keeps the match data. A new one is created by the
+    // next successful match.
+    return RegexMatch(std::move(scratch().m_match_data), m_compiled, string);
+}
+
+RegexMatch Regex::match(const String& string) const
+{
+    if (!search(string, 0, 0)) {
+        return RegexMatch();
+    }
+
+    return take_match(string);
+}
+
+static String substring(const String& string, PCRE2_SIZE start, PCRE2_SIZE end)
+{
+    String res;
+    auto begin = string.m_string->begin();
+
+    res.m_string = mys::make_shared<String::CharVector>(begin + start,
+                                                        begin + end);
+
+    return res;
 }
 
 String Regex::replace(const String& subject, const String& replacement, int flags) const
@@ -1896,8 +2010,8 @@ String Regex::replace(const String& subject, const String& replacement, int flag
     PCRE2_SIZE subject_length = subject.m_string->size();
     PCRE2_SPTR replacement_sptr = reinterpret_cast<PCRE2_SPTR>(replacement.m_string->data());
     PCRE2_SIZE replacement_length = replacement.m_string->size();
-    auto pcre_output = std::vector<PCRE2_UCHAR>();
-    PCRE2_SIZE out_length = 1024;
+    String res("");
+    PCRE2_SIZE out_length = subject_length + replacement_length + 1;
     int error;
     uint32_t options = PCRE2_SUBSTITUTE_OVERFLOW_LENGTH;
     int retry = 2;
@@ -1915,13 +2029,17 @@ String Regex::replace(const String& subject, const String& replacement, int flag
         options |= PCRE2_SUBSTITUTE_GLOBAL;
     }
 
+    // Substitute directly into the result. The first attempt fails if
+    // the output is longer than the subject and the replacement
+    // together, and tells the required length.
     while (retry--) {
-        pcre_output.resize(out_length);
+        res.m_string->resize(out_length);
         error = pcre2_substitute(m_compiled.get(),
                                  subject_sptr, subject_length,
-                                 0, options, NULL, NULL,
+                                 0, options, NULL, scratch().m_context_p,
                                  replacement_sptr, replacement_length,
-                                 pcre_output.data(), &out_length);
+                                 reinterpret_cast<PCRE2_UCHAR *>(res.m_string->data()),
+                                 &out_length);
         if (error != PCRE2_ERROR_NOMEMORY) {
             break;
         }
@@ -1931,31 +2049,719 @@ String Regex::replace(const String& subject, const String& replacement, int flag
         mys::make_shared<IndexError>(get_error(error))->__throw();
     }
 
-    String res("");
-    for (int i = 0; i < out_length; ++i) {
-        res.append(Char(pcre_output[i]));
-    }
+    res.m_string->resize(out_length);
 
     return res;
 }
 
 mys::shared_ptr<List<String>> Regex::split(const String& string) const
 {
-    String split(string);
-    List<String> res;
+    auto res = mys::make_shared<List<String>>();
+    PCRE2_SIZE offset = 0;
+    PCRE2_SIZE start = 0;
+    uint32_t options = 0;
+
+    while (search_next(string, offset, options)) {
+        PCRE2_SIZE *ovector = scratch_ovector();
+        res->m_list.push_back(substring(string, start, ovector[0]));
+        start = ovector[1];
+    }
+
+    res->m_list.push_back(substring(string, start, string.m_string->size()));
+
+    return res;
+}
+
+mys::shared_ptr<List<String>> Regex::find_all(const String& string) const
+{
+    auto res = mys::make_shared<List<String>>();
+    PCRE2_SIZE offset = 0;
+    uint32_t options = 0;
+
+    while (search_next(string, offset, options)) {
+        PCRE2_SIZE *ovector = scratch_ovector();
+        res->m_list.push_back(substring(string, ovector[0], ovector[1]));
+    }
+
+    return res;
+}
+
+RegexFindIter Regex::find_iter(const String& string) const
+{
+    return RegexFindIter(*this, string);
+}
+
+RegexMatch RegexFindIter::next()
+{
+    if (m_done || !m_regex.search_next(m_string, m_offset, m_options)) {
+        m_done = true;
+
+        return RegexMatch();
+    }
+
+    return m_regex.take_match(m_string);
+}
+
+static bool is_ascii_alnum(i32 ch)
+{
+    return (ch >= 0) && (ch < 128) && isalnum(ch);
+}
+
+static bool is_ascii_digit(i32 ch)
+{
+    return (ch >= '0') && (ch <= '9');
+}
+
+static bool is_quantifier_braces(const std::vector<Char>& pattern, size_t i)
+{
+    for (i++; i < pattern.size(); i++) {
+        i32 ch = pattern[i].m_value;
+
+        if (ch == '}') {
+            return true;
+        } else if (!(is_ascii_digit(ch) || ch == ',' || ch == ' ')) {
+            return false;
+        }
+    }
+
+    return false;
+}
+
+static bool is_quantifier(const std::vector<Char>& pattern, size_t i)
+{
+    switch (pattern[i].m_value) {
+    case '?':
+    case '*':
+    case '+':
+        return true;
+    case '{':
+        return is_quantifier_braces(pattern, i);
+    default:
+        return false;
+    }
+}
+
+// Skips a quantifier and its lazy or possessive modifier, if any. Returns
+// true if the quantified item is optional.
+static bool skip_quantifier(const std::vector<Char>& pattern, size_t& i)
+{
+    bool optional = true;
+
+    if (i >= pattern.size() || !is_quantifier(pattern, i)) {
+        return false;
+    }
+
+    switch (pattern[i].m_value) {
+    case '+':
+        optional = false;
+        i++;
+        break;
+    case '{':
+        // Optional if the minimum is zero or missing.
+        for (i++;
+             pattern[i].m_value != ',' && pattern[i].m_value != '}';
+             i++) {
+            if (pattern[i].m_value >= '1' && pattern[i].m_value <= '9') {
+                optional = false;
+            }
+        }
+
+        while (pattern[i].m_value != '}') {
+            i++;
+        }
+
+        i++;
+        break;
+    default:
+        i++;
+        break;
+    }
+
+    if (i < pattern.size()
+        && (pattern[i].m_value == '?' || pattern[i].m_value == '+')) {
+        i++;
+    }
+
+    return optional;
+}
+
+// Skips a character class. Returns false if not terminated.
+static bool skip_class(const std::vector<Char>& pattern, size_t& i)
+{
+    size_t size = pattern.size();
+
+    i++;
+
+    if (i < size && pattern[i].m_value == '^') {
+        i++;
+    }
+
+    if (i < size && pattern[i].m_value == ']') {
+        i++;
+    }
+
+    while (i < size) {
+        i32 ch = pattern[i].m_value;
+
+        if (ch == '\\') {
+            i += 2;
+        } else if (ch == ']') {
+            i++;
+
+            return true;
+        } else if (ch == '[' && i + 1 < size && pattern[i + 1].m_value == ':') {
+            size_t j = i + 2;
+
+            if (j < size && pattern[j].m_value == '^') {
+                j++;
+            }
+
+            while (j < size && is_ascii_alnum(pattern[j].m_value)) {
+                j++;
+            }
+
+            if (j + 1 < size
+                && pattern[j].m_value == ':'
+                && pattern[j + 1].m_value == ']') {
+                i = j + 2;
+            } else {
+                i++;
+            }
+        } else {
+            i++;
+        }
+    }
+
+    return false;
+}
+
+// Skips a group, including nested groups. Returns false if not
+// terminated.
+static bool skip_group(const std::vector<Char>& pattern, size_t& i)
+{
+    size_t size = pattern.size();
+    int depth = 0;
+
+    while (i < size) {
+        i32 ch = pattern[i].m_value;
+
+        if (ch == '\\') {
+            i += 2;
+        } else if (ch == '[') {
+            if (!skip_class(pattern, i)) {
+                return false;
+            }
+        } else if (ch == '(') {
+            if (i + 2 < size
+                && pattern[i + 1].m_value == '?'
+                && pattern[i + 2].m_value == '#') {
+                // Comments are not parsed.
+                while (i < size && pattern[i].m_value != ')') {
+                    i++;
+                }
+
+                if (i == size) {
+                    return false;
+                }
+
+                i++;
+
+                if (depth == 0) {
+                    return true;
+                }
+            } else {
+                depth++;
+                i++;
+            }
+        } else if (ch == ')') {
+            depth--;
+            i++;
+
+            if (depth == 0) {
+                return true;
+            }
+        } else {
+            i++;
+        }
+    }
+
+    return false;
+}
+
+// Skips to after given character. Returns false if not found or if
+// there are special characters before it.
+static bool skip_until(const std::vector<Char>& pattern, size_t& i, i32 end)
+{
+    for (i++; i < pattern.size(); i++) {
+        i32 ch = pattern[i].m_value;
+
+        if (ch == end) {
+            i++;
+
+            return true;
+        }
+
+        switch (ch) {
+        case '\\':
+        case '|':
+        case '(':
+        case ')':
+        case '[':
+        case ']':
+            return false;
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+// Skips an escape sequence starting with a letter or a digit, including
+// its arguments. Returns false on unexpected syntax.
+static bool skip_escape(const std::vector<Char>& pattern, size_t& i)
+{
+    size_t size = pattern.size();
+    i32 letter = pattern[i + 1].m_value;
+
+    i += 2;
+
+    if (i == size) {
+        return true;
+    }
+
+    i32 ch = pattern[i].m_value;
+
+    switch (letter) {
+    case 'x':
+        if (ch == '{') {
+            return skip_until(pattern, i, '}');
+        }
+
+        for (int j = 0;
+             j < 2 && i < size && is_ascii_alnum(pattern[i].m_value)
+                 && isxdigit(pattern[i].m_value);
+             j++) {
+            i++;
+        }
+
+        break;
+    case 'o':
+    case 'N':
+        if (ch == '{') {
+            return skip_until(pattern, i, '}');
+        }
+
+        break;
+    case 'p':
+    case 'P':
+        if (ch == '{') {
+            return skip_until(pattern, i, '}');
+        }
+
+        i++;
+        break;
+    case 'g':
+    case 'k':
+        if (ch == '{') {
+            return skip_until(pattern, i, '}');
+        } else if (ch == '<') {
+            return skip_until(pattern, i, '>');
+        } else if (ch == '\'') {
+            return skip_until(pattern, i, '\'');
+        } else if (letter == 'g') {
+            if (ch == '-' || ch == '+') {
+                i++;
+            }
+
+            while (i < size && is_ascii_digit(pattern[i].m_value)) {
+                i++;
+            }
+        }
+
+        break;
+    case 'c':
+        i++;
+        break;
+    default:
+        if (is_ascii_digit(letter)) {
+            while (i < size && is_ascii_digit(pattern[i].m_value)) {
+                i++;
+            }
+        }
+
+        break;
+    }
+
+    return true;
+}
+
+static void end_run(std::vector<Char>& run, std::vector<Char>& best)
+{
+    if (run.size() > best.size()) {
+        best = run;
+    }
+
+    run.clear();
+}
+
+// Longest literal every match of given regex contains. Patterns that
+// are not fully understood give an empty literal, which is always
+// correct.
+static std::vector<Char> required_literal(const Regex& regex)
+{
+    const std::vector<Char>& pattern = *regex.m_pattern.m_string;
+    size_t size = pattern.size();
+    std::vector<Char> best;
+    std::vector<Char> run;
+    size_t i;
+
+    for (const auto& flag : *regex.m_flags.m_string) {
+        if (flag.m_value == 'i' || flag.m_value == 'x') {
+            return {};
+        }
+    }
+
+    // Quoting, option settings and verbs.
+    for (i = 0; i + 1 < size; i++) {
+        i32 ch = pattern[i].m_value;
+        i32 next = pattern[i + 1].m_value;
+
+        if (ch == '\\' && next == 'Q') {
+            return {};
+        } else if (ch == '(' && next == '*') {
+            return {};
+        } else if (ch == '(' && next == '?' && i + 2 < size) {
+            next = pattern[i + 2].m_value;
+
+            if (is_ascii_alnum(next) || next == '-' || next == '^') {
+                return {};
+            }
+        }
+    }
+
+    i = 0;
+
+    while (i < size) {
+        i32 ch = pattern[i].m_value;
+
+        switch (ch) {
+        case '|':
+        case ')':
+            return {};
+        case '(':
+            end_run(run, best);
+
+            if (!skip_group(pattern, i)) {
+                return {};
+            }
+
+            skip_quantifier(pattern, i);
+            break;
+        case '[':
+            end_run(run, best);
+
+            if (!skip_class(pattern, i)) {
+                return {};
+            }
+
+            skip_quantifier(pattern, i);
+            break;
+        case '.':
+        case '^':
+        case '$':
+            end_run(run, best);
+            i++;
+            skip_quantifier(pattern, i);
+            break;
+        case '?':
+        case '*':
+        case '+':
+        case '{':
+            end_run(run, best);
+
+            if (is_quantifier(pattern, i)) {
+                skip_quantifier(pattern, i);
+            } else {
+                i++;
+            }
+
+            break;
+        case '\\':
+            if (i + 1 == size) {
+                return {};
+            }
+
+            if (is_ascii_alnum(pattern[i + 1].m_value)) {
+                end_run(run, best);
+
+                if (!skip_escape(pattern, i)) {
+                    return {};
+                }
+
+                skip_quantifier(pattern, i);
+                break;
+            }
+
+            i++;
+            ch = pattern[i].m_value;
+
+            // Fall through.
+        default:
+            run.push_back(ch);
+            i++;
+
+            if (i < size && is_quantifier(pattern, i)) {
+                if (skip_quantifier(pattern, i)) {
+                    run.pop_back();
+                }
+
+                end_run(run, best);
+            }
+
+            break;
+        }
+    }
+
+    end_run(run, best);
+
+    return best;
+}
+
+LiteralMatcher::LiteralMatcher()
+    : m_generation(0)
+{
+    m_edges.emplace_back();
+    m_outputs.emplace_back();
+}
+
+int LiteralMatcher::child(int node, i32 ch) const
+{
+    const auto& edges = m_edges[node];
+    auto it = std::lower_bound(edges.begin(),
+                               edges.end(),
+                               ch,
+                               [](const std::pair<i32, int>& edge, i32 value) {
+                                   return edge.first < value;
+                               });
+
+    if (it != edges.end() && it->first == ch) {
+        return it->second;
+    } else {
+        return -1;
+    }
+}
+
+int LiteralMatcher::add_child(int node, i32 ch)
+{
+    int next = m_edges.size();
+    auto& edges = m_edges[node];
+    auto it = std::lower_bound(edges.begin(),
+                               edges.end(),
+                               ch,
+                               [](const std::pair<i32, int>& edge, i32 value) {
+                                   return edge.first < value;
+                               });
+
+    edges.insert(it, std::make_pair(ch, next));
+    m_edges.emplace_back();
+    m_outputs.emplace_back();
+
+    return next;
+}
+
+int LiteralMatcher::step(int node, i32 ch) const
+{
+    if (ch >= 0 && ch < 128) {
+        return m_table[node * 128 + ch];
+    }
+
     while (true) {
-        RegexMatch m = match(split);
-        if (m.m_match_data && m.get_num_matches() > 0) {
-            auto [start, end] = m.span(0)->m_tuple;
-            res.append(split.get(0, start, 1));
-            split = split.get(end, split.__len__(), 1);
+        int next = child(node, ch);
+
+        if (next != -1) {
+            return next;
+        } else if (node == 0) {
+            return 0;
         }
-        else {
-            res.append(split);
+
+        node = m_fail[node];
+    }
+}
+
+void LiteralMatcher::add(const std::vector<Char>& literal, int value)
+{
+    int node = 0;
+
+    for (const auto& ch : literal) {
+        int next = child(node, ch.m_value);
+
+        if (next == -1) {
+            next = add_child(node, ch.m_value);
+        }
+
+        node = next;
+    }
+
+    m_outputs[node].push_back(value);
+}
+
+void LiteralMatcher::build()
+{
+    size_t size = m_edges.size();
+    std::vector<int> queue;
+
+    m_fail.assign(size, 0);
+    m_report.assign(size, -1);
+    m_table.assign(size * 128, 0);
+    m_visited.assign(size, 0);
+    m_generation = 0;
+    queue.reserve(size);
+    queue.push_back(0);
+
+    // Breadth first, so failure links always point to finished nodes.
+    for (size_t head = 0; head < queue.size(); head++) {
+        int node = queue[head];
+
+        for (const auto& [ch, next] : m_edges[node]) {
+            if (node != 0) {
+                m_fail[next] = step(m_fail[node], ch);
+            }
+
+            queue.push_back(next);
+        }
+
+        if (!m_outputs[node].empty()) {
+            m_report[node] = node;
+        } else if (node != 0) {
+            m_report[node] = m_report[m_fail[node]];
+        }
+
+        for (i32 ch = 0; ch < 128; ch++) {
+            int next = child(node, ch);
+
+            if (next == -1) {
+                next = (node == 0) ? 0 : m_table[m_fail[node] * 128 + ch];
+            }
+
+            m_table[node * 128 + ch] = next;
+        }
+    }
+}
+
+void LiteralMatcher::scan(const String& string,
+                          std::vector<bool>& found,
+                          size_t remaining)
+{
+    int node = 0;
+
+    if (remaining == 0) {
+        return;
+    }
+
+    m_generation++;
+
+    if (m_generation == 0) {
+        std::fill(m_visited.begin(), m_visited.end(), 0);
+        m_generation = 1;
+    }
+
+    for (const auto& ch : *string.m_string) {
+        node = step(node, ch.m_value);
+
+        // Outputs of already visited nodes and their failure chains are
+        // already marked.
+        for (int report = m_report[node];
+             report != -1 && m_visited[report] != m_generation;
+             report = m_report[m_fail[report]]) {
+            m_visited[report] = m_generation;
+
+            for (int value : m_outputs[report]) {
+                if (!found[value]) {
+                    found[value] = true;
+                    remaining--;
+                }
+            }
+        }
+
+        if (remaining == 0) {
             break;
         }
     }
-    return mys::make_shared<List<String>>(res);
+}
+
+RegexSet::RegexSet(const SharedList<Regex>& regexes)
+    : m_number_of_filtered(0)
+{
+    for (const auto& regex : shared_ptr_not_none(regexes)->m_list) {
+        int index = m_regexes.size();
+        std::vector<Char> literal = required_literal(regex_not_none(regex));
+
+        if (literal.empty()) {
+            m_unfiltered.push_back(index);
+        } else {
+            m_matcher.add(literal, index);
+            m_number_of_filtered++;
+        }
+
+        m_regexes.push_back(regex);
+    }
+
+    m_matcher.build();
+    m_candidates.resize(m_regexes.size());
+}
+
+void RegexSet::find_candidates(const String& string)
+{
+    std::fill(m_candidates.begin(), m_candidates.end(), false);
+
+    for (int index : m_unfiltered) {
+        m_candidates[index] = true;
+    }
+
+    m_matcher.scan(string, m_candidates, m_number_of_filtered);
+}
+
+SharedList<i64> RegexSet::matches(const String& string)
+{
+    auto res = mys::make_shared<List<i64>>();
+
+    find_candidates(string);
+
+    for (size_t i = 0; i < m_regexes.size(); i++) {
+        if (m_candidates[i] && m_regexes[i].search(string, 0, 0)) {
+            res->m_list.push_back(i);
+        }
+    }
+
+    return res;
+}
+
+bool RegexSet::is_match(const String& string)
+{
+    find_candidates(string);
+
+    for (size_t i = 0; i < m_regexes.size(); i++) {
+        if (m_candidates[i] && m_regexes[i].search(string, 0, 0)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+String RegexSet::__str__()
+{
+    std::stringstream ss;
+    ss << *this;
+    return String(ss.str().c_str());
+}
+
+std::ostream& operator<<(std::ostream& os, const RegexSet& obj)
+{
+    os << "RegexSet(patterns=" << obj.m_regexes.size() << ")";
+
+    return os;
 }
 
 Bytes::Bytes(u64 size)
@@ -2048,7 +2854,7 @@ Error::Error()
 
 String executable()
 {
-    static String path("");
+    thread_local String path("");
 
     if (path.m_string->size() == 0) {
         int length = wai_getExecutablePath(NULL, 0, NULL);
@@ -17,8 +17,12 @@
 #include "mys/types/list.hpp"
 #include "mys/types/dict.hpp"
 #include "mys/types/set.hpp"
+#include "mys/types/deque.hpp"
+#include "mys/types/sorted_dict.hpp"
+#include "mys/types/sorted_set.hpp"
 #include "mys/types/generators.hpp"
 #include "mys/types/regex.hpp"
+#include "mys/types/regex_set.hpp"
 
 // Errors and exception management
 #include "mys/errors/base.hpp"
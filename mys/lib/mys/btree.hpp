@@ -0,0 +1,714 @@
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include "common.hpp"
+
+namespace mys {
+
+// An ordered B+ tree, the storage of BTreeMap and BTreeSet below.
+// TItem is either a key-value pair or just the key.
+//
+// Items are kept sorted in wide leaves, and the leaves are linked in
+// order for iteration. Inner nodes have separator keys, children and
+// the number of items below each child, so the rank of a key and the
+// item at a rank are found without visiting any leaf but one. A
+// separator is greater than all keys to its left and at most the
+// smallest key to its right. Separators are not updated when items
+// are erased, as they still separate the children.
+//
+// All nodes but the root are at least half full. The first leaf is
+// never freed or replaced, as splits and merges keep the left node.
+template<typename TK, typename TItem>
+class BTree
+{
+public:
+    using value_type = TItem;
+
+protected:
+    static constexpr i64 leaf_capacity()
+    {
+        return std::clamp<i64>(1024 / sizeof(TItem), 8, 128);
+    }
+
+    static constexpr i64 LEAF_CAPACITY = leaf_capacity();
+    static constexpr i64 INNER_CAPACITY = 64;
+
+    struct Node {
+        bool m_is_leaf;
+
+        Node(bool is_leaf) : m_is_leaf(is_leaf)
+        {
+        }
+
+        virtual ~Node()
+        {
+        }
+    };
+
+    struct Leaf : public Node {
+        std::vector<TItem> m_items;
+        Leaf *m_next_p;
+
+        Leaf() : Node(true), m_next_p(nullptr)
+        {
+            m_items.reserve(LEAF_CAPACITY);
+        }
+    };
+
+    struct Inner : public Node {
+        std::vector<TK> m_keys;
+        std::vector<std::unique_ptr<Node>> m_children;
+        // Number of items below each child.
+        std::vector<i64> m_counts;
+
+        Inner() : Node(false)
+        {
+            m_keys.reserve(INNER_CAPACITY - 1);
+            m_children.reserve(INNER_CAPACITY);
+            m_counts.reserve(INNER_CAPACITY);
+        }
+    };
+
+    std::unique_ptr<Node> m_root;
+    Leaf *m_first_p;
+    i64 m_size;
+
+    static const TK& key_of(const TK& key)
+    {
+        return key;
+    }
+
+    template<typename TV>
+    static const TK& key_of(const std::pair<TK, TV>& item)
+    {
+        return item.first;
+    }
+
+    static i64 lower_bound_in_leaf(const Leaf *leaf_p, const TK& key)
+    {
+        auto it = std::lower_bound(leaf_p->m_items.begin(),
+                                   leaf_p->m_items.end(),
+                                   key,
+                                   [](const TItem& item, const TK& key) {
+                                       return key_of(item) < key;
+                                   });
+
+        return it - leaf_p->m_items.begin();
+    }
+
+    static i64 upper_bound_in_leaf(const Leaf *leaf_p, const TK& key)
+    {
+        auto it = std::upper_bound(leaf_p->m_items.begin(),
+                                   leaf_p->m_items.end(),
+                                   key,
+                                   [](const TK& key, const TItem& item) {
+                                       return key < key_of(item);
+                                   });
+
+        return it - leaf_p->m_items.begin();
+    }
+
+    // Index of the child that may contain given key.
+    static i64 child_index(const Inner *inner_p, const TK& key)
+    {
+        auto it = std::upper_bound(inner_p->m_keys.begin(),
+                                   inner_p->m_keys.end(),
+                                   key);
+
+        return it - inner_p->m_keys.begin();
+    }
+
+    static i64 count_of(const Node *node_p)
+    {
+        if (node_p->m_is_leaf) {
+            return static_cast<const Leaf *>(node_p)->m_items.size();
+        } else {
+            auto& counts = static_cast<const Inner *>(node_p)->m_counts;
+
+            return std::accumulate(counts.begin(), counts.end(), (i64)0);
+        }
+    }
+
+    static i64 width_of(const Node *node_p)
+    {
+        if (node_p->m_is_leaf) {
+            return static_cast<const Leaf *>(node_p)->m_items.size();
+        } else {
+            return static_cast<const Inner *>(node_p)->m_children.size();
+        }
+    }
+
+    static bool is_full(const Node *node_p)
+    {
+        if (node_p->m_is_leaf) {
+            return width_of(node_p) == LEAF_CAPACITY;
+        } else {
+            return width_of(node_p) == INNER_CAPACITY;
+        }
+    }
+
+    static i64 min_width(const Node *node_p)
+    {
+        if (node_p->m_is_leaf) {
+            return LEAF_CAPACITY / 2;
+        } else {
+            return INNER_CAPACITY / 2;
+        }
+    }
+
+    // Move the upper half of given full child to a new child after it.
+    static void split_child(Inner *parent_p, i64 index)
+    {
+        Node *child_p = parent_p->m_children[index].get();
+        std::unique_ptr<Node> right;
+
+        if (child_p->m_is_leaf) {
+            auto left_p = static_cast<Leaf *>(child_p);
+            auto right_p = new Leaf();
+            right.reset(right_p);
+            auto middle = left_p->m_items.begin() + left_p->m_items.size() / 2;
+            std::move(middle,
+                      left_p->m_items.end(),
+                      std::back_inserter(right_p->m_items));
+            left_p->m_items.erase(middle, left_p->m_items.end());
+            right_p->m_next_p = left_p->m_next_p;
+            left_p->m_next_p = right_p;
+            parent_p->m_keys.insert(parent_p->m_keys.begin() + index,
+                                    key_of(right_p->m_items[0]));
+        } else {
+            auto left_p = static_cast<Inner *>(child_p);
+            auto right_p = new Inner();
+            right.reset(right_p);
+            i64 middle = left_p->m_keys.size() / 2;
+            parent_p->m_keys.insert(parent_p->m_keys.begin() + index,
+                                    std::move(left_p->m_keys[middle]));
+            std::move(left_p->m_keys.begin() + middle + 1,
+                      left_p->m_keys.end(),
+                      std::back_inserter(right_p->m_keys));
+            left_p->m_keys.erase(left_p->m_keys.begin() + middle,
+                                 left_p->m_keys.end());
+            std::move(left_p->m_children.begin() + middle + 1,
+                      left_p->m_children.end(),
+                      std::back_inserter(right_p->m_children));
+            left_p->m_children.erase(left_p->m_children.begin() + middle + 1,
+                                     left_p->m_children.end());
+            right_p->m_counts.assign(left_p->m_counts.begin() + middle + 1,
+                                     left_p->m_counts.end());
+            left_p->m_counts.erase(left_p->m_counts.begin() + middle + 1,
+                                   left_p->m_counts.end());
+        }
+
+        i64 right_count = count_of(right.get());
+        parent_p->m_counts[index] -= right_count;
+        parent_p->m_counts.insert(parent_p->m_counts.begin() + index + 1,
+                                  right_count);
+        parent_p->m_children.insert(parent_p->m_children.begin() + index + 1,
+                                    std::move(right));
+    }
+
+    // Splits full nodes on the way down, so there is always room for
+    // the new item in the leaf.
+    template<typename... TArgs>
+    static std::pair<TItem *, bool> insert_into(Node *node_p,
+                                                const TK& key,
+                                                const TArgs&... args)
+    {
+        if (node_p->m_is_leaf) {
+            auto& items = static_cast<Leaf *>(node_p)->m_items;
+            i64 index = lower_bound_in_leaf(static_cast<Leaf *>(node_p), key);
+
+            if (index < (i64)items.size() && !(key < key_of(items[index]))) {
+                return {&items[index], false};
+            }
+
+            items.insert(items.begin() + index, TItem(args...));
+
+            return {&items[index], true};
+        }
+
+        auto inner_p = static_cast<Inner *>(node_p);
+        i64 index = child_index(inner_p, key);
+
+        if (is_full(inner_p->m_children[index].get())) {
+            split_child(inner_p, index);
+
+            if (!(key < inner_p->m_keys[index])) {
+                index++;
+            }
+        }
+
+        auto res = insert_into(inner_p->m_children[index].get(), key, args...);
+
+        if (res.second) {
+            inner_p->m_counts[index]++;
+        }
+
+        return res;
+    }
+
+    static void borrow_from_left(Inner *parent_p, i64 index)
+    {
+        Node *left_p = parent_p->m_children[index - 1].get();
+        Node *child_p = parent_p->m_children[index].get();
+        i64 count;
+
+        if (child_p->m_is_leaf) {
+            auto& left_items = static_cast<Leaf *>(left_p)->m_items;
+            auto& items = static_cast<Leaf *>(child_p)->m_items;
+            items.insert(items.begin(), std::move(left_items.back()));
+            left_items.pop_back();
+            parent_p->m_keys[index - 1] = key_of(items[0]);
+            count = 1;
+        } else {
+            auto from_p = static_cast<Inner *>(left_p);
+            auto to_p = static_cast<Inner *>(child_p);
+            to_p->m_keys.insert(to_p->m_keys.begin(),
+                                std::move(parent_p->m_keys[index - 1]));
+            parent_p->m_keys[index - 1] = std::move(from_p->m_keys.back());
+            from_p->m_keys.pop_back();
+            to_p->m_children.insert(to_p->m_children.begin(),
+                                    std::move(from_p->m_children.back()));
+            from_p->m_children.pop_back();
+            count = from_p->m_counts.back();
+            to_p->m_counts.insert(to_p->m_counts.begin(), count);
+            from_p->m_counts.pop_back();
+        }
+
+        parent_p->m_counts[index - 1] -= count;
+        parent_p->m_counts[index] += count;
+    }
+
+    static void borrow_from_right(Inner *parent_p, i64 index)
+    {
+        Node *child_p = parent_p->m_children[index].get();
+        Node *right_p = parent_p->m_children[index + 1].get();
+        i64 count;
+
+        if (child_p->m_is_leaf) {
+            auto& items = static_cast<Leaf *>(child_p)->m_items;
+            auto& right_items = static_cast<Leaf *>(right_p)->m_items;
+            items.push_back(std::move(right_items.front()));
+            right_items.erase(right_items.begin());
+            parent_p->m_keys[index] = key_of(right_items[0]);
+            count = 1;
+        } else {
+            auto to_p = static_cast<Inner *>(child_p);
+            auto from_p = static_cast<Inner *>(right_p);
+            to_p->m_keys.push_back(std::move(parent_p->m_keys[index]));
+            parent_p->m_keys[index] = std::move(from_p->m_keys.front());
+            from_p->m_keys.erase(from_p->m_keys.begin());
+            to_p->m_children.push_back(std::move(from_p->m_children.front()));
+            from_p->m_children.erase(from_p->m_children.begin());
+            count = from_p->m_counts.front();
+            to_p->m_counts.push_back(count);
+            from_p->m_counts.erase(from_p->m_counts.begin());
+        }
+
+        parent_p->m_counts[index] += count;
+        parent_p->m_counts[index + 1] -= count;
+    }
+
+    // Merge given child and the one after it into the first one.
+    static void merge_children(Inner *parent_p, i64 index)
+    {
+        Node *left_p = parent_p->m_children[index].get();
+        Node *right_p = parent_p->m_children[index + 1].get();
+
+        if (left_p->m_is_leaf) {
+            auto to_p = static_cast<Leaf *>(left_p);
+            auto from_p = static_cast<Leaf *>(right_p);
+            std::move(from_p->m_items.begin(),
+                      from_p->m_items.end(),
+                      std::back_inserter(to_p->m_items));
+            to_p->m_next_p = from_p->m_next_p;
+        } else {
+            auto to_p = static_cast<Inner *>(left_p);
+            auto from_p = static_cast<Inner *>(right_p);
+            to_p->m_keys.push_back(std::move(parent_p->m_keys[index]));
+            std::move(from_p->m_keys.begin(),
+                      from_p->m_keys.end(),
+                      std::back_inserter(to_p->m_keys));
+            std::move(from_p->m_children.begin(),
+                      from_p->m_children.end(),
+                      std::back_inserter(to_p->m_children));
+            to_p->m_counts.insert(to_p->m_counts.end(),
+                                  from_p->m_counts.begin(),
+                                  from_p->m_counts.end());
+        }
+
+        parent_p->m_keys.erase(parent_p->m_keys.begin() + index);
+        parent_p->m_counts[index] += parent_p->m_counts[index + 1];
+        parent_p->m_counts.erase(parent_p->m_counts.begin() + index + 1);
+        parent_p->m_children.erase(parent_p->m_children.begin() + index + 1);
+    }
+
+    // Refill given child, which is less than half full, from one of
+    // its siblings, or merge it with one of them.
+    static void rebalance(Inner *parent_p, i64 index)
+    {
+        i64 nchildren = parent_p->m_children.size();
+        Node *child_p = parent_p->m_children[index].get();
+        i64 minimum = min_width(child_p);
+
+        if (index > 0
+            && width_of(parent_p->m_children[index - 1].get()) > minimum) {
+            borrow_from_left(parent_p, index);
+        } else if (index + 1 < nchildren
+                   && width_of(parent_p->m_children[index + 1].get()) > minimum) {
+            borrow_from_right(parent_p, index);
+        } else if (index > 0) {
+            merge_children(parent_p, index - 1);
+        } else if (index + 1 < nchildren) {
+            merge_children(parent_p, index);
+        }
+    }
+
+    static bool erase_from(Node *node_p, const TK& key)
+    {
+        if (node_p->m_is_leaf) {
+            auto& items = static_cast<Leaf *>(node_p)->m_items;
+            i64 index = lower_bound_in_leaf(static_cast<Leaf *>(node_p), key);
+
+            if (index == (i64)items.size() || key < key_of(items[index])) {
+                return false;
+            }
+
+            items.erase(items.begin() + index);
+
+            return true;
+        }
+
+        auto inner_p = static_cast<Inner *>(node_p);
+        i64 index = child_index(inner_p, key);
+        Node *child_p = inner_p->m_children[index].get();
+
+        if (!erase_from(child_p, key)) {
+            return false;
+        }
+
+        inner_p->m_counts[index]--;
+
+        if (width_of(child_p) < min_width(child_p)) {
+            rebalance(inner_p, index);
+        }
+
+        return true;
+    }
+
+    template<typename... TArgs>
+    std::pair<TItem *, bool> insert_item(const TK& key, const TArgs&... args)
+    {
+        if (is_full(m_root.get())) {
+            auto root = std::make_unique<Inner>();
+            root->m_children.push_back(std::move(m_root));
+            root->m_counts.push_back(m_size);
+            split_child(root.get(), 0);
+            m_root = std::move(root);
+        }
+
+        auto res = insert_into(m_root.get(), key, args...);
+
+        if (res.second) {
+            m_size++;
+        }
+
+        return res;
+    }
+
+public:
+    class Iterator {
+        friend class BTree;
+
+        Leaf *m_leaf_p;
+        i64 m_index;
+
+        // Past the last item of a leaf is the first item of the next.
+        void skip_leaf_end()
+        {
+            while (m_leaf_p != nullptr
+                   && m_index == (i64)m_leaf_p->m_items.size()) {
+                m_leaf_p = m_leaf_p->m_next_p;
+                m_index = 0;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TItem;
+        using difference_type = i64;
+        using pointer = TItem *;
+        using reference = TItem&;
+
+        Iterator(Leaf *leaf_p, i64 index) : m_leaf_p(leaf_p), m_index(index)
+        {
+            skip_leaf_end();
+        }
+
+        TItem& operator*() const
+        {
+            return m_leaf_p->m_items[m_index];
+        }
+
+        TItem *operator->() const
+        {
+            return &m_leaf_p->m_items[m_index];
+        }
+
+        Iterator& operator++()
+        {
+            m_index++;
+            skip_leaf_end();
+
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator it = *this;
+            ++(*this);
+
+            return it;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return m_leaf_p == other.m_leaf_p && m_index == other.m_index;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    using iterator = Iterator;
+
+    // Items in a key range.
+    class Range {
+        Iterator m_begin;
+        Iterator m_end;
+
+    public:
+        Range(Iterator begin, Iterator end) : m_begin(begin), m_end(end)
+        {
+        }
+
+        Iterator begin() const
+        {
+            return m_begin;
+        }
+
+        Iterator end() const
+        {
+            return m_end;
+        }
+    };
+
+    BTree() : m_size(0)
+    {
+        m_first_p = new Leaf();
+        m_root.reset(m_first_p);
+    }
+
+    BTree(const BTree& other) : BTree()
+    {
+        for (const auto& item : other) {
+            insert_item(key_of(item), item);
+        }
+    }
+
+    BTree& operator=(const BTree& other)
+    {
+        BTree copy(other);
+        swap(copy);
+
+        return *this;
+    }
+
+    void swap(BTree& other)
+    {
+        std::swap(m_root, other.m_root);
+        std::swap(m_first_p, other.m_first_p);
+        std::swap(m_size, other.m_size);
+    }
+
+    // First item with a key not less than given key.
+    Iterator lower_bound(const TK& key) const
+    {
+        Node *node_p = m_root.get();
+
+        while (!node_p->m_is_leaf) {
+            auto inner_p = static_cast<Inner *>(node_p);
+            node_p = inner_p->m_children[child_index(inner_p, key)].get();
+        }
+
+        auto leaf_p = static_cast<Leaf *>(node_p);
+
+        return Iterator(leaf_p, lower_bound_in_leaf(leaf_p, key));
+    }
+
+    Iterator find(const TK& key) const
+    {
+        Iterator it = lower_bound(key);
+
+        if (it != end() && key < key_of(*it)) {
+            return end();
+        }
+
+        return it;
+    }
+
+    bool contains(const TK& key) const
+    {
+        return find(key) != end();
+    }
+
+    // Number of keys less than given key, or not greater than given
+    // key if inclusive is true.
+    i64 rank(const TK& key, bool inclusive = false) const
+    {
+        Node *node_p = m_root.get();
+        i64 rank = 0;
+
+        while (!node_p->m_is_leaf) {
+            auto inner_p = static_cast<Inner *>(node_p);
+            i64 index = child_index(inner_p, key);
+
+            for (i64 i = 0; i < index; i++) {
+                rank += inner_p->m_counts[i];
+            }
+
+            node_p = inner_p->m_children[index].get();
+        }
+
+        auto leaf_p = static_cast<Leaf *>(node_p);
+
+        if (inclusive) {
+            return rank + upper_bound_in_leaf(leaf_p, key);
+        } else {
+            return rank + lower_bound_in_leaf(leaf_p, key);
+        }
+    }
+
+    // Item with given rank, which must be less than the size.
+    Iterator nth(i64 index) const
+    {
+        Node *node_p = m_root.get();
+
+        while (!node_p->m_is_leaf) {
+            auto inner_p = static_cast<Inner *>(node_p);
+            i64 i = 0;
+
+            while (index >= inner_p->m_counts[i]) {
+                index -= inner_p->m_counts[i];
+                i++;
+            }
+
+            node_p = inner_p->m_children[i].get();
+        }
+
+        return Iterator(static_cast<Leaf *>(node_p), index);
+    }
+
+    // Last item with a key not greater than given key, or end().
+    Iterator floor(const TK& key) const
+    {
+        i64 index = rank(key, true);
+
+        if (index == 0) {
+            return end();
+        }
+
+        return nth(index - 1);
+    }
+
+    // First item with a key not less than given key, or end().
+    Iterator ceiling(const TK& key) const
+    {
+        return lower_bound(key);
+    }
+
+    // Items with keys in [lower, upper).
+    Range range(const TK& lower, const TK& upper) const
+    {
+        if (!(lower < upper)) {
+            return Range(end(), end());
+        }
+
+        return Range(lower_bound(lower), lower_bound(upper));
+    }
+
+    bool erase(const TK& key)
+    {
+        if (!erase_from(m_root.get(), key)) {
+            return false;
+        }
+
+        m_size--;
+
+        if (!m_root->m_is_leaf) {
+            auto root_p = static_cast<Inner *>(m_root.get());
+
+            if (root_p->m_children.size() == 1) {
+                m_root = std::move(root_p->m_children[0]);
+            }
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        m_first_p = new Leaf();
+        m_root.reset(m_first_p);
+        m_size = 0;
+    }
+
+    i64 size() const
+    {
+        return m_size;
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(m_first_p, 0);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(nullptr, 0);
+    }
+
+    bool operator==(const BTree& other) const
+    {
+        if (m_size != other.m_size) {
+            return false;
+        }
+
+        return std::equal(begin(), end(), other.begin());
+    }
+};
+
+template<typename TK, typename TV>
+class BTreeMap final : public BTree<TK, std::pair<TK, TV>>
+{
+public:
+    TV& operator[](const TK& key)
+    {
+        return this->insert_item(key, key, TV()).first->second;
+    }
+};
+
+template<typename T>
+class BTreeSet final : public BTree<T, T>
+{
+public:
+    // Returns true if inserted.
+    bool insert(const T& key)
+    {
+        return this->insert_item(key, key).second;
+    }
+};
+
+}
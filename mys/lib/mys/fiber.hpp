@@ -1,7 +1,16 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
 #include "uv.h"
 
+#if defined(MYS_MULTI_CORE)
+#    include <atomic>
+#    include <thread>
+#endif
+
 namespace mys {
 
 class Fiber : public Object {
@@ -10,18 +19,35 @@ public:
 
     Fiber();
 
-    virtual ~Fiber() {}
+    virtual ~Fiber();
 
     virtual void run() = 0;
 
     String __str__();
 };
 
-void start(const mys::shared_ptr<Fiber>& fiber);
+// Start given fiber with a stack of given size in bytes, or the
+// default size if zero.
+void start(const mys::shared_ptr<Fiber>& fiber, u64 stack_size = 0);
+
+// Wait for given fiber to stop, for at most given number of seconds
+// unless negative. Returns 0, UV_ECANCELED or UV_ETIMEDOUT.
+int join(const mys::shared_ptr<Fiber>& fiber, f64 timeout = -1.0);
+
+// Why a fiber suspended, recorded in fiber statistics.
+enum class SuspendReason {
+    // Called suspend() directly.
+    OTHER = 0,
+    SLEEP,
+    // Waiting for a queue, lock, event, semaphore or condition.
+    WAIT,
+    JOIN,
+    IO
+};
 
-bool join(const mys::shared_ptr<Fiber>& fiber);
+#define MYS_SUSPEND_REASONS 5
 
-bool suspend();
+bool suspend(SuspendReason reason = SuspendReason::OTHER);
 
 void resume(const mys::shared_ptr<Fiber>& fiber);
 
@@ -31,6 +57,442 @@ mys::shared_ptr<Fiber> current();
 
 bool sleep(f64 seconds);
 
+// Call given function in the thread running the libuv loop, which is
+// the only thread that may use it. Called at once in single-core
+// builds, where all fibers run in the loop's thread.
+void call_in_reactor(std::function<void()> function);
+
+// An operation started by a fiber and completed by the reactor.
+class Operation {
+private:
+    mys::shared_ptr<Fiber> m_fiber;
+    bool m_done;
+#if defined(MYS_MULTI_CORE)
+    std::mutex m_mutex;
+#endif
+
+    void lock();
+    void unlock();
+
+public:
+    // A libuv status code or a size.
+    ssize_t result;
+
+    Operation();
+
+    // Prepare for a new operation. Called by the fiber.
+    void start();
+
+    // Called by the reactor once the operation is complete. Resumes the
+    // waiting fiber, if any.
+    void complete(ssize_t result);
+
+    // Suspends current fiber until the operation is complete. Given
+    // function is called in the reactor if the fiber is cancelled, and
+    // should complete the operation as soon as possible. Returns true
+    // if cancelled.
+    bool wait(std::function<void()> abort = nullptr);
+};
+
+// Call given function in the reactor and wait for it to return. Returns
+// what the function returned, or UV_ECANCELED if current fiber was
+// cancelled.
+ssize_t call_in_reactor_and_wait(std::function<ssize_t()> function);
+
+// Call given function in a thread of a fixed size thread pool, and
+// suspend current fiber until it returns, so other fibers run while it
+// uses the CPU or blocks. Given error is set to the error raised by the
+// function, if any. Returns true if current fiber was cancelled, once
+// the function has returned.
+bool call_in_thread(const std::function<void()>& function,
+                    mys::shared_ptr<Error>& error);
+
+struct StackPoolStatistics {
+    // Number of stacks used by fibers.
+    i64 in_use;
+    // Number of unused stacks kept for reuse.
+    i64 free;
+    // Number of stacks allocated.
+    i64 allocated;
+    // Number of times a stack was reused instead of allocated.
+    i64 reused;
+};
+
+StackPoolStatistics stack_pool_statistics();
+
+// Scheduler statistics of a fiber, recorded while statistics are
+// enabled. Times are in nanoseconds.
+struct FiberStatistics {
+    // Time running.
+    u64 run_time;
+    // Time ready to run, but not running.
+    u64 ready_time;
+    // Number of times switched to and from.
+    u64 switches_in;
+    u64 switches_out;
+    // Number of suspends per reason.
+    u64 suspends[MYS_SUSPEND_REASONS];
+};
+
+// Bucket 0 counts durations shorter than one microsecond, and bucket i
+// durations of at least 2^(i-1) and less than 2^i microseconds. The
+// last bucket also counts all longer durations.
+#define MYS_HISTOGRAM_BUCKETS 32
+
+struct SchedulerStatistics {
+    // Time from a fiber being made ready until it runs.
+    u64 ready_latency[MYS_HISTOGRAM_BUCKETS];
+    // Time the scheduler waits for events with no fiber ready to run.
+    u64 idle_time[MYS_HISTOGRAM_BUCKETS];
+};
+
+// Statistics are disabled by default, or enabled by setting the
+// environment variable MYS_FIBER_STATISTICS to yes. Enabling resets
+// all statistics.
+void enable_statistics(bool enabled);
+
+FiberStatistics fiber_statistics(const mys::shared_ptr<Fiber>& fiber);
+
+SchedulerStatistics scheduler_statistics();
+
+// Print scheduler statistics and statistics of all fibers that are not
+// stopped. Also printed to standard error on SIGUSR1.
+void print_statistics(std::ostream& os);
+
+// Protects short critical sections shared between worker threads in
+// multi-core builds, and does nothing otherwise.
+class SpinLock {
+#if defined(MYS_MULTI_CORE)
+private:
+    std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+
+public:
+    void lock()
+    {
+        int spins = 0;
+
+        while (m_flag.test_and_set(std::memory_order_acquire)) {
+            // Let the holder run if it was preempted.
+            if (++spins == 100) {
+                std::this_thread::yield();
+                spins = 0;
+            }
+        }
+    }
+
+    void unlock()
+    {
+        m_flag.clear(std::memory_order_release);
+    }
+#else
+public:
+    void lock()
+    {
+    }
+
+    void unlock()
+    {
+    }
+#endif
+};
+
+// A timer resuming a fiber when it expires, used for sleeps and wait
+// timeouts. Lives on the fiber's stack and is stopped when destroyed.
+// Timers are kept in the scheduler's timer wheel, where starting and
+// stopping them is O(1).
+class FiberTimer {
+private:
+    friend class TimerWheel;
+
+    enum State {
+        STOPPED = 0,
+        RUNNING,
+        // Expired and the fiber is being resumed.
+        FIRING,
+        EXPIRED
+    };
+
+    FiberTimer *m_next_p;
+    FiberTimer *m_prev_p;
+    // Head of the timer wheel list the timer is in when running.
+    FiberTimer **m_head_pp;
+    void *m_fiber_p;
+    // Millisecond tick the timer expires at.
+    u64 m_expiry;
+    f64 m_seconds;
+#if defined(MYS_MULTI_CORE)
+    std::atomic<int> m_state;
+#else
+    int m_state;
+#endif
+
+public:
+    // Never expires if given number of seconds is negative.
+    FiberTimer(f64 seconds);
+
+    ~FiberTimer();
+
+    // Start the timer for current fiber, unless already started or it
+    // never expires.
+    void start();
+
+    // Returns once the timer no longer may resume the fiber.
+    void stop();
+
+    // True if expired, and always if zero seconds.
+    bool has_expired();
+};
+
+// A fiber in a wait list. Lives on the waiting fiber's stack, so
+// waiting never allocates.
+struct Waiter {
+    Waiter *next_p;
+    Waiter *prev_p;
+    void *fiber_p;
+    bool woken;
+};
+
+// Fibers waiting for a queue, lock, event, semaphore or condition, in
+// the order they started waiting. Protected by the lock of the
+// primitive it belongs to.
+class WaitList {
+private:
+    Waiter *m_head_p;
+    Waiter *m_tail_p;
+
+    void remove(Waiter& waiter);
+
+public:
+    WaitList();
+
+    bool empty() const
+    {
+        return m_head_p == nullptr;
+    }
+
+    // Suspends current fiber at the end of the list until woken,
+    // cancelled or given timer expires. The timer is started if not
+    // already started. Given lock is held when called and when
+    // returning, but not while suspended. Returns 0 if woken, otherwise
+    // UV_ECANCELED or UV_ETIMEDOUT, with woken telling if the fiber was
+    // also woken when cancelled. Woken is also set if an error is
+    // raised.
+    int wait(SpinLock& lock,
+             bool& woken,
+             FiberTimer& timer,
+             SuspendReason reason = SuspendReason::WAIT);
+
+    // Wakes the first fiber in the list. Returns false if empty.
+    bool wake_one();
+
+    void wake_all();
+};
+
+// A FIFO queue with any number of readers and writers. Values are
+// stored in a ring buffer given by the caller, as only generated code
+// knows their type. Bounded queues suspend writers while full.
+class FiberQueue {
+private:
+    SpinLock m_lock;
+    size_t m_head;
+    size_t m_length;
+    size_t m_capacity;
+    WaitList m_getters;
+    WaitList m_putters;
+
+    // Passes on a wakeup to the next waiter if a woken fiber was
+    // cancelled before it could use it.
+    int wait(WaitList& list, FiberTimer& timer);
+
+public:
+    FiberQueue() : m_head(0), m_length(0), m_capacity(0)
+    {
+    }
+
+    // Unbounded if zero, which is the default. Must be set before the
+    // queue is used.
+    void set_capacity(size_t capacity)
+    {
+        m_capacity = capacity;
+    }
+
+    // Waits for at most given number of seconds while full, unless
+    // negative. Returns 0, or UV_ECANCELED or UV_ETIMEDOUT without
+    // putting the value.
+    template<typename T> int put(std::vector<T>& values,
+                                 const T& value,
+                                 f64 timeout = -1.0)
+    {
+        FiberTimer timer(timeout);
+        std::lock_guard<SpinLock> guard(m_lock);
+
+        while ((m_capacity > 0) && (m_length == m_capacity)) {
+            int status = wait(m_putters, timer);
+
+            if (status != 0) {
+                return status;
+            }
+        }
+
+        if (m_length == values.size()) {
+            // Grow, with the oldest value first.
+            std::rotate(values.begin(), values.begin() + m_head, values.end());
+            m_head = 0;
+            values.resize(std::max(values.size() * 2, (size_t)16));
+        }
+
+        values[(m_head + m_length) % values.size()] = value;
+        m_length++;
+        m_getters.wake_one();
+
+        return 0;
+    }
+
+    // Waits for at most given number of seconds while empty, unless
+    // negative. Returns 0, or UV_ECANCELED or UV_ETIMEDOUT without
+    // getting a value.
+    template<typename T> int get(std::vector<T>& values,
+                                 T& value,
+                                 f64 timeout = -1.0)
+    {
+        FiberTimer timer(timeout);
+        std::lock_guard<SpinLock> guard(m_lock);
+
+        while (m_length == 0) {
+            int status = wait(m_getters, timer);
+
+            if (status != 0) {
+                return status;
+            }
+        }
+
+        // Drop the queue's reference to the value.
+        value = std::move(values[m_head]);
+        values[m_head] = T();
+        m_head = (m_head + 1) % values.size();
+        m_length--;
+        m_putters.wake_one();
+
+        return 0;
+    }
+
+    size_t length()
+    {
+        std::lock_guard<SpinLock> guard(m_lock);
+
+        return m_length;
+    }
+};
+
+// A lock acquired by waiting fibers in the order they tried to, as
+// release() hands it over to the first waiter.
+class FiberLock {
+private:
+    SpinLock m_lock;
+    bool m_is_acquired;
+    WaitList m_waiters;
+
+    void release_locked();
+
+public:
+    FiberLock() : m_is_acquired(false)
+    {
+    }
+
+    // Waits for at most given number of seconds, unless negative.
+    // Returns 0, or UV_ECANCELED or UV_ETIMEDOUT without acquiring the
+    // lock.
+    int acquire(f64 timeout = -1.0);
+
+    bool try_acquire();
+
+    void release();
+
+    bool is_acquired()
+    {
+        return m_is_acquired;
+    }
+};
+
+class FiberEvent {
+private:
+    SpinLock m_lock;
+    bool m_is_set;
+    WaitList m_waiters;
+
+public:
+    FiberEvent() : m_is_set(false)
+    {
+    }
+
+    // Wakes all waiting fibers.
+    void set();
+
+    void clear();
+
+    bool is_set()
+    {
+        return m_is_set;
+    }
+
+    // Waits for at most given number of seconds, unless negative.
+    // Returns 0, UV_ECANCELED or UV_ETIMEDOUT.
+    int wait(f64 timeout = -1.0);
+};
+
+// A counting semaphore. Released values are handed over to waiting
+// fibers in the order they started waiting.
+class FiberSemaphore {
+private:
+    SpinLock m_lock;
+    i64 m_count;
+    WaitList m_waiters;
+
+    void release_locked();
+
+public:
+    FiberSemaphore() : m_count(0)
+    {
+    }
+
+    // Must be set before the semaphore is used.
+    void set_count(i64 count)
+    {
+        m_count = count;
+    }
+
+    // Waits for at most given number of seconds, unless negative.
+    // Returns 0, or UV_ECANCELED or UV_ETIMEDOUT without acquiring.
+    int acquire(f64 timeout = -1.0);
+
+    bool try_acquire();
+
+    void release();
+
+    i64 count()
+    {
+        return m_count;
+    }
+};
+
+class FiberCondition {
+private:
+    SpinLock m_lock;
+    WaitList m_waiters;
+
+public:
+    // Releases given lock, waits to be notified for at most given
+    // number of seconds unless negative, and acquires the lock again,
+    // also if cancelled or timed out. Returns 0, UV_ECANCELED or
+    // UV_ETIMEDOUT.
+    int wait(FiberLock& lock, f64 timeout = -1.0);
+
+    // Wakes given number of waiting fibers.
+    void notify(i64 count);
+
+    void notify_all();
+};
+
 void init();
 
 }
@@ -0,0 +1,760 @@
+#pragma once
+
+#include <algorithm>
+#include "common.hpp"
+#include "hash.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mys {
+
+// An insertion ordered open-addressing hash table, the storage of
+// FlatMap and FlatSet below. TItem is either a key-value pair or just
+// the key.
+//
+// Entries are appended to a dense array in insertion order, and a
+// sparse index in the style of Swiss tables maps hashes to entry
+// positions. The index has one control byte and one 32 bits entry
+// position per slot. A control byte is either empty, deleted or the
+// low 7 bits of the entry's hash. Lookups probe one group of control
+// bytes at a time, which is a single SSE2 compare when available, and
+// only compare keys of slots whose 7 hash bits match.
+//
+// The first GROUP_WIDTH control bytes are mirrored after the last
+// slot, so a group can be loaded at any position without wrapping.
+//
+// Erased entries leave holes in the dense array until the next
+// rehash, which compacts it unless the table is being walked by
+// index. Iteration is a linear scan of the dense array, in insertion
+// order.
+template<typename TK, typename TItem>
+class FlatTable
+{
+public:
+    using value_type = TItem;
+
+protected:
+    using ctrl_t = i8;
+
+    static constexpr ctrl_t EMPTY = -128;
+    static constexpr ctrl_t DELETED = -2;
+    static constexpr i64 GROUP_WIDTH = 16;
+    static constexpr i64 MIN_CAPACITY = GROUP_WIDTH;
+    // Hash of holes. Never returned by hash().
+    static constexpr u64 HOLE = (1ull << 63);
+
+    struct Entry {
+        value_type m_item;
+        u64 m_hash;
+    };
+
+    std::vector<Entry> m_entries;
+    std::unique_ptr<ctrl_t[]> m_ctrl;
+    std::unique_ptr<u32[]> m_indices;
+    i64 m_capacity;
+    i64 m_size;
+    // Slots that can be used before the index must be rebuilt.
+    i64 m_growth_left;
+    // Number of walks in progress. Holes are kept while positive, so
+    // entry positions do not change.
+    i64 m_walkers;
+
+    class BitMask {
+    public:
+        u32 m_mask;
+
+        BitMask(u32 mask) : m_mask(mask)
+        {
+        }
+
+        explicit operator bool() const
+        {
+            return m_mask != 0;
+        }
+
+        i64 lowest() const
+        {
+            return __builtin_ctz(m_mask);
+        }
+
+        void clear_lowest()
+        {
+            m_mask &= (m_mask - 1);
+        }
+    };
+
+#if defined(__SSE2__)
+    class Group {
+        __m128i m_ctrl;
+
+    public:
+        Group(const ctrl_t *ctrl_p)
+            : m_ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl_p)))
+        {
+        }
+
+        BitMask match(ctrl_t h2) const
+        {
+            return BitMask(_mm_movemask_epi8(
+                               _mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)));
+        }
+
+        BitMask match_empty() const
+        {
+            return match(EMPTY);
+        }
+
+        BitMask match_empty_or_deleted() const
+        {
+            // Empty and deleted are the only negative control bytes
+            // less than -1.
+            return BitMask(_mm_movemask_epi8(
+                               _mm_cmpgt_epi8(_mm_set1_epi8(-1), m_ctrl)));
+        }
+    };
+#else
+    class Group {
+        const ctrl_t *m_ctrl_p;
+
+    public:
+        Group(const ctrl_t *ctrl_p) : m_ctrl_p(ctrl_p)
+        {
+        }
+
+        BitMask match(ctrl_t h2) const
+        {
+            u32 mask = 0;
+
+            for (i64 i = 0; i < GROUP_WIDTH; i++) {
+                if (m_ctrl_p[i] == h2) {
+                    mask |= (1 << i);
+                }
+            }
+
+            return BitMask(mask);
+        }
+
+        BitMask match_empty() const
+        {
+            return match(EMPTY);
+        }
+
+        BitMask match_empty_or_deleted() const
+        {
+            u32 mask = 0;
+
+            for (i64 i = 0; i < GROUP_WIDTH; i++) {
+                if (m_ctrl_p[i] < -1) {
+                    mask |= (1 << i);
+                }
+            }
+
+            return BitMask(mask);
+        }
+    };
+#endif
+
+    // Keys may be looked up with any type that std::hash<TK> accepts
+    // and that compares equal to TK, for example string views.
+    template<typename TKey>
+    static u64 hash(const TKey& key)
+    {
+        // std::hash is the identity for integers, so mix the bits to
+        // make both the probe start and the 7 control bits useful.
+        u64 value = std::hash<TK>()(key) * 0x9e3779b97f4a7c15ull;
+
+        return (value ^ (value >> 32)) & ~HOLE;
+    }
+
+    static const TK& key_of(const TK& item)
+    {
+        return item;
+    }
+
+    template<typename TV>
+    static const TK& key_of(const std::pair<TK, TV>& item)
+    {
+        return item.first;
+    }
+
+    static i64 h1(u64 hash)
+    {
+        return hash >> 7;
+    }
+
+    static ctrl_t h2(u64 hash)
+    {
+        return hash & 0x7f;
+    }
+
+    static i64 growth_limit(i64 capacity)
+    {
+        return capacity - capacity / 8;
+    }
+
+    void set_ctrl(i64 slot, ctrl_t ctrl)
+    {
+        m_ctrl[slot] = ctrl;
+
+        if (slot < GROUP_WIDTH) {
+            m_ctrl[m_capacity + slot] = ctrl;
+        }
+    }
+
+    // Index slot of given key, or -1 if missing.
+    template<typename TKey>
+    i64 find_slot(const TKey& key, u64 hashed) const
+    {
+        if (m_capacity == 0) {
+            return -1;
+        }
+
+        i64 mask = m_capacity - 1;
+        i64 offset = (h1(hashed) & mask);
+        i64 step = 0;
+
+        while (true) {
+            Group group(&m_ctrl[offset]);
+
+            for (auto match = group.match(h2(hashed)); match; match.clear_lowest()) {
+                i64 slot = ((offset + match.lowest()) & mask);
+                const Entry& entry = m_entries[m_indices[slot]];
+
+                if (entry.m_hash == hashed && keys_equal(key_of(entry.m_item), key)) {
+                    return slot;
+                }
+            }
+
+            if (group.match_empty()) {
+                return -1;
+            }
+
+            step += GROUP_WIDTH;
+            offset = ((offset + step) & mask);
+        }
+    }
+
+    // Index slot of the entry at given position.
+    i64 find_slot_of_entry(i64 index) const
+    {
+        u64 hashed = m_entries[index].m_hash;
+        i64 mask = m_capacity - 1;
+        i64 offset = (h1(hashed) & mask);
+        i64 step = 0;
+
+        while (true) {
+            Group group(&m_ctrl[offset]);
+
+            for (auto match = group.match(h2(hashed)); match; match.clear_lowest()) {
+                i64 slot = ((offset + match.lowest()) & mask);
+
+                if (m_indices[slot] == index) {
+                    return slot;
+                }
+            }
+
+            step += GROUP_WIDTH;
+            offset = ((offset + step) & mask);
+        }
+    }
+
+    i64 find_first_non_full(u64 hashed) const
+    {
+        i64 mask = m_capacity - 1;
+        i64 offset = (h1(hashed) & mask);
+        i64 step = 0;
+
+        while (true) {
+            auto match = Group(&m_ctrl[offset]).match_empty_or_deleted();
+
+            if (match) {
+                return ((offset + match.lowest()) & mask);
+            }
+
+            step += GROUP_WIDTH;
+            offset = ((offset + step) & mask);
+        }
+    }
+
+    // Remove holes from the entries array, unless walked, and rebuild
+    // the index with given capacity. Stored hashes are reused, keys are
+    // not hashed again.
+    void rehash(i64 capacity)
+    {
+        if ((i64)m_entries.size() != m_size && m_walkers == 0) {
+            auto end = std::remove_if(m_entries.begin(),
+                                      m_entries.end(),
+                                      [](const Entry& entry) {
+                                          return entry.m_hash == HOLE;
+                                      });
+            m_entries.erase(end, m_entries.end());
+        }
+
+        m_ctrl = std::make_unique<ctrl_t[]>(capacity + GROUP_WIDTH);
+        std::fill(&m_ctrl[0], &m_ctrl[capacity + GROUP_WIDTH], EMPTY);
+        m_indices = std::make_unique<u32[]>(capacity);
+        m_capacity = capacity;
+        m_growth_left = growth_limit(capacity) - m_size;
+
+        for (i64 i = 0; i < (i64)m_entries.size(); i++) {
+            u64 hashed = m_entries[i].m_hash;
+
+            if (hashed == HOLE) {
+                continue;
+            }
+
+            i64 slot = find_first_non_full(hashed);
+            set_ctrl(slot, h2(hashed));
+            m_indices[slot] = i;
+        }
+    }
+
+    // Grow, or just drop deleted slots if the index is mostly
+    // tombstones.
+    void make_room()
+    {
+        if (m_capacity == 0) {
+            rehash(MIN_CAPACITY);
+        } else if (m_size < growth_limit(m_capacity) / 2) {
+            rehash(m_capacity);
+        } else {
+            rehash(2 * m_capacity);
+        }
+    }
+
+    // Append an entry created from given arguments and add it to the
+    // index. Returns the entry's position. The entry is created first
+    // as the arguments may refer to entries moved when making room.
+    template<typename... TArgs>
+    i64 insert_entry(u64 hashed, const TArgs&... args)
+    {
+        Entry entry{value_type(args...), hashed};
+
+        if (m_capacity == 0) {
+            make_room();
+        }
+
+        i64 slot = find_first_non_full(hashed);
+
+        if (m_growth_left == 0 && m_ctrl[slot] != DELETED) {
+            make_room();
+            slot = find_first_non_full(hashed);
+        }
+
+        if (m_ctrl[slot] == EMPTY) {
+            m_growth_left--;
+        }
+
+        i64 index = m_entries.size();
+        m_entries.push_back(std::move(entry));
+        set_ctrl(slot, h2(hashed));
+        m_indices[slot] = index;
+        m_size++;
+
+        return index;
+    }
+
+public:
+    template<typename TMap, typename TValue>
+    class Iterator {
+        TMap *m_map_p;
+        i64 m_index;
+
+        void skip_holes()
+        {
+            while (m_index < (i64)m_map_p->m_entries.size()
+                   && m_map_p->m_entries[m_index].m_hash == HOLE) {
+                m_index++;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TValue;
+        using difference_type = i64;
+        using pointer = TValue *;
+        using reference = TValue&;
+
+        Iterator(TMap *map_p, i64 index) : m_map_p(map_p), m_index(index)
+        {
+            skip_holes();
+        }
+
+        TValue& operator*() const
+        {
+            return m_map_p->m_entries[m_index].m_item;
+        }
+
+        TValue *operator->() const
+        {
+            return &m_map_p->m_entries[m_index].m_item;
+        }
+
+        Iterator& operator++()
+        {
+            m_index++;
+            skip_holes();
+
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator it = *this;
+            ++(*this);
+
+            return it;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return m_index == other.m_index;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return m_index != other.m_index;
+        }
+
+        friend class FlatTable;
+    };
+
+    using iterator = Iterator<FlatTable, value_type>;
+    using const_iterator = Iterator<const FlatTable, const value_type>;
+
+    // Visits the items by entry position, copying one item at a time,
+    // so the table may be changed during the walk. Items added during
+    // the walk are not visited.
+    class Walk {
+        FlatTable *m_table_p;
+        i64 m_end;
+
+    public:
+        class Iterator {
+            FlatTable *m_table_p;
+            i64 m_index;
+            i64 m_end;
+            value_type m_item;
+
+            // Copy the item at current position, or the next one if it
+            // was erased.
+            void load()
+            {
+                i64 end = std::min(m_end, (i64)m_table_p->m_entries.size());
+
+                while (m_index < end
+                       && m_table_p->m_entries[m_index].m_hash == HOLE) {
+                    m_index++;
+                }
+
+                if (m_index < end) {
+                    m_item = m_table_p->m_entries[m_index].m_item;
+                } else {
+                    m_index = m_end;
+                }
+            }
+
+        public:
+            Iterator(FlatTable *table_p, i64 index, i64 end)
+                : m_table_p(table_p), m_index(index), m_end(end)
+            {
+                load();
+            }
+
+            value_type& operator*()
+            {
+                return m_item;
+            }
+
+            Iterator& operator++()
+            {
+                m_index++;
+                load();
+
+                return *this;
+            }
+
+            bool operator!=(const Iterator& other) const
+            {
+                return m_index != other.m_index;
+            }
+        };
+
+        Walk(FlatTable *table_p)
+            : m_table_p(table_p), m_end(table_p->m_entries.size())
+        {
+            m_table_p->m_walkers++;
+        }
+
+        Walk(const Walk&) = delete;
+
+        ~Walk()
+        {
+            m_table_p->m_walkers--;
+        }
+
+        Iterator begin() const
+        {
+            return Iterator(m_table_p, 0, m_end);
+        }
+
+        Iterator end() const
+        {
+            return Iterator(m_table_p, m_end, m_end);
+        }
+    };
+
+    FlatTable() : m_capacity(0), m_size(0), m_growth_left(0), m_walkers(0)
+    {
+    }
+
+    // Copies the entries and their hashes. Keys are not hashed again.
+    FlatTable(const FlatTable& other) : FlatTable()
+    {
+        if (other.m_size > 0) {
+            m_entries = other.m_entries;
+            m_size = other.m_size;
+            rehash(other.m_capacity);
+        }
+    }
+
+    FlatTable(FlatTable&& other) noexcept : FlatTable()
+    {
+        swap(other);
+    }
+
+    FlatTable& operator=(FlatTable other)
+    {
+        swap(other);
+
+        return *this;
+    }
+
+    void swap(FlatTable& other) noexcept
+    {
+        std::swap(m_entries, other.m_entries);
+        std::swap(m_ctrl, other.m_ctrl);
+        std::swap(m_indices, other.m_indices);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_growth_left, other.m_growth_left);
+    }
+
+    template<typename TKey>
+    iterator find(const TKey& key)
+    {
+        i64 slot = find_slot(key, hash(key));
+
+        return iterator(this, slot == -1 ? m_entries.size() : m_indices[slot]);
+    }
+
+    template<typename TKey>
+    const_iterator find(const TKey& key) const
+    {
+        i64 slot = find_slot(key, hash(key));
+
+        return const_iterator(this,
+                              slot == -1 ? m_entries.size() : m_indices[slot]);
+    }
+
+    template<typename TKey>
+    bool contains(const TKey& key) const
+    {
+        return find_slot(key, hash(key)) != -1;
+    }
+
+    void erase(const iterator& it)
+    {
+        set_ctrl(find_slot_of_entry(it.m_index), DELETED);
+        m_size--;
+
+        if (it.m_index == (i64)m_entries.size() - 1 && m_walkers == 0) {
+            m_entries.pop_back();
+        } else {
+            // Release the key and value now, not at next rehash.
+            m_entries[it.m_index] = Entry{value_type(), HOLE};
+        }
+    }
+
+    void clear()
+    {
+        if (m_walkers == 0) {
+            m_entries.clear();
+        } else {
+            for (auto& entry : m_entries) {
+                entry = Entry{value_type(), HOLE};
+            }
+        }
+
+        m_ctrl.reset();
+        m_indices.reset();
+        m_capacity = 0;
+        m_size = 0;
+        m_growth_left = 0;
+    }
+
+    void reserve(i64 size)
+    {
+        i64 capacity = MIN_CAPACITY;
+
+        while (growth_limit(capacity) < size) {
+            capacity *= 2;
+        }
+
+        m_entries.reserve(size);
+
+        if (capacity > m_capacity) {
+            rehash(capacity);
+        }
+    }
+
+    i64 size() const
+    {
+        return m_size;
+    }
+
+    Walk walk()
+    {
+        return Walk(this);
+    }
+
+    iterator begin()
+    {
+        return iterator(this, 0);
+    }
+
+    iterator end()
+    {
+        return iterator(this, m_entries.size());
+    }
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const
+    {
+        return const_iterator(this, m_entries.size());
+    }
+};
+
+// An insertion ordered hash map.
+template<typename TK, typename TV>
+class FlatMap final : public FlatTable<TK, std::pair<TK, TV>>
+{
+    using Base = FlatTable<TK, std::pair<TK, TV>>;
+
+public:
+    using typename Base::iterator;
+
+    template<typename TIterator>
+    void insert(TIterator begin, TIterator end)
+    {
+        for (; begin != end; ++begin) {
+            emplace(begin->first, begin->second);
+        }
+    }
+
+    // Insert given key-value pair if the key is missing. Returns an
+    // iterator to the entry with given key and whether it was
+    // inserted.
+    std::pair<iterator, bool> emplace(const TK& key, const TV& value)
+    {
+        u64 hashed = Base::hash(key);
+        i64 slot = this->find_slot(key, hashed);
+
+        if (slot != -1) {
+            return {iterator(this, this->m_indices[slot]), false};
+        }
+
+        return {iterator(this, this->insert_entry(hashed, key, value)), true};
+    }
+
+    TV& operator[](const TK& key)
+    {
+        u64 hashed = Base::hash(key);
+        i64 slot = this->find_slot(key, hashed);
+        i64 index;
+
+        if (slot == -1) {
+            index = this->insert_entry(hashed, key, TV());
+        } else {
+            index = this->m_indices[slot];
+        }
+
+        return this->m_entries[index].m_item.second;
+    }
+
+    bool operator==(const FlatMap& other) const
+    {
+        if (this->size() != other.size()) {
+            return false;
+        }
+
+        for (const auto& item : *this) {
+            auto it = other.find(item.first);
+
+            if (it == other.end() || !(it->second == item.second)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+// An insertion ordered hash set.
+template<typename T>
+class FlatSet final : public FlatTable<T, T>
+{
+    using Base = FlatTable<T, T>;
+
+public:
+    // Returns true if given value was added, false if already present.
+    bool insert(const T& value)
+    {
+        u64 hashed = Base::hash(value);
+
+        if (this->find_slot(value, hashed) != -1) {
+            return false;
+        }
+
+        this->insert_entry(hashed, value);
+
+        return true;
+    }
+
+    // Returns true if given value was removed, false if missing.
+    bool erase(const T& value)
+    {
+        auto it = this->find(value);
+
+        if (it == this->end()) {
+            return false;
+        }
+
+        Base::erase(it);
+
+        return true;
+    }
+
+    bool operator==(const FlatSet& other) const
+    {
+        if (this->size() != other.size()) {
+            return false;
+        }
+
+        for (const auto& value : *this) {
+            if (!other.contains(value)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace mys {
+
+// Mix an item hash into the hash of a composite key. Item hashes are
+// often the identity (integers), so spread them before combining.
+static inline std::size_t hash_combine(std::size_t hash, std::size_t value)
+{
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+// Equality of hash table keys. Overloaded for tuples, which compare
+// item by item, and for class instances, which use their __eq__()
+// method.
+template<typename TA, typename TB> bool
+keys_equal(const TA& a, const TB& b)
+{
+    return a == b;
+}
+
+}
@@ -25,8 +25,9 @@ extern long long number_of_object_frees;
 #    define INCREMENT_NUMBER_OF_OBJECT_FREES
 #endif
 
-// A shared pointer class for single threaded applications made
-// specifically for Mys.
+// A shared pointer class made specifically for Mys. The reference
+// count is only atomic in multi-core builds, where objects may be
+// shared between threads.
 template<class T>
 class shared_ptr final
 {
@@ -42,7 +43,7 @@ public:
     shared_ptr(T *ptr) noexcept
     {
         m_buf_p = (((int *)ptr) - 1);
-        count() += 1;
+        increment();
     }
 
     shared_ptr(std::nullptr_t) noexcept
@@ -54,7 +55,7 @@ public:
         : m_buf_p(other.m_buf_p)
     {
         if (m_buf_p != nullptr) {
-            count() += 1;
+            increment();
         }
     }
 
@@ -62,7 +63,7 @@ public:
     shared_ptr(const shared_ptr<U>& ptr) noexcept
         : m_buf_p(ptr.m_buf_p)
     {
-        count() += 1;
+        increment();
     }
 
     ~shared_ptr()
@@ -72,12 +73,26 @@ public:
         }
     }
 
+    void increment() const noexcept
+    {
+#if defined(MYS_MULTI_CORE)
+        __atomic_add_fetch(&count(), 1, __ATOMIC_RELAXED);
+#else
+        count() += 1;
+#endif
+    }
+
     void decrement()
     {
         INCREMENT_NUMBER_OF_OBJECT_DECREMENTS;
+
+#if defined(MYS_MULTI_CORE)
+        if (__atomic_sub_fetch(&count(), 1, __ATOMIC_ACQ_REL) == 0) {
+#else
         count() -= 1;
 
         if (count() == 0) {
+#endif
             std::destroy_at(get());
             std::free(m_buf_p);
             DECREMENT_NUMBER_OF_ALLOCATED_OBJECTS;
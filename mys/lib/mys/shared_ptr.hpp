@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common.hpp"
+#include "hash.hpp"
 
 namespace mys {
 
@@ -70,4 +71,30 @@ static inline bool is(void *a, void *b)
     return a == b;
 }
 
+// Class instances used as keys must define __eq__() and __hash__().
+template<typename T> bool
+keys_equal(const mys::shared_ptr<T>& a, const mys::shared_ptr<T>& b)
+{
+    if (!a || !b) {
+        return !a && !b;
+    }
+
+    return a.m_buf_p == b.m_buf_p || a->__eq__(b);
+}
+
+}
+
+namespace std
+{
+    template<typename T> struct hash<mys::shared_ptr<T>>
+    {
+        std::size_t operator()(mys::shared_ptr<T> const& obj) const
+        {
+            if (obj) {
+                return obj->__hash__();
+            } else {
+                return 0;
+            }
+        }
+    };
 }
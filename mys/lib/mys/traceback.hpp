@@ -55,7 +55,9 @@ struct TracebackEntry {
     TracebackEntry *prev_p;
 };
 
-extern TracebackEntry *traceback_bottom_p;
-extern TracebackEntry *traceback_top_p;
+// Each worker thread runs its own fiber in multi-core builds, and
+// thread pool threads call functions for fibers in all builds.
+extern thread_local TracebackEntry *traceback_bottom_p;
+extern thread_local TracebackEntry *traceback_top_p;
 
 }
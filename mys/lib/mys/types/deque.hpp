@@ -0,0 +1,301 @@
+#pragma once
+
+#include "../common.hpp"
+#include "../utils.hpp"
+#include "string.hpp"
+#include "list.hpp"
+
+namespace mys {
+
+// Double-ended queues.
+//
+// A chunked ring buffer. Items are stored in fixed size chunks, and
+// the chunks in a ring of chunk pointers. Both the number of chunks
+// and the chunk size are powers of two, so an item's slot is found
+// with a mask and a shift. Growing the ring moves chunk pointers, not
+// items, so push and pop at both ends are O(1) (amortized for push).
+template<typename T>
+class Deque final
+{
+    static constexpr i64 chunk_shift()
+    {
+        i64 shift = 3;
+
+        while (shift < 8 && ((i64)sizeof(T) << (shift + 1)) <= 512) {
+            shift++;
+        }
+
+        return shift;
+    }
+
+    static constexpr i64 CHUNK_SHIFT = chunk_shift();
+    static constexpr i64 CHUNK_SIZE = (1 << CHUNK_SHIFT);
+    static constexpr i64 CHUNK_MASK = (CHUNK_SIZE - 1);
+
+    std::vector<std::unique_ptr<T[]>> m_chunks;
+    // Ring slot of the first item.
+    i64 m_head;
+    i64 m_size;
+
+    i64 capacity() const
+    {
+        return m_chunks.size() << CHUNK_SHIFT;
+    }
+
+    T& slot(i64 index) const
+    {
+        index &= (capacity() - 1);
+
+        return m_chunks[index >> CHUNK_SHIFT][index & CHUNK_MASK];
+    }
+
+    // Double the number of chunks. The ring is rotated so that the
+    // chunk with the first item becomes chunk 0. If the ring is full
+    // and the first item is not at the start of its chunk, the items
+    // wrapped into the beginning of that chunk are moved to a new
+    // chunk after the last old one.
+    void grow()
+    {
+        i64 nchunks = m_chunks.size();
+
+        if (nchunks == 0) {
+            m_chunks.push_back(std::make_unique<T[]>(CHUNK_SIZE));
+            m_head = 0;
+
+            return;
+        }
+
+        std::vector<std::unique_ptr<T[]>> chunks;
+        i64 first_chunk = (m_head >> CHUNK_SHIFT);
+        i64 offset = (m_head & CHUNK_MASK);
+        chunks.reserve(2 * nchunks);
+
+        for (i64 i = 0; i < nchunks; i++) {
+            chunks.push_back(std::move(m_chunks[(first_chunk + i) & (nchunks - 1)]));
+        }
+
+        for (i64 i = 0; i < nchunks; i++) {
+            chunks.push_back(std::make_unique<T[]>(CHUNK_SIZE));
+        }
+
+        for (i64 i = 0; i < offset; i++) {
+            chunks[nchunks][i] = std::move(chunks[0][i]);
+            chunks[0][i] = T();
+        }
+
+        m_chunks = std::move(chunks);
+        m_head = offset;
+    }
+
+    i64 checked_index(i64 index, const char *what_p) const
+    {
+        if (index < 0) {
+            index += m_size;
+        }
+
+#if !defined(MYS_UNSAFE)
+        if (index < 0 || index >= m_size) {
+            print_traceback();
+            std::cerr
+                << "\nPanic(message=\"" << what_p << " "
+                << index
+                << " is out of range.\")\n";
+            abort();
+        }
+#endif
+
+        return index;
+    }
+
+    void raise_if_empty(const char *what_p) const
+    {
+#if !defined(MYS_UNSAFE)
+        if (m_size == 0) {
+            print_traceback();
+            std::cerr
+                << "\nPanic(message=\"" << what_p << " from an empty deque.\")\n";
+            abort();
+        }
+#endif
+    }
+
+public:
+    Deque() : m_head(0), m_size(0)
+    {
+    }
+
+    Deque(std::initializer_list<T> il) : Deque()
+    {
+        for (const auto& item : il) {
+            append(item);
+        }
+    }
+
+    Deque(const mys::shared_ptr<List<T>>& list) : Deque()
+    {
+        for (const auto& item : shared_ptr_not_none(list)->m_list) {
+            append(item);
+        }
+    }
+
+    void append(const T& item)
+    {
+        if (m_size == capacity()) {
+            grow();
+        }
+
+        slot(m_head + m_size) = item;
+        m_size++;
+    }
+
+    void append_left(const T& item)
+    {
+        if (m_size == capacity()) {
+            grow();
+        }
+
+        m_head = ((m_head - 1) & (capacity() - 1));
+        slot(m_head) = item;
+        m_size++;
+    }
+
+    void extend(const mys::shared_ptr<List<T>>& other)
+    {
+        for (const auto& item : shared_ptr_not_none(other)->m_list) {
+            append(item);
+        }
+    }
+
+    T pop()
+    {
+        raise_if_empty("Pop");
+        m_size--;
+        T& item = slot(m_head + m_size);
+        T value = std::move(item);
+        item = T();
+
+        return value;
+    }
+
+    T pop_left()
+    {
+        raise_if_empty("Pop");
+        T& item = slot(m_head);
+        T value = std::move(item);
+        item = T();
+        m_head = ((m_head + 1) & (capacity() - 1));
+        m_size--;
+
+        return value;
+    }
+
+    const T& front() const
+    {
+        raise_if_empty("Front");
+
+        return slot(m_head);
+    }
+
+    const T& back() const
+    {
+        raise_if_empty("Back");
+
+        return slot(m_head + m_size - 1);
+    }
+
+    void clear()
+    {
+        for (i64 i = 0; i < m_size; i++) {
+            slot(m_head + i) = T();
+        }
+
+        m_head = 0;
+        m_size = 0;
+    }
+
+    T& get(i64 index) const
+    {
+        return slot(m_head + checked_index(index, "Deque index"));
+    }
+
+    T& operator[](i64 index) const
+    {
+        return slot(m_head + index);
+    }
+
+    i64 __len__() const
+    {
+        return m_size;
+    }
+
+    bool __contains__(const T& value) const
+    {
+        for (i64 i = 0; i < m_size; i++) {
+            if (slot(m_head + i) == value) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool operator==(const Deque<T>& other) const
+    {
+        if (m_size != other.m_size) {
+            return false;
+        }
+
+        for (i64 i = 0; i < m_size; i++) {
+            if (!((*this)[i] == other[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    String __str__()
+    {
+        std::stringstream ss;
+        ss << *this;
+        return String(ss.str().c_str());
+    }
+};
+
+template <typename T>
+using SharedDeque = mys::shared_ptr<Deque<T>>;
+
+template<typename T> std::ostream&
+operator<<(std::ostream& os, const Deque<T>& obj)
+{
+    const char *delim_p;
+
+    os << "Deque([";
+    delim_p = "";
+
+    for (i64 i = 0; i < obj.__len__(); i++, delim_p = ", ") {
+        os << delim_p << obj[i];
+    }
+
+    os << "])";
+
+    return os;
+}
+
+template<typename T>
+bool operator==(const SharedDeque<T>& a, const SharedDeque<T>& b)
+{
+    if (!a && !b) {
+        return true;
+    } else {
+        return *shared_ptr_not_none(a) == *shared_ptr_not_none(b);
+    }
+}
+
+template<typename T>
+bool operator!=(const SharedDeque<T>& a, const SharedDeque<T>& b)
+{
+    return !(a == b);
+}
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common.hpp"
+#include "../flat_map.hpp"
 #include "../utils.hpp"
 #include "../errors/key.hpp"
 #include "string.hpp"
@@ -9,28 +10,89 @@
 
 namespace mys {
 
-// Dicts.
-template<typename TK, typename TV>
-class Dict final
+// A view of the keys, values or items of a dict. Iterating a view
+// visits the dict's entries by reference, in insertion order, without
+// creating a list.
+template<typename TMap, typename TProject>
+class DictView final
 {
+    TMap& m_map;
+
 public:
-    std::unordered_map<TK, TV> m_map;
+    class Iterator {
+        typename TMap::iterator m_it;
+
+    public:
+        Iterator(typename TMap::iterator it) : m_it(it)
+        {
+        }
+
+        decltype(auto) operator*() const
+        {
+            return TProject()(*m_it);
+        }
 
-    Dict() : m_map(std::unordered_map<TK, TV>())
+        Iterator& operator++()
+        {
+            ++m_it;
+
+            return *this;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return m_it != other.m_it;
+        }
+    };
+
+    DictView(TMap& map) : m_map(map)
     {
     }
 
-    Dict(std::initializer_list<std::pair<TK, TV>> il)
+    Iterator begin() const
     {
-        m_map.insert(il.begin(), il.end());
+        return Iterator(m_map.begin());
     }
 
-    void __setitem__(const TK& key, const TV& value)
+    Iterator end() const
     {
-        m_map[key] = value;
+        return Iterator(m_map.end());
     }
 
-    const TV& get(const TK& key, const TV& default_value)
+    i64 __len__() const
+    {
+        return m_map.size();
+    }
+};
+
+struct DictKey {
+    template<typename T> auto& operator()(T& item) const
+    {
+        return item.first;
+    }
+};
+
+struct DictValue {
+    template<typename T> auto& operator()(T& item) const
+    {
+        return item.second;
+    }
+};
+
+struct DictItem {
+    template<typename T> T& operator()(T& item) const
+    {
+        return item;
+    }
+};
+
+// Dicts.
+template<typename TK, typename TV>
+class Dict final
+{
+    // Lookups with both keys and string views.
+    template<typename TKey>
+    const TV& get_or(const TKey& key, const TV& default_value) const
     {
         auto it = m_map.find(key);
 
@@ -41,7 +103,8 @@ public:
         }
     }
 
-    const TV& get(const TK& key) const
+    template<typename TKey>
+    const TV& get_or_raise(const TKey& key) const
     {
         auto it = m_map.find(key);
 
@@ -52,47 +115,127 @@ public:
         }
     }
 
+    template<typename TKey>
+    TV pop_or(const TKey& key, const TV& def)
+    {
+        auto i = m_map.find(key);
+        TV value;
+        if (i == m_map.end()) {
+            value = def;
+        }
+        else {
+            value = i->second;
+            m_map.erase(i);
+        }
+        return value;
+    }
+
+public:
+    FlatMap<TK, TV> m_map;
+
+    Dict()
+    {
+    }
+
+    Dict(std::initializer_list<std::pair<TK, TV>> il)
+    {
+        m_map.insert(il.begin(), il.end());
+    }
+
+    // Given value is a copy as it may be one of the dictionary's own
+    // values, moved when the key is inserted.
+    void __setitem__(const TK& key, TV value)
+    {
+        m_map[key] = std::move(value);
+    }
+
+    const TV& get(const TK& key, const TV& default_value)
+    {
+        return get_or(key, default_value);
+    }
+
+    template<typename TChar>
+    const TV& get(const StringViewOf<TChar>& key, const TV& default_value)
+    {
+        return get_or(key, default_value);
+    }
+
+    const TV& get(const TK& key) const
+    {
+        return get_or_raise(key);
+    }
+
+    template<typename TChar>
+    const TV& get(const StringViewOf<TChar>& key) const
+    {
+        return get_or_raise(key);
+    }
+
     TV& get(const TK& key)
     {
-        auto it = m_map.find(key);
+        return const_cast<TV&>(get_or_raise(key));
+    }
 
-        if (it != m_map.end()) {
-            return it->second;
-        } else {
-            mys::make_shared<KeyError>("key does not exist")->__throw();
-        }
+    template<typename TChar>
+    TV& get(const StringViewOf<TChar>& key)
+    {
+        return const_cast<TV&>(get_or_raise(key));
+    }
+
+    DictView<FlatMap<TK, TV>, DictKey> keys_view()
+    {
+        return DictView<FlatMap<TK, TV>, DictKey>(m_map);
+    }
+
+    DictView<FlatMap<TK, TV>, DictValue> values_view()
+    {
+        return DictView<FlatMap<TK, TV>, DictValue>(m_map);
+    }
+
+    DictView<FlatMap<TK, TV>, DictItem> items_view()
+    {
+        return DictView<FlatMap<TK, TV>, DictItem>(m_map);
+    }
+
+    // Copies of the items, for loops that may change the dict.
+    typename FlatMap<TK, TV>::Walk walk_items()
+    {
+        return m_map.walk();
     }
 
     mys::shared_ptr<List<TK>> keys() const
     {
-        std::vector<TK> keys;
+        auto keys = mys::make_shared<List<TK>>();
+        keys->m_list.reserve(m_map.size());
+
         for (const auto& kv : m_map) {
-            keys.push_back(kv.first);
+            keys->m_list.push_back(kv.first);
         }
-        return mys::make_shared<List<TK>>(keys);
+
+        return keys;
     }
 
     mys::shared_ptr<List<TV>> values() const
     {
-        std::vector<TV> values;
+        auto values = mys::make_shared<List<TV>>();
+        values->m_list.reserve(m_map.size());
+
         for (const auto& kv : m_map) {
-            values.push_back(kv.second);
+            values->m_list.push_back(kv.second);
         }
-        return mys::make_shared<List<TV>>(values);
+
+        return values;
     }
 
     TV pop(const TK& key, const TV& def)
     {
-        const auto& i = m_map.find(key);
-        TV value;
-        if (i == m_map.end()) {
-            value = def;
-        }
-        else {
-            value = i->second;
-            m_map.erase(i);
-        }
-        return value;
+        return pop_or(key, def);
+    }
+
+    template<typename TChar>
+    TV pop(const StringViewOf<TChar>& key, const TV& def)
+    {
+        return pop_or(key, def);
     }
 
     void clear()
@@ -102,6 +245,8 @@ public:
 
     void update(const mys::shared_ptr<Dict<TK, TV>>& other)
     {
+        m_map.reserve(m_map.size() + other->m_map.size());
+
         for (const auto& i : other->m_map) {
             m_map[i.first] = i.second;
         }
@@ -117,6 +262,12 @@ public:
         return m_map.contains(key);
     }
 
+    template<typename TChar>
+    bool __contains__(const StringViewOf<TChar>& key) const
+    {
+        return m_map.contains(key);
+    }
+
     String __str__()
     {
         std::stringstream ss;
@@ -163,13 +314,14 @@ operator!=(const mys::shared_ptr<Dict<TK, TV>>& a,
 }
 
 template<typename TK, typename TV>
-mys::shared_ptr<List<mys::shared_ptr<Tuple<TK, TV>>>>
+mys::shared_ptr<List<Tuple<TK, TV>>>
 create_list_from_dict(const mys::shared_ptr<Dict<TK, TV>>& dict)
 {
-    auto list = mys::make_shared<List<mys::shared_ptr<Tuple<TK, TV>>>>();
+    auto list = mys::make_shared<List<Tuple<TK, TV>>>();
+    list->m_list.reserve(shared_ptr_not_none(dict)->m_map.size());
 
     for (auto const& [key, value] : shared_ptr_not_none(dict)->m_map) {
-        list->append(mys::make_shared<Tuple<TK, TV>>(key, value));
+        list->m_list.emplace_back(key, value);
     }
 
     return list;
@@ -2,6 +2,8 @@
 
 #include "../common.hpp"
 #include "../errors/value.hpp"
+#include "list.hpp"
+#include "tuple.hpp"
 
 /* slice(), enumerate() and range() used in for loops. */
 
@@ -291,4 +293,269 @@ public:
     }
 };
 
+
+/* Lazy iterators created by map(), filter(), take(), chain() and
+   zip(). Adapters are nested templates, so a pipeline compiles into a
+   single loop without temporary containers. next() stores the next
+   item and returns true, or returns false when there are no more
+   items. */
+
+template <typename T>
+class ListIter {
+
+public:
+    using Item = T;
+
+    mys::shared_ptr<List<T>> m_list;
+    size_t m_pos;
+
+    ListIter(const mys::shared_ptr<List<T>>& list)
+        : m_list(shared_ptr_not_none(list)), m_pos(0) {
+    }
+
+    bool next(T& item) {
+        if (m_pos >= m_list->m_list.size()) {
+            return false;
+        }
+
+        item = m_list->m_list[m_pos++];
+
+        return true;
+    }
+};
+
+class StringIter {
+
+public:
+    using Item = Char;
+
+    String m_string;
+    size_t m_pos;
+
+    StringIter(const String& string)
+        : m_string(string_not_none(string)), m_pos(0) {
+    }
+
+    bool next(Char& item) {
+        if (m_pos >= m_string.m_string->size()) {
+            return false;
+        }
+
+        item = (*m_string.m_string)[m_pos++];
+
+        return true;
+    }
+};
+
+template <typename T>
+class RangeIter {
+
+public:
+    using Item = T;
+
+    T m_next;
+    T m_end;
+    T m_step;
+
+    RangeIter(T begin, T end, T step) : m_next(begin), m_end(end), m_step(step) {
+        if (step == 0) {
+            mys::make_shared<ValueError>("range step can't be zero")->__throw();
+        }
+    }
+
+    bool next(T& item) {
+        if ((m_step > 0) ? (m_next >= m_end) : (m_next <= m_end)) {
+            return false;
+        }
+
+        item = m_next;
+        m_next += m_step;
+
+        return true;
+    }
+};
+
+template <typename I, typename F>
+class MapIter {
+
+public:
+    using Item = std::decay_t<std::invoke_result_t<F, const typename I::Item&>>;
+
+    I m_iter;
+    F m_func;
+    typename I::Item m_value;
+
+    MapIter(I iter, F func) : m_iter(iter), m_func(func) {
+    }
+
+    bool next(Item& item) {
+        if (!m_iter.next(m_value)) {
+            return false;
+        }
+
+        item = m_func(m_value);
+
+        return true;
+    }
+};
+
+template <typename I, typename F>
+class FilterIter {
+
+public:
+    using Item = typename I::Item;
+
+    I m_iter;
+    F m_func;
+
+    FilterIter(I iter, F func) : m_iter(iter), m_func(func) {
+    }
+
+    bool next(Item& item) {
+        while (m_iter.next(item)) {
+            if (m_func(item)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+template <typename I>
+class TakeIter {
+
+public:
+    using Item = typename I::Item;
+
+    I m_iter;
+    i64 m_count;
+
+    TakeIter(I iter, i64 count) : m_iter(iter), m_count(count) {
+    }
+
+    bool next(Item& item) {
+        if (m_count <= 0) {
+            return false;
+        }
+
+        m_count--;
+
+        return m_iter.next(item);
+    }
+};
+
+template <typename I1, typename I2>
+class ChainIter {
+
+public:
+    using Item = typename I1::Item;
+
+    I1 m_iter_1;
+    I2 m_iter_2;
+    bool m_first;
+
+    ChainIter(I1 iter_1, I2 iter_2)
+        : m_iter_1(iter_1), m_iter_2(iter_2), m_first(true) {
+    }
+
+    bool next(Item& item) {
+        if (m_first) {
+            if (m_iter_1.next(item)) {
+                return true;
+            }
+
+            m_first = false;
+        }
+
+        return m_iter_2.next(item);
+    }
+};
+
+// Stops when the shortest iterator is exhausted.
+template <typename... I>
+class ZipIter {
+
+    template <size_t... N>
+    bool next(Tuple<typename I::Item...>& item, std::index_sequence<N...>) {
+        return (std::get<N>(m_iters).next(std::get<N>(item->m_tuple)) && ...);
+    }
+
+public:
+    using Item = Tuple<typename I::Item...>;
+
+    std::tuple<I...> m_iters;
+
+    ZipIter(I... iters) : m_iters(iters...) {
+    }
+
+    bool next(Item& item) {
+        // A new tuple each time, as items may be kept by the loop body.
+        item = Item(typename I::Item()...);
+
+        return next(item, std::index_sequence_for<I...>());
+    }
+};
+
+template <typename I>
+typename I::Item iter_sum(I iter) {
+    typename I::Item sum = 0;
+    typename I::Item item;
+
+    while (iter.next(item)) {
+        sum += item;
+    }
+
+    return sum;
+}
+
+template <typename I>
+typename I::Item iter_min(I iter) {
+    typename I::Item min;
+    typename I::Item item;
+
+    if (!iter.next(min)) {
+        mys::make_shared<ValueError>("min() arg is an empty sequence")->__throw();
+    }
+
+    while (iter.next(item)) {
+        if (item < min) {
+            min = item;
+        }
+    }
+
+    return min;
+}
+
+template <typename I>
+typename I::Item iter_max(I iter) {
+    typename I::Item max;
+    typename I::Item item;
+
+    if (!iter.next(max)) {
+        mys::make_shared<ValueError>("max() arg is an empty sequence")->__throw();
+    }
+
+    while (iter.next(item)) {
+        if (item > max) {
+            max = item;
+        }
+    }
+
+    return max;
+}
+
+template <typename I>
+Bool iter_any(I iter) {
+    typename I::Item item;
+
+    while (iter.next(item)) {
+        if (item) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 }
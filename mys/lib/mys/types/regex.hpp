@@ -10,6 +10,7 @@
 namespace mys {
 
 class Regex;
+class RegexFindIter;
 
 class RegexMatch final
 {
@@ -83,17 +84,68 @@ public:
     SharedList<String> groups() const;
 };
 
+// Match data, match context and JIT stack reused by consecutive
+// matches. A match never yields to another fiber, but patterns may be
+// matched by several threads at the same time, by multi-core workers
+// and by the fiber thread pool, so each thread has one scratch for all
+// patterns.
+class RegexScratch final
+{
+public:
+    std::shared_ptr<pcre2_match_data> m_match_data;
+    pcre2_match_context *m_context_p;
+    pcre2_jit_stack *m_jit_stack_p;
+
+    RegexScratch(bool jit);
+    ~RegexScratch();
+};
+
 class Regex final
 {
 public:
     std::shared_ptr<pcre2_code> m_compiled;
+    bool m_jit;
+    String m_pattern;
+    String m_flags;
 
     static String get_error(int error);
-    Regex() : m_compiled(nullptr) {};
+    Regex() : m_compiled(nullptr), m_jit(false) {};
     Regex(const String& regex, const String& flags);
+    bool search(const String& string, PCRE2_SIZE offset, uint32_t options) const;
+    bool search_next(const String& string,
+                     PCRE2_SIZE& offset,
+                     uint32_t& options) const;
+    RegexScratch& scratch() const;
+    PCRE2_SIZE *scratch_ovector() const;
+    RegexMatch take_match(const String& string) const;
     RegexMatch match(const String& string) const;
     String replace(const String& subject, const String& replacement, int flags = 0) const;
     mys::shared_ptr<List<String>> split(const String& string) const;
+    mys::shared_ptr<List<String>> find_all(const String& string) const;
+    RegexFindIter find_iter(const String& string) const;
+};
+
+// Non-overlapping matches in a string, found one at a time.
+class RegexFindIter final
+{
+public:
+    Regex m_regex;
+    String m_string;
+    PCRE2_SIZE m_offset;
+    uint32_t m_options;
+    bool m_done;
+
+    RegexFindIter(const Regex& regex, const String& string)
+        : m_regex(regex),
+          m_string(string),
+          m_offset(0),
+          m_options(0),
+          m_done(false)
+    {
+    }
+
+    // Next match, or None if there are no more matches.
+    RegexMatch next();
 };
 
 inline bool operator==(const Regex& a, const Regex& b)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "regex.hpp"
+#include "list.hpp"
+
+namespace mys {
+
+// Aho-Corasick automaton finding which of many literals occur in a
+// string in one scan. Transitions for ASCII characters are resolved
+// into a dense table, other characters follow failure links.
+class LiteralMatcher final
+{
+private:
+    // Sorted by character.
+    std::vector<std::vector<std::pair<i32, int>>> m_edges;
+    std::vector<int> m_fail;
+    std::vector<std::vector<int>> m_outputs;
+    // Closest node with outputs in the failure chain, including the
+    // node itself, or -1.
+    std::vector<int> m_report;
+    std::vector<int> m_table;
+    // Nodes reported in current scan have the current generation.
+    std::vector<u32> m_visited;
+    u32 m_generation;
+
+    int child(int node, i32 ch) const;
+    int add_child(int node, i32 ch);
+    int step(int node, i32 ch) const;
+
+public:
+    LiteralMatcher();
+    void add(const std::vector<Char>& literal, int value);
+    void build();
+
+    // Marks values of all found literals in given vector. Stops early
+    // when the remaining count reaches zero.
+    void scan(const String& string, std::vector<bool>& found, size_t remaining);
+};
+
+// Many patterns matched with one scan of the subject. Patterns with a
+// required literal are only run if the literal was found by the scan.
+class RegexSet final
+{
+private:
+    LiteralMatcher m_matcher;
+    // Patterns that must always be run.
+    std::vector<int> m_unfiltered;
+    size_t m_number_of_filtered;
+    std::vector<bool> m_candidates;
+
+    void find_candidates(const String& string);
+
+public:
+    std::vector<Regex> m_regexes;
+
+    RegexSet(const SharedList<Regex>& regexes);
+
+    // Indices of all matching patterns, in ascending order.
+    SharedList<i64> matches(const String& string);
+
+    bool is_match(const String& string);
+
+    int __len__() const
+    {
+        return m_regexes.size();
+    }
+
+    String __str__();
+};
+
+using SharedRegexSet = mys::shared_ptr<RegexSet>;
+
+std::ostream& operator<<(std::ostream& os, const RegexSet& obj);
+
+}
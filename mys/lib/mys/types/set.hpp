@@ -1,8 +1,11 @@
 #pragma once
 
 #include "../common.hpp"
+#include <limits>
+#include "../flat_map.hpp"
 #include "../errors/value.hpp"
 #include "../errors/key.hpp"
+#include "string.hpp"
 
 namespace mys {
 
@@ -11,17 +14,345 @@ template<typename T> class Set;
 template <typename T>
 using SharedSet = mys::shared_ptr<Set<T>>;
 
+// A set of small integers or characters with one bit per possible
+// value. Set operations work on 64 values at a time.
+template<typename T>
+class BitSet final
+{
+    std::vector<u64> m_words;
+    i64 m_size;
+
+    static constexpr i64 offset()
+    {
+        if constexpr (std::is_integral_v<T>) {
+            return std::numeric_limits<T>::min();
+        } else {
+            // Char() is -1.
+            return -1;
+        }
+    }
+
+    static i64 bit(const T& value)
+    {
+        return (i64)value - offset();
+    }
+
+    static T value_of(i64 bit)
+    {
+        return T(bit + offset());
+    }
+
+    u64 word(i64 index) const
+    {
+        if (index < (i64)m_words.size()) {
+            return m_words[index];
+        } else {
+            return 0;
+        }
+    }
+
+    void count()
+    {
+        m_size = 0;
+
+        for (auto word : m_words) {
+            m_size += __builtin_popcountll(word);
+        }
+    }
+
+public:
+    class Iterator {
+        const BitSet *m_set_p;
+        i64 m_bit;
+
+        void skip_zeros()
+        {
+            i64 nwords = m_set_p->m_words.size();
+
+            while ((m_bit >> 6) < nwords) {
+                u64 word = (m_set_p->m_words[m_bit >> 6] >> (m_bit & 63));
+
+                if (word != 0) {
+                    m_bit += __builtin_ctzll(word);
+
+                    return;
+                }
+
+                m_bit = ((m_bit >> 6) + 1) << 6;
+            }
+
+            m_bit = nwords << 6;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = i64;
+        using pointer = const T *;
+        using reference = T;
+
+        Iterator(const BitSet *set_p, i64 bit) : m_set_p(set_p), m_bit(bit)
+        {
+            skip_zeros();
+        }
+
+        T operator*() const
+        {
+            return value_of(m_bit);
+        }
+
+        Iterator& operator++()
+        {
+            m_bit++;
+            skip_zeros();
+
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator it = *this;
+            ++(*this);
+
+            return it;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return m_bit == other.m_bit;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return m_bit != other.m_bit;
+        }
+    };
+
+    BitSet() : m_size(0)
+    {
+    }
+
+    bool insert(const T& value)
+    {
+        i64 index = bit(value);
+        i64 word = (index >> 6);
+        u64 mask = (1ull << (index & 63));
+
+        if (word >= (i64)m_words.size()) {
+            m_words.resize(word + 1);
+        }
+
+        if (m_words[word] & mask) {
+            return false;
+        }
+
+        m_words[word] |= mask;
+        m_size++;
+
+        return true;
+    }
+
+    bool erase(const T& value)
+    {
+        i64 index = bit(value);
+        u64 mask = (1ull << (index & 63));
+
+        if (!(word(index >> 6) & mask)) {
+            return false;
+        }
+
+        m_words[index >> 6] &= ~mask;
+        m_size--;
+
+        return true;
+    }
+
+    bool contains(const T& value) const
+    {
+        i64 index = bit(value);
+
+        if (index < 0) {
+            return false;
+        }
+
+        return (word(index >> 6) >> (index & 63)) & 1;
+    }
+
+    void clear()
+    {
+        m_words.clear();
+        m_size = 0;
+    }
+
+    void reserve(i64)
+    {
+    }
+
+    i64 size() const
+    {
+        return m_size;
+    }
+
+    Iterator begin() const
+    {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const
+    {
+        return Iterator(this, m_words.size() << 6);
+    }
+
+    BitSet intersection(const BitSet& other) const
+    {
+        BitSet res;
+        res.m_words.resize(std::min(m_words.size(), other.m_words.size()));
+
+        for (size_t i = 0; i < res.m_words.size(); i++) {
+            res.m_words[i] = (m_words[i] & other.m_words[i]);
+        }
+
+        res.count();
+
+        return res;
+    }
+
+    BitSet _union(const BitSet& other) const
+    {
+        BitSet res;
+        res.m_words.resize(std::max(m_words.size(), other.m_words.size()));
+
+        for (size_t i = 0; i < res.m_words.size(); i++) {
+            res.m_words[i] = (word(i) | other.word(i));
+        }
+
+        res.count();
+
+        return res;
+    }
+
+    BitSet difference(const BitSet& other) const
+    {
+        BitSet res;
+        res.m_words.resize(m_words.size());
+
+        for (size_t i = 0; i < res.m_words.size(); i++) {
+            res.m_words[i] = (m_words[i] & ~other.word(i));
+        }
+
+        res.count();
+
+        return res;
+    }
+
+    BitSet symmetric_difference(const BitSet& other) const
+    {
+        BitSet res;
+        res.m_words.resize(std::max(m_words.size(), other.m_words.size()));
+
+        for (size_t i = 0; i < res.m_words.size(); i++) {
+            res.m_words[i] = (word(i) ^ other.word(i));
+        }
+
+        res.count();
+
+        return res;
+    }
+
+    bool is_disjoint(const BitSet& other) const
+    {
+        i64 nwords = std::min(m_words.size(), other.m_words.size());
+
+        for (i64 i = 0; i < nwords; i++) {
+            if (m_words[i] & other.m_words[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool is_subset(const BitSet& other) const
+    {
+        for (size_t i = 0; i < m_words.size(); i++) {
+            if (m_words[i] & ~other.word(i)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator==(const BitSet& other) const
+    {
+        if (m_size != other.m_size) {
+            return false;
+        }
+
+        return is_subset(other);
+    }
+};
+
+// Element types stored in a BitSet instead of a hash set. Their
+// domain is at most 65536 values (or the characters actually used),
+// so a bitset is both smaller and faster.
+template<typename T> struct is_small_domain : std::false_type {};
+template<> struct is_small_domain<i8> : std::true_type {};
+template<> struct is_small_domain<u8> : std::true_type {};
+template<> struct is_small_domain<i16> : std::true_type {};
+template<> struct is_small_domain<u16> : std::true_type {};
+template<> struct is_small_domain<Char> : std::true_type {};
+
+template<typename T>
+using SetTable = std::conditional_t<is_small_domain<T>::value,
+                                    BitSet<T>,
+                                    FlatSet<T>>;
+
 template<typename T>
 class Set final
 {
+    const Set& smallest(const Set& other) const
+    {
+        return (m_set.size() <= other.m_set.size()) ? *this : other;
+    }
+
+    const Set& largest(const Set& other) const
+    {
+        return (m_set.size() > other.m_set.size()) ? *this : other;
+    }
+
 public:
-    std::unordered_set<T> m_set;
+    SetTable<T> m_set;
 
     Set() {}
     Set(const Set<T>& other) : m_set(other.m_set) {}
-    Set(const SharedList<T>& other) : m_set(other->m_list.begin(), other->m_list.end()) {}
-    Set(std::initializer_list<T> il) : m_set(il) {}
-    Set(const std::vector<T>& v) : m_set(v.begin(), v.end()) {}
+
+    Set(const SharedList<T>& other)
+    {
+        m_set.reserve(other->m_list.size());
+
+        for (const auto& elem : other->m_list) {
+            m_set.insert(elem);
+        }
+    }
+
+    Set(std::initializer_list<T> il)
+    {
+        m_set.reserve(il.size());
+
+        for (const auto& elem : il) {
+            m_set.insert(elem);
+        }
+    }
+
+    Set(const std::vector<T>& v)
+    {
+        m_set.reserve(v.size());
+
+        for (const auto& elem : v) {
+            m_set.insert(elem);
+        }
+    }
 
     bool operator==(const Set<T>& other) const
     {
@@ -30,7 +361,7 @@ public:
 
     bool operator!=(const Set<T>& other) const
     {
-        return m_set != other.m_set;
+        return !(m_set == other.m_set);
     }
 
     void add(const T& elem)
@@ -45,32 +376,37 @@ public:
 
     void discard(const T& elem)
     {
-        auto it = m_set.find(elem);
-
-        if (it != m_set.end()) {
-            m_set.erase(it);
-        }
+        m_set.erase(elem);
     }
 
     void remove(const T& elem)
     {
-        auto it = m_set.find(elem);
-
-        if (it != m_set.end()) {
-            m_set.erase(it);
-        } else {
+        if (!m_set.erase(elem)) {
             mys::make_shared<KeyError>("element does not exist")->__throw();
         }
     }
 
+    // Set algebra on bitsets is done word by word. Otherwise the
+    // smaller set is iterated and the larger one probed.
+
     SharedSet<T> intersection(const SharedSet<T>& other) const
     {
         auto res = mys::make_shared<Set<T>>();
-        for (const auto& e : m_set) {
-            if (other->m_set.contains(e)) {
-                res->m_set.insert(e);
+
+        if constexpr (is_small_domain<T>::value) {
+            res->m_set = m_set.intersection(other->m_set);
+        } else {
+            const Set& small = smallest(*other);
+            const Set& large = largest(*other);
+            res->m_set.reserve(small.m_set.size());
+
+            for (const auto& e : small.m_set) {
+                if (large.m_set.contains(e)) {
+                    res->m_set.insert(e);
+                }
             }
         }
+
         return res;
     }
 
@@ -83,13 +419,33 @@ public:
 
     SharedSet<T> difference(const SharedSet<T>& other) const
     {
-        auto res = mys::make_shared<Set<T>>();
-        for (const auto& e : m_set) {
-            if (!other->m_set.contains(e)) {
-                res->m_set.insert(e);
+        if constexpr (is_small_domain<T>::value) {
+            auto res = mys::make_shared<Set<T>>();
+            res->m_set = m_set.difference(other->m_set);
+
+            return res;
+        } else {
+            if (other->m_set.size() < m_set.size()) {
+                auto res = mys::make_shared<Set<T>>(*this);
+
+                for (const auto& e : other->m_set) {
+                    res->m_set.erase(e);
+                }
+
+                return res;
+            } else {
+                auto res = mys::make_shared<Set<T>>();
+                res->m_set.reserve(m_set.size());
+
+                for (const auto& e : m_set) {
+                    if (!other->m_set.contains(e)) {
+                        res->m_set.insert(e);
+                    }
+                }
+
+                return res;
             }
         }
-        return res;
     }
 
     SharedSet<T> difference_update(const SharedSet<T>& other)
@@ -101,9 +457,22 @@ public:
 
     SharedSet<T> _union(const SharedSet<T>& other) const
     {
-        auto res = mys::make_shared<Set<T>>(*this);
-        res->m_set.insert(other->m_set.begin(), other->m_set.end());
-        return res;
+        if constexpr (is_small_domain<T>::value) {
+            auto res = mys::make_shared<Set<T>>();
+            res->m_set = m_set._union(other->m_set);
+
+            return res;
+        } else {
+            const Set& small = smallest(*other);
+            auto res = mys::make_shared<Set<T>>(largest(*other));
+            res->m_set.reserve(m_set.size() + other->m_set.size());
+
+            for (const auto& e : small.m_set) {
+                res->m_set.insert(e);
+            }
+
+            return res;
+        }
     }
 
     SharedSet<T> update(const SharedSet<T>& other)
@@ -115,18 +484,24 @@ public:
 
     SharedSet<T> symmetric_difference(const SharedSet<T>& other) const
     {
-        auto res = mys::make_shared<Set<T>>();
-        for (const auto& e : m_set) {
-            if (!other->m_set.contains(e)) {
-                res->m_set.insert(e);
-            }
-        }
-        for (const auto& e : other->m_set) {
-            if (!m_set.contains(e)) {
-                res->m_set.insert(e);
+        if constexpr (is_small_domain<T>::value) {
+            auto res = mys::make_shared<Set<T>>();
+            res->m_set = m_set.symmetric_difference(other->m_set);
+
+            return res;
+        } else {
+            const Set& small = smallest(*other);
+            auto res = mys::make_shared<Set<T>>(largest(*other));
+            res->m_set.reserve(m_set.size() + other->m_set.size());
+
+            for (const auto& e : small.m_set) {
+                if (!res->m_set.erase(e)) {
+                    res->m_set.insert(e);
+                }
             }
+
+            return res;
         }
-        return res;
     }
 
     SharedSet<T> symmetric_difference_update(const SharedSet<T>& other)
@@ -138,25 +513,25 @@ public:
 
     bool is_disjoint(const SharedSet<T>& other) const
     {
-        for (const auto& e : m_set) {
-            if (other->m_set.contains(e)) {
-                return false;
+        if constexpr (is_small_domain<T>::value) {
+            return m_set.is_disjoint(other->m_set);
+        } else {
+            const Set& small = smallest(*other);
+            const Set& large = largest(*other);
+
+            for (const auto& e : small.m_set) {
+                if (large.m_set.contains(e)) {
+                    return false;
+                }
             }
+
+            return true;
         }
-        return true;
     }
 
     bool is_superset(const SharedSet<T>& other) const
     {
-        if (m_set.size() < other->m_set.size()) {
-            return false;
-        }
-        for (const auto& e : other->m_set) {
-            if (!m_set.contains(e)) {
-                return false;
-            }
-        }
-        return true;
+        return other->is_subset(*this);
     }
 
     bool is_proper_superset(const SharedSet<T>& other) const
@@ -167,17 +542,26 @@ public:
         return is_superset(other);
     }
 
-    bool is_subset(const SharedSet<T>& other) const
+    bool is_subset(const Set<T>& other) const
     {
-        if (m_set.size() > other->m_set.size()) {
+        if (m_set.size() > other.m_set.size()) {
             return false;
         }
-        for (const auto& e : m_set) {
-            if (!other->m_set.contains(e)) {
-                return false;
+        if constexpr (is_small_domain<T>::value) {
+            return m_set.is_subset(other.m_set);
+        } else {
+            for (const auto& e : m_set) {
+                if (!other.m_set.contains(e)) {
+                    return false;
+                }
             }
+            return true;
         }
-        return true;
+    }
+
+    bool is_subset(const SharedSet<T>& other) const
+    {
+        return is_subset(*other);
     }
 
     bool is_proper_subset(const SharedSet<T>& other) const
@@ -198,6 +582,12 @@ public:
         return m_set.contains(value);
     }
 
+    template<typename TChar>
+    bool __contains__(const StringViewOf<TChar>& value) const
+    {
+        return m_set.contains(value);
+    }
+
     String __str__()
     {
         std::stringstream ss;
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "../common.hpp"
+#include "../btree.hpp"
+#include "../utils.hpp"
+#include "../errors/key.hpp"
+#include "string.hpp"
+#include "list.hpp"
+#include "dict.hpp"
+
+namespace mys {
+
+// Dicts ordered by key.
+template<typename TK, typename TV>
+class SortedDict final
+{
+    const std::pair<TK, TV>& item_or_raise(
+        const typename BTreeMap<TK, TV>::iterator& it) const
+    {
+        if (it == m_map.end()) {
+            mys::make_shared<KeyError>("key does not exist")->__throw();
+        }
+
+        return *it;
+    }
+
+public:
+    BTreeMap<TK, TV> m_map;
+
+    SortedDict()
+    {
+    }
+
+    SortedDict(const SharedDict<TK, TV>& dict)
+    {
+        for (const auto& [key, value] : shared_ptr_not_none(dict)->m_map) {
+            m_map[key] = value;
+        }
+    }
+
+    // Given value is a copy as it may be one of the dictionary's own
+    // values, moved when a leaf is split.
+    void __setitem__(const TK& key, TV value)
+    {
+        m_map[key] = std::move(value);
+    }
+
+    TV& get(const TK& key)
+    {
+        return const_cast<TV&>(item_or_raise(m_map.find(key)).second);
+    }
+
+    const TV& get(const TK& key, const TV& default_value) const
+    {
+        auto it = m_map.find(key);
+
+        if (it != m_map.end()) {
+            return it->second;
+        } else {
+            return default_value;
+        }
+    }
+
+    TV pop(const TK& key, const TV& default_value)
+    {
+        auto it = m_map.find(key);
+
+        if (it == m_map.end()) {
+            return default_value;
+        }
+
+        TV value = it->second;
+        m_map.erase(key);
+
+        return value;
+    }
+
+    void clear()
+    {
+        m_map.clear();
+    }
+
+    mys::shared_ptr<List<TK>> keys() const
+    {
+        auto keys = mys::make_shared<List<TK>>();
+        keys->m_list.reserve(m_map.size());
+
+        for (const auto& kv : m_map) {
+            keys->m_list.push_back(kv.first);
+        }
+
+        return keys;
+    }
+
+    mys::shared_ptr<List<TV>> values() const
+    {
+        auto values = mys::make_shared<List<TV>>();
+        values->m_list.reserve(m_map.size());
+
+        for (const auto& kv : m_map) {
+            values->m_list.push_back(kv.second);
+        }
+
+        return values;
+    }
+
+    // Largest key not greater than given key.
+    TK floor(const TK& key) const
+    {
+        return item_or_raise(m_map.floor(key)).first;
+    }
+
+    // Smallest key not less than given key.
+    TK ceiling(const TK& key) const
+    {
+        return item_or_raise(m_map.ceiling(key)).first;
+    }
+
+    // Number of keys less than given key.
+    i64 rank(const TK& key) const
+    {
+        return m_map.rank(key);
+    }
+
+    // Key with given rank. Negative ranks count from the end.
+    TK key_at(i64 index) const
+    {
+        if (index < 0) {
+            index += m_map.size();
+        }
+
+#if !defined(MYS_UNSAFE)
+        if (index < 0 || index >= m_map.size()) {
+            print_traceback();
+            std::cerr
+                << "\nPanic(message=\"Rank " << index << " is out of range.\")\n";
+            abort();
+        }
+#endif
+
+        return m_map.nth(index)->first;
+    }
+
+    typename BTreeMap<TK, TV>::Range items_view() const
+    {
+        return typename BTreeMap<TK, TV>::Range(m_map.begin(), m_map.end());
+    }
+
+    // Items with keys in [lower, upper).
+    typename BTreeMap<TK, TV>::Range range(const TK& lower, const TK& upper) const
+    {
+        return m_map.range(lower, upper);
+    }
+
+    int __len__() const
+    {
+        return m_map.size();
+    }
+
+    bool __contains__(const TK& key) const
+    {
+        return m_map.contains(key);
+    }
+
+    String __str__()
+    {
+        std::stringstream ss;
+        ss << *this;
+        return String(ss.str().c_str());
+    }
+};
+
+template <typename TK, typename TV>
+using SharedSortedDict = mys::shared_ptr<SortedDict<TK, TV>>;
+
+template<class TK, class TV> std::ostream&
+operator<<(std::ostream& os, const SortedDict<TK, TV>& dict)
+{
+    const char *delim_p;
+
+    os << "SortedDict({";
+    delim_p = "";
+
+    for (auto item = dict.m_map.begin();
+         item != dict.m_map.end();
+         item++, delim_p = ", ") {
+        os << delim_p << item->first << ": " << item->second;
+    }
+
+    os << "})";
+
+    return os;
+}
+
+template<typename TK, typename TV> bool
+operator==(const SharedSortedDict<TK, TV>& a, const SharedSortedDict<TK, TV>& b)
+{
+    if (!a && !b) {
+        return true;
+    } else {
+        return shared_ptr_not_none(a)->m_map == shared_ptr_not_none(b)->m_map;
+    }
+}
+
+template<typename TK, typename TV> bool
+operator!=(const SharedSortedDict<TK, TV>& a, const SharedSortedDict<TK, TV>& b)
+{
+    return !(a == b);
+}
+
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "../common.hpp"
+#include "../btree.hpp"
+#include "../utils.hpp"
+#include "../errors/key.hpp"
+#include "string.hpp"
+#include "list.hpp"
+
+namespace mys {
+
+// Sets ordered by value.
+template<typename T>
+class SortedSet final
+{
+    const T& item_or_raise(const typename BTreeSet<T>::iterator& it) const
+    {
+        if (it == m_set.end()) {
+            mys::make_shared<KeyError>("element does not exist")->__throw();
+        }
+
+        return *it;
+    }
+
+public:
+    BTreeSet<T> m_set;
+
+    SortedSet()
+    {
+    }
+
+    SortedSet(std::initializer_list<T> il)
+    {
+        for (const auto& elem : il) {
+            m_set.insert(elem);
+        }
+    }
+
+    SortedSet(const SharedList<T>& list)
+    {
+        for (const auto& elem : shared_ptr_not_none(list)->m_list) {
+            m_set.insert(elem);
+        }
+    }
+
+    void add(const T& elem)
+    {
+        m_set.insert(elem);
+    }
+
+    void discard(const T& elem)
+    {
+        m_set.erase(elem);
+    }
+
+    void remove(const T& elem)
+    {
+        if (!m_set.erase(elem)) {
+            mys::make_shared<KeyError>("element does not exist")->__throw();
+        }
+    }
+
+    void clear()
+    {
+        m_set.clear();
+    }
+
+    // Largest element not greater than given value.
+    T floor(const T& value) const
+    {
+        return item_or_raise(m_set.floor(value));
+    }
+
+    // Smallest element not less than given value.
+    T ceiling(const T& value) const
+    {
+        return item_or_raise(m_set.ceiling(value));
+    }
+
+    // Number of elements less than given value.
+    i64 rank(const T& value) const
+    {
+        return m_set.rank(value);
+    }
+
+    // Element with given rank. Negative ranks count from the end.
+    T at(i64 index) const
+    {
+        if (index < 0) {
+            index += m_set.size();
+        }
+
+#if !defined(MYS_UNSAFE)
+        if (index < 0 || index >= m_set.size()) {
+            print_traceback();
+            std::cerr
+                << "\nPanic(message=\"Rank " << index << " is out of range.\")\n";
+            abort();
+        }
+#endif
+
+        return *m_set.nth(index);
+    }
+
+    typename BTreeSet<T>::Range items_view() const
+    {
+        return typename BTreeSet<T>::Range(m_set.begin(), m_set.end());
+    }
+
+    // Elements in [lower, upper).
+    typename BTreeSet<T>::Range range(const T& lower, const T& upper) const
+    {
+        return m_set.range(lower, upper);
+    }
+
+    int __len__() const
+    {
+        return m_set.size();
+    }
+
+    bool __contains__(const T& value) const
+    {
+        return m_set.contains(value);
+    }
+
+    String __str__()
+    {
+        std::stringstream ss;
+        ss << *this;
+        return String(ss.str().c_str());
+    }
+};
+
+template <typename T>
+using SharedSortedSet = mys::shared_ptr<SortedSet<T>>;
+
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const SortedSet<T>& obj)
+{
+    const char *delim_p;
+
+    os << "SortedSet({";
+    delim_p = "";
+
+    for (auto item = obj.m_set.begin(); item != obj.m_set.end(); item++, delim_p = ", ") {
+        os << delim_p << *item;
+    }
+
+    os << "})";
+
+    return os;
+}
+
+template<typename T>
+bool operator==(const SharedSortedSet<T>& a, const SharedSortedSet<T>& b)
+{
+    if (!a && !b) {
+        return true;
+    } else {
+        return shared_ptr_not_none(a)->m_set == shared_ptr_not_none(b)->m_set;
+    }
+}
+
+template<typename T>
+bool operator!=(const SharedSortedSet<T>& a, const SharedSortedSet<T>& b)
+{
+    return !(a == b);
+}
+
+}
@@ -10,11 +10,53 @@ namespace mys {
 
 template <typename T> class List;
 template <class... T> class Tuple;
-template <class ...T> using SharedTuple = mys::shared_ptr<Tuple<T...>>;
+template <class ...T> using SharedTuple = Tuple<T...>;
 
 class Regex;
 class RegexMatch;
 
+// A view of a sequence of characters owned by someone else. Dicts and
+// sets with string keys can be searched with a view, without creating
+// a string.
+template<typename TChar>
+class StringViewOf final {
+public:
+    const TChar *m_data_p;
+    i64 m_size;
+
+    StringViewOf(const TChar *data_p, i64 size) : m_data_p(data_p), m_size(size)
+    {
+    }
+
+    // A string literal.
+    template<size_t N>
+    StringViewOf(const char (&data)[N]) : m_data_p(data), m_size(N - 1)
+    {
+    }
+};
+
+// A substring.
+using StringView = StringViewOf<Char>;
+
+// An ASCII string literal.
+using StringLiteral = StringViewOf<char>;
+
+template<typename TChar>
+std::size_t hash_characters(const TChar *data_p, i64 size)
+{
+    std::size_t hash = 0;
+    int p = 53;
+    int m = 1e9 + 9;
+    long long power_of_p = 1;
+
+    for (i64 i = 0; i < size; i++) {
+        hash = (hash + ((i32)data_p[i] - 'a' + 1) * power_of_p) % m;
+        power_of_p = (power_of_p * p) % m;
+    }
+
+    return hash;
+}
+
 // A string.
 class String final {
 private:
@@ -175,6 +217,10 @@ public:
     String get(std::optional<i64> start, std::optional<i64> end,
                i64 step) const;
 
+    // A view of the substring start to end, without copying it. Only
+    // valid as long as the string is not modified.
+    StringView view(std::optional<i64> start, std::optional<i64> end) const;
+
     Bool starts_with(const String& value) const;
     Bool ends_with(const String& value) const;
     mys::shared_ptr<List<String>> split() const;
@@ -249,29 +295,71 @@ static inline String& string_not_none(String& obj)
     return obj;
 }
 #endif
+
+inline StringView String::view(std::optional<i64> start,
+                                std::optional<i64> end) const
+{
+    i64 size = string_not_none(*this).m_string->size();
+    i64 begin = start.value_or(0);
+    i64 stop = end.value_or(size);
+
+    if (begin < 0) {
+        begin = std::max(begin + size, (i64)0);
+    } else if (begin > size) {
+        begin = size;
+    }
+
+    if (stop < 0) {
+        stop = std::max(stop + size, (i64)0);
+    } else if (stop > size) {
+        stop = size;
+    }
+
+    return StringView(m_string->data() + begin, std::max(stop - begin, (i64)0));
+}
+
+}
+
+namespace mys {
+
+template<typename TChar>
+bool operator==(const String& string, const StringViewOf<TChar>& view)
+{
+    if (!string.m_string || (i64)string.m_string->size() != view.m_size) {
+        return false;
+    }
+
+    for (i64 i = 0; i < view.m_size; i++) {
+        if ((*string.m_string)[i].m_value != (i32)view.m_data_p[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 }
 
 namespace std
 {
+    // Transparent, so strings can be looked up with views.
     template<> struct hash<mys::String>
     {
+        using is_transparent = void;
+
         std::size_t operator()(mys::String const& s) const noexcept
         {
             if (s.m_string) {
-                std::size_t hash = 0;
-                int p = 53;
-                int m = 1e9 + 9;
-                long long power_of_p = 1;
-
-                for (auto v : *s.m_string) {
-                    hash = (hash + (v - 'a' + 1) * power_of_p) % m;
-                    power_of_p = (power_of_p * p) % m;
-                }
-
-                return hash;
+                return mys::hash_characters(s.m_string->data(), s.m_string->size());
             } else {
                 return 0;
             }
         }
+
+        template<typename TChar>
+        std::size_t operator()(mys::StringViewOf<TChar> const& s) const noexcept
+        {
+            return mys::hash_characters(s.m_data_p, s.m_size);
+        }
     };
 }
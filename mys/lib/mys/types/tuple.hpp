@@ -2,6 +2,12 @@
 
 #include "../common.hpp"
 #include "../utils.hpp"
+#include "../hash.hpp"
+
+// Language features used by the application, written by the transpiler.
+#if __has_include("mys_features.hpp")
+#include "mys_features.hpp"
+#endif
 
 namespace mys {
 
@@ -24,16 +30,22 @@ operator<<(std::ostream& os, const std::tuple<T...>& tup)
     return format_tuple(os, tup, std::make_index_sequence<sizeof...(T)>());
 }
 
+// The items of a tuple.
 template<class... T>
-class Tuple {
+class TupleItems {
 public:
     std::tuple<T...> m_tuple;
 
-    Tuple(const T&... args) : m_tuple(std::tuple<T...>(args...))
+    TupleItems()
+    {
+    }
+
+    template<size_t N = sizeof...(T), std::enable_if_t<(N > 0), int> = 0>
+    TupleItems(const T&... args) : m_tuple(args...)
     {
     }
 
-    String __str__()
+    String __str__() const
     {
         std::stringstream ss;
         ss << m_tuple;
@@ -41,30 +53,204 @@ public:
     }
 };
 
+#if !defined(MYS_SHARED_TUPLES)
+
+// Tuples are stored by value. None is a flag next to the items
+// instead of a null pointer, so creating a tuple never allocates.
+template<class... T>
+class Tuple {
+    TupleItems<T...> m_items;
+    bool m_is_none;
+
+public:
+    // The empty tuple is never None when default constructed.
+    Tuple() : m_is_none(sizeof...(T) > 0)
+    {
+    }
+
+    Tuple(std::nullptr_t) : m_is_none(true)
+    {
+    }
+
+    template<size_t N = sizeof...(T), std::enable_if_t<(N > 0), int> = 0>
+    Tuple(const T&... args) : m_items(args...), m_is_none(false)
+    {
+    }
+
+    void check_not_none() const
+    {
+        if (m_is_none) {
+#if !defined(MYS_UNSAFE)
+            abort_is_none();
+#else
+            // There is no pointer to fault on, so crash explicitly.
+            abort();
+#endif
+        }
+    }
+
+    bool is_none() const
+    {
+        return m_is_none;
+    }
+
+    TupleItems<T...> *operator->()
+    {
+        check_not_none();
+
+        return &m_items;
+    }
+
+    const TupleItems<T...> *operator->() const
+    {
+        check_not_none();
+
+        return &m_items;
+    }
+
+    explicit operator bool() const
+    {
+        return !m_is_none;
+    }
+
+    // Only used to compare to None, as the transpiler shares tuples
+    // compared to other tuples.
+    friend bool is(const Tuple& a, const Tuple& b)
+    {
+        return a.m_is_none && b.m_is_none;
+    }
+};
+
+#else
+
+// Tuples are shared, as other objects are, in applications that assign
+// to tuple items or compare tuples with "is". The transpiler defines
+// MYS_SHARED_TUPLES for them, as the item assignment must be seen
+// through all references to the tuple.
+template<class... T>
+class Tuple {
+    mys::shared_ptr<TupleItems<T...>> m_items_p;
+
+public:
+    // The empty tuple is never None when default constructed.
+    Tuple()
+    {
+        if constexpr (sizeof...(T) == 0) {
+            m_items_p = mys::make_shared<TupleItems<T...>>();
+        }
+    }
+
+    Tuple(std::nullptr_t)
+    {
+    }
+
+    template<size_t N = sizeof...(T), std::enable_if_t<(N > 0), int> = 0>
+    Tuple(const T&... args)
+        : m_items_p(mys::make_shared<TupleItems<T...>>(args...))
+    {
+    }
+
+    bool is_none() const
+    {
+        return !m_items_p;
+    }
+
+    TupleItems<T...> *operator->() const
+    {
+        return m_items_p.operator->();
+    }
+
+    explicit operator bool() const
+    {
+        return bool(m_items_p);
+    }
+
+    friend bool is(const Tuple& a, const Tuple& b)
+    {
+        return a.m_items_p.get() == b.m_items_p.get();
+    }
+};
+
+#endif
+
 template<class... T>
 std::ostream&
 operator<<(std::ostream& os, const Tuple<T...>& obj)
 {
-    os << obj.m_tuple;
+    if (obj.is_none()) {
+        os << "None";
+    } else {
+        os << obj->m_tuple;
+    }
 
     return os;
 }
 
 template<class... T> bool
-operator==(const mys::shared_ptr<Tuple<T...>>& a,
-           const mys::shared_ptr<Tuple<T...>>& b)
+operator==(const Tuple<T...>& a, const Tuple<T...>& b)
 {
-    return shared_ptr_not_none(a)->m_tuple == shared_ptr_not_none(b)->m_tuple;
+    return a->m_tuple == b->m_tuple;
 }
 
 template<class... T> bool
-operator!=(const mys::shared_ptr<Tuple<T...>>& a,
-           const mys::shared_ptr<Tuple<T...>>& b)
+operator!=(const Tuple<T...>& a, const Tuple<T...>& b)
 {
     return !(a == b);
 }
 
+template<class... T> bool
+is(const Tuple<T...>& a, void *b)
+{
+    return a.is_none();
+}
+
+template<class... T> bool
+is(void *a, const Tuple<T...>& b)
+{
+    return b.is_none();
+}
+
+template<class... T, size_t... I> bool
+keys_equal_items(const Tuple<T...>& a,
+                 const Tuple<T...>& b,
+                 std::index_sequence<I...>)
+{
+    return (... && keys_equal(std::get<I>(a->m_tuple), std::get<I>(b->m_tuple)));
+}
+
+template<class... T> bool
+keys_equal(const Tuple<T...>& a, const Tuple<T...>& b)
+{
+    if (a.is_none() || b.is_none()) {
+        return a.is_none() && b.is_none();
+    }
+
+    return keys_equal_items(a, b, std::make_index_sequence<sizeof...(T)>());
+}
+
 template <class ...T>
-using SharedTuple = mys::shared_ptr<Tuple<T...>>;
+using SharedTuple = Tuple<T...>;
+
+}
+
+namespace std
+{
+    // Tuples of hashable items are hashable.
+    template<class... T> struct hash<mys::Tuple<T...>>
+    {
+        std::size_t operator()(mys::Tuple<T...> const& tup) const noexcept
+        {
+            if (tup.is_none()) {
+                return 0;
+            }
 
+            return std::apply(
+                [](const T&... items) {
+                    std::size_t hash = 0;
+                    (..., (hash = mys::hash_combine(hash, std::hash<T>()(items))));
+                    return hash;
+                },
+                tup->m_tuple);
+        }
+    };
 }
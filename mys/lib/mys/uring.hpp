@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../mys.hpp"
+
+#if defined(__linux__)
+#    include <linux/io_uring.h>
+#endif
+
+// An optional io_uring backend for file and socket IO, enabled by
+// setting the environment variable MYS_IO_URING to yes. It is used
+// instead of libuv by the file package, and for TCP reads by the net
+// package.
+//
+// The ring is only accessed by the reactor. Submitted requests are
+// batched and passed to the kernel with one system call just before the
+// reactor waits for events, and the ring's file descriptor is polled by
+// the libuv loop for completions.
+namespace mys::uring {
+
+#if defined(__linux__)
+
+// True if io_uring is enabled and supported by the kernel. Must only be
+// called by the reactor.
+bool is_enabled();
+
+// Submit given request. The operation is completed with the request's
+// result, a negative errno on failure. Must only be called by the
+// reactor.
+void submit(io_uring_sqe& sqe, Operation *operation_p);
+
+// Cancel the submitted request of given operation, if not yet complete.
+// The operation is completed with -ECANCELED if cancelled.
+void cancel(Operation *operation_p);
+
+// Register given buffers with the kernel, replacing any previously
+// registered buffers. Reads and writes of registered buffers use fixed
+// buffer requests, which saves mapping the pages on each request. The
+// buffers must not be resized while registered. Returns a libuv status
+// code.
+int register_buffers(const std::vector<iovec>& buffers);
+
+void unregister_buffers();
+
+// Index of the registered buffer containing given memory, or -1.
+int find_buffer(const void *buf_p, size_t size);
+
+#else
+
+inline bool is_enabled()
+{
+    return false;
+}
+
+inline void cancel(Operation *)
+{
+}
+
+inline int register_buffers(const std::vector<iovec>&)
+{
+    return 0;
+}
+
+inline void unregister_buffers()
+{
+}
+
+#endif
+
+}
@@ -49,4 +49,19 @@ std::ostream& operator<<(std::ostream& os, const std::vector<T>& obj)
     return os;
 }
 
+// A copy of the items of given range, iterated by loops that may change
+// the container. Given size, if known, is the number of items.
+template <typename TRange>
+auto snapshot(const TRange& range, i64 size = 0)
+{
+    std::vector<std::decay_t<decltype(*range.begin())>> items;
+    items.reserve(size);
+
+    for (const auto& item : range) {
+        items.push_back(item);
+    }
+
+    return items;
+}
+
 }
@@ -0,0 +1,278 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "file.hpp"
+
+namespace mys::file {
+
+struct Request {
+    enum class Type {
+        OPEN,
+        READ,
+        WRITE,
+        SIZE,
+        CLOSE
+    } type;
+    const char *path_p;
+    int flags;
+    int mode;
+    int fd;
+    u8 *buf_p;
+    size_t size;
+    i64 offset;
+    uv_fs_t fs;
+#if defined(__linux__)
+    struct statx statx;
+#endif
+    Operation operation;
+
+    Request(Type type) : type(type), path_p(NULL), fd(-1), buf_p(NULL), size(0), offset(0)
+    {
+        memset(&fs, 0, sizeof(fs));
+        fs.data = this;
+    }
+
+    ~Request()
+    {
+        uv_fs_req_cleanup(&fs);
+    }
+};
+
+#if defined(__linux__)
+
+static void start_uring(Request& request)
+{
+    io_uring_sqe sqe;
+    int index;
+
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = request.fd;
+
+    switch (request.type) {
+    case Request::Type::OPEN:
+        sqe.opcode = IORING_OP_OPENAT;
+        sqe.fd = AT_FDCWD;
+        sqe.addr = (u64)request.path_p;
+        sqe.len = request.mode;
+        sqe.open_flags = request.flags | O_CLOEXEC;
+        break;
+
+    case Request::Type::READ:
+    case Request::Type::WRITE:
+        index = uring::find_buffer(request.buf_p, request.size);
+
+        if (index >= 0) {
+            sqe.opcode = (request.type == Request::Type::READ
+                          ? IORING_OP_READ_FIXED
+                          : IORING_OP_WRITE_FIXED);
+            sqe.buf_index = index;
+        } else {
+            sqe.opcode = (request.type == Request::Type::READ
+                          ? IORING_OP_READ
+                          : IORING_OP_WRITE);
+        }
+
+        sqe.addr = (u64)request.buf_p;
+        sqe.len = request.size;
+        sqe.off = request.offset;
+        break;
+
+    case Request::Type::SIZE:
+        sqe.opcode = IORING_OP_STATX;
+        sqe.addr = (u64)"";
+        sqe.len = STATX_SIZE;
+        sqe.off = (u64)&request.statx;
+        sqe.statx_flags = AT_EMPTY_PATH;
+        break;
+
+    case Request::Type::CLOSE:
+        sqe.opcode = IORING_OP_CLOSE;
+        break;
+    }
+
+    uring::submit(sqe, &request.operation);
+}
+
+#endif
+
+static void on_fs(uv_fs_t *fs_p)
+{
+    Request *request_p = (Request *)fs_p->data;
+
+    request_p->operation.complete(fs_p->result);
+}
+
+static int start_libuv(Request& request)
+{
+    uv_loop_t *loop_p = uv_default_loop();
+    uv_buf_t buf = uv_buf_init((char *)request.buf_p, request.size);
+
+    switch (request.type) {
+    case Request::Type::OPEN:
+        return uv_fs_open(loop_p,
+                          &request.fs,
+                          request.path_p,
+                          request.flags,
+                          request.mode,
+                          on_fs);
+
+    case Request::Type::READ:
+        return uv_fs_read(loop_p, &request.fs, request.fd, &buf, 1, request.offset, on_fs);
+
+    case Request::Type::WRITE:
+        return uv_fs_write(loop_p, &request.fs, request.fd, &buf, 1, request.offset, on_fs);
+
+    case Request::Type::SIZE:
+        return uv_fs_fstat(loop_p, &request.fs, request.fd, on_fs);
+
+    case Request::Type::CLOSE:
+        return uv_fs_close(loop_p, &request.fs, request.fd, on_fs);
+    }
+
+    return UV_EINVAL;
+}
+
+// Runs given request with io_uring if enabled, and libuv otherwise. File
+// requests cannot be aborted, so a cancelled fiber waits for the request
+// to complete. Returns true if cancelled.
+static bool run(Request& request)
+{
+    request.operation.start();
+    call_in_reactor([&request]() {
+#if defined(__linux__)
+        if (uring::is_enabled()) {
+            start_uring(request);
+
+            return;
+        }
+#endif
+
+        int res = start_libuv(request);
+
+        if (res < 0) {
+            request.operation.complete(res);
+        }
+    });
+
+    return request.operation.wait();
+}
+
+int open(const std::string& path, int flags, int mode)
+{
+    Request request(Request::Type::OPEN);
+
+    request.path_p = path.c_str();
+    request.flags = flags;
+    request.mode = mode;
+
+    if (run(request)) {
+        if (request.operation.result >= 0) {
+            ::close(request.operation.result);
+        }
+
+        return UV_ECANCELED;
+    }
+
+    return request.operation.result;
+}
+
+ssize_t read(int fd, u8 *buf_p, size_t size, i64 offset)
+{
+    Request request(Request::Type::READ);
+
+    request.fd = fd;
+    request.buf_p = buf_p;
+    request.size = size;
+    request.offset = offset;
+
+    if (run(request)) {
+        return UV_ECANCELED;
+    }
+
+    return request.operation.result;
+}
+
+ssize_t write(int fd, const u8 *buf_p, size_t size, i64 offset)
+{
+    Request request(Request::Type::WRITE);
+
+    request.fd = fd;
+    request.buf_p = (u8 *)buf_p;
+    request.size = size;
+    request.offset = offset;
+
+    if (run(request)) {
+        return UV_ECANCELED;
+    }
+
+    return request.operation.result;
+}
+
+i64 size(int fd)
+{
+    Request request(Request::Type::SIZE);
+
+    request.fd = fd;
+
+    if (run(request)) {
+        return UV_ECANCELED;
+    }
+
+    if (request.operation.result < 0) {
+        return request.operation.result;
+    }
+
+#if defined(__linux__)
+    if (request.fs.type != UV_FS) {
+        return request.statx.stx_size;
+    }
+#endif
+
+    return request.fs.statbuf.st_size;
+}
+
+int close(int fd)
+{
+    Request request(Request::Type::CLOSE);
+
+    request.fd = fd;
+
+    if (run(request)) {
+        return UV_ECANCELED;
+    }
+
+    return request.operation.result;
+}
+
+int register_buffers(const std::vector<iovec>& buffers)
+{
+    return call_in_reactor_and_wait([&buffers]() {
+        if (!uring::is_enabled()) {
+            return 0;
+        }
+
+        return uring::register_buffers(buffers);
+    });
+}
+
+void unregister_buffers()
+{
+    call_in_reactor_and_wait([]() {
+        if (uring::is_enabled()) {
+            uring::unregister_buffers();
+        }
+
+        return 0;
+    });
+}
+
+const char *backend()
+{
+    if (call_in_reactor_and_wait([]() { return uring::is_enabled(); }) == 1) {
+        return "io_uring";
+    }
+
+    return "libuv";
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include "mys.hpp"
+#include "mys/uring.hpp"
+
+// Files for fibers. Requests are made by the reactor, with io_uring if
+// enabled and libuv otherwise, while the calling fiber is suspended. See
+// mys/uring.hpp.
+//
+// All functions return a libuv status code on failure, and
+// UV_ECANCELED if the calling fiber was cancelled. A cancelled request
+// has still completed when the function returns.
+namespace mys::file {
+
+// Open given file. Returns its file descriptor.
+int open(const std::string& path, int flags, int mode);
+
+// Reads at most given number of bytes at given offset into given
+// buffer. Returns number of read bytes, zero at end of file.
+ssize_t read(int fd, u8 *buf_p, size_t size, i64 offset);
+
+// Writes given number of bytes at given offset from given
+// buffer. Returns number of written bytes.
+ssize_t write(int fd, const u8 *buf_p, size_t size, i64 offset);
+
+// Size of given file.
+i64 size(int fd);
+
+int close(int fd);
+
+// Register given buffers for faster reads and writes. Does nothing if
+// io_uring is not enabled.
+int register_buffers(const std::vector<iovec>& buffers);
+
+void unregister_buffers();
+
+// "io_uring" or "libuv".
+const char *backend();
+
+}
@@ -0,0 +1,725 @@
+#include <cstring>
+#include "net.hpp"
+
+namespace mys::net {
+
+struct Lookup {
+    uv_getaddrinfo_t request;
+    sockaddr_storage *address_p;
+    Operation operation;
+};
+
+static void on_getaddrinfo(uv_getaddrinfo_t *request_p, int status, addrinfo *info_p)
+{
+    Lookup *lookup_p = (Lookup *)request_p->data;
+
+    if (status == 0) {
+        memcpy(lookup_p->address_p, info_p->ai_addr, info_p->ai_addrlen);
+        uv_freeaddrinfo(info_p);
+    }
+
+    lookup_p->operation.complete(status);
+}
+
+int resolve(const std::string& host, int port, sockaddr_storage& address)
+{
+    if (uv_ip4_addr(host.c_str(), port, (sockaddr_in *)&address) == 0) {
+        return 0;
+    }
+
+    if (uv_ip6_addr(host.c_str(), port, (sockaddr_in6 *)&address) == 0) {
+        return 0;
+    }
+
+    Lookup lookup;
+    std::string service = std::to_string(port);
+
+    lookup.request.data = &lookup;
+    lookup.address_p = &address;
+    lookup.operation.start();
+    call_in_reactor([&lookup, &host, &service]() {
+        addrinfo hints;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        int res = uv_getaddrinfo(uv_default_loop(),
+                                 &lookup.request,
+                                 on_getaddrinfo,
+                                 host.c_str(),
+                                 service.c_str(),
+                                 &hints);
+
+        if (res != 0) {
+            lookup.operation.complete(res);
+        }
+    });
+
+    bool cancelled = lookup.operation.wait([&lookup]() {
+        uv_cancel((uv_req_t *)&lookup.request);
+    });
+
+    if (cancelled) {
+        return UV_ECANCELED;
+    }
+
+    return lookup.operation.result;
+}
+
+void host_and_port(const sockaddr_storage& address, std::string& host, int& port)
+{
+    char buf[INET6_ADDRSTRLEN];
+
+    if (address.ss_family == AF_INET6) {
+        const sockaddr_in6 *address_p = (const sockaddr_in6 *)&address;
+        uv_ip6_name(address_p, &buf[0], sizeof(buf));
+        port = ntohs(address_p->sin6_port);
+    } else {
+        const sockaddr_in *address_p = (const sockaddr_in *)&address;
+        uv_ip4_name(address_p, &buf[0], sizeof(buf));
+        port = ntohs(address_p->sin_port);
+    }
+
+    host = &buf[0];
+}
+
+// Pending requests are cancelled with UV_ECANCELED when a handle is
+// closed, which is reserved for cancelled fibers.
+static int closed_status(int status)
+{
+    if (status == UV_ECANCELED) {
+        status = UV_EBADF;
+    }
+
+    return status;
+}
+
+TcpHandle::TcpHandle()
+    : m_pending_connections(0),
+      m_accepting(false),
+      m_accepted_p(NULL),
+      m_reading(false),
+      m_read_buf_p(NULL),
+      m_read_size(0),
+      m_closing(false),
+      m_closed(false),
+      m_delete_on_close(false)
+{
+}
+
+void TcpHandle::init()
+{
+    uv_tcp_init(uv_default_loop(), &m_tcp);
+    m_tcp.data = this;
+}
+
+TcpHandle *TcpHandle::create()
+{
+    TcpHandle *handle_p = new TcpHandle();
+
+    call_in_reactor([handle_p]() {
+        handle_p->init();
+    });
+
+    return handle_p;
+}
+
+void TcpHandle::destroy(TcpHandle *handle_p)
+{
+    call_in_reactor([handle_p]() {
+        handle_p->m_delete_on_close = true;
+
+        if (!handle_p->m_closing) {
+            handle_p->close_in_reactor();
+        } else if (handle_p->m_closed) {
+            delete handle_p;
+        }
+    });
+}
+
+void TcpHandle::close_in_reactor()
+{
+    if (m_closing) {
+        return;
+    }
+
+    m_closing = true;
+
+    if (m_accepting) {
+        m_accepting = false;
+        m_read_operation.complete(UV_EBADF);
+    }
+
+    if (m_reading) {
+        stop_reading(0);
+    } else if (uring::is_enabled()) {
+        // Closing the socket does not complete a pending receive.
+        uring::cancel(&m_read_operation);
+    }
+
+    uv_close((uv_handle_t *)&m_tcp, on_close);
+}
+
+void TcpHandle::on_close(uv_handle_t *handle_p)
+{
+    TcpHandle *self_p = (TcpHandle *)handle_p->data;
+
+    self_p->m_closed = true;
+
+    if (self_p->m_delete_on_close) {
+        delete self_p;
+    }
+}
+
+int TcpHandle::bind(const sockaddr_storage& address)
+{
+    return call_in_reactor_and_wait([this, &address]() {
+        return uv_tcp_bind(&m_tcp, (const sockaddr *)&address, 0);
+    });
+}
+
+void TcpHandle::on_connection(uv_stream_t *stream_p, int status)
+{
+    TcpHandle *self_p = (TcpHandle *)stream_p->data;
+
+    if (status != 0) {
+        if (self_p->m_accepting) {
+            self_p->m_accepting = false;
+            self_p->m_read_operation.complete(status);
+        }
+
+        return;
+    }
+
+    self_p->m_pending_connections++;
+
+    if (self_p->m_accepting) {
+        self_p->do_accept();
+    }
+}
+
+int TcpHandle::listen(int backlog)
+{
+    return call_in_reactor_and_wait([this, backlog]() {
+        return uv_listen((uv_stream_t *)&m_tcp, backlog, on_connection);
+    });
+}
+
+void TcpHandle::do_accept()
+{
+    TcpHandle *handle_p = new TcpHandle();
+
+    handle_p->init();
+    int res = uv_accept((uv_stream_t *)&m_tcp, (uv_stream_t *)&handle_p->m_tcp);
+
+    if (res == UV_EAGAIN) {
+        // The connection is gone. Wait for another one.
+        m_pending_connections = 0;
+        handle_p->m_delete_on_close = true;
+        handle_p->close_in_reactor();
+
+        return;
+    }
+
+    m_pending_connections--;
+    m_accepting = false;
+
+    if (res == 0) {
+        m_accepted_p = handle_p;
+    } else {
+        handle_p->m_delete_on_close = true;
+        handle_p->close_in_reactor();
+    }
+
+    m_read_operation.complete(res);
+}
+
+int TcpHandle::accept(TcpHandle *& handle_p)
+{
+    m_read_operation.start();
+    call_in_reactor([this]() {
+        if (m_closing) {
+            m_read_operation.complete(UV_EBADF);
+
+            return;
+        }
+
+        m_accepting = true;
+
+        if (m_pending_connections > 0) {
+            do_accept();
+        }
+    });
+
+    bool cancelled = m_read_operation.wait([this]() {
+        if (m_accepting) {
+            m_accepting = false;
+            m_read_operation.complete(UV_ECANCELED);
+        }
+    });
+
+    if (m_read_operation.result == 0) {
+        if (cancelled) {
+            destroy(m_accepted_p);
+        } else {
+            handle_p = m_accepted_p;
+        }
+    }
+
+    if (cancelled) {
+        return UV_ECANCELED;
+    }
+
+    return m_read_operation.result;
+}
+
+void TcpHandle::on_connect(uv_connect_t *request_p, int status)
+{
+    TcpHandle *self_p = (TcpHandle *)request_p->handle->data;
+
+    self_p->m_write_operation.complete(closed_status(status));
+}
+
+int TcpHandle::connect(const sockaddr_storage& address)
+{
+    m_write_operation.start();
+    call_in_reactor([this, &address]() {
+        if (m_closing) {
+            m_write_operation.complete(UV_EBADF);
+
+            return;
+        }
+
+        int res = uv_tcp_connect(&m_connect,
+                                 &m_tcp,
+                                 (const sockaddr *)&address,
+                                 on_connect);
+
+        if (res != 0) {
+            m_write_operation.complete(res);
+        }
+    });
+
+    if (m_write_operation.wait()) {
+        return UV_ECANCELED;
+    }
+
+    return m_write_operation.result;
+}
+
+int TcpHandle::address(sockaddr_storage& address)
+{
+    return call_in_reactor_and_wait([this, &address]() {
+        int length = sizeof(address);
+
+        return uv_tcp_getsockname(&m_tcp, (sockaddr *)&address, &length);
+    });
+}
+
+void TcpHandle::stop_reading(ssize_t result)
+{
+    uv_read_stop((uv_stream_t *)&m_tcp);
+    m_reading = false;
+    m_read_operation.complete(result);
+}
+
+// Data is read directly into the buffer given to read().
+void TcpHandle::on_alloc(uv_handle_t *handle_p, size_t size, uv_buf_t *buf_p)
+{
+    TcpHandle *self_p = (TcpHandle *)handle_p->data;
+
+    *buf_p = uv_buf_init((char *)self_p->m_read_buf_p, self_p->m_read_size);
+}
+
+void TcpHandle::on_read(uv_stream_t *stream_p, ssize_t nread, const uv_buf_t *buf_p)
+{
+    TcpHandle *self_p = (TcpHandle *)stream_p->data;
+
+    if (nread == 0) {
+        return;
+    }
+
+    if (nread == UV_EOF) {
+        nread = 0;
+    }
+
+    self_p->stop_reading(nread);
+}
+
+// Receive with io_uring instead of libuv. The request completes the read
+// operation directly.
+void TcpHandle::recv_with_uring(u8 *buf_p, size_t size)
+{
+#if defined(__linux__)
+    io_uring_sqe sqe;
+    uv_os_fd_t fd;
+
+    uv_fileno((uv_handle_t *)&m_tcp, &fd);
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = fd;
+    sqe.addr = (u64)buf_p;
+    sqe.len = size;
+    uring::submit(sqe, &m_read_operation);
+#endif
+}
+
+ssize_t TcpHandle::read(u8 *buf_p, size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    m_read_operation.start();
+    call_in_reactor([this, buf_p, size]() {
+        if (!m_pending.empty()) {
+            size_t count = std::min(size, m_pending.size());
+            memcpy(buf_p, m_pending.data(), count);
+            m_pending.erase(m_pending.begin(), m_pending.begin() + count);
+            m_read_operation.complete(count);
+
+            return;
+        }
+
+        if (m_closing) {
+            m_read_operation.complete(0);
+
+            return;
+        }
+
+        if (uring::is_enabled()) {
+            recv_with_uring(buf_p, size);
+
+            return;
+        }
+
+        m_read_buf_p = buf_p;
+        m_read_size = size;
+        int res = uv_read_start((uv_stream_t *)&m_tcp, on_alloc, on_read);
+
+        if (res != 0) {
+            m_read_operation.complete(res);
+
+            return;
+        }
+
+        m_reading = true;
+    });
+
+    bool cancelled = m_read_operation.wait([this]() {
+        if (uring::is_enabled()) {
+            uring::cancel(&m_read_operation);
+        } else if (m_reading) {
+            stop_reading(UV_ECANCELED);
+        }
+    });
+    ssize_t result = m_read_operation.result;
+
+    if (cancelled) {
+        // Data may have been received before the read was stopped.
+        if (result > 0) {
+            m_pending.insert(m_pending.begin(), buf_p, buf_p + result);
+        }
+
+        return UV_ECANCELED;
+    }
+
+    // Receives are only cancelled by close() when not cancelled by the
+    // fiber.
+    if (result == UV_ECANCELED) {
+        result = 0;
+    }
+
+    return result;
+}
+
+void TcpHandle::on_write(uv_write_t *request_p, int status)
+{
+    TcpHandle *self_p = (TcpHandle *)request_p->handle->data;
+
+    self_p->m_write_operation.complete(closed_status(status));
+}
+
+int TcpHandle::write(uv_buf_t *bufs_p, unsigned int count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    m_write_operation.start();
+    call_in_reactor([this, bufs_p, count]() {
+        if (m_closing) {
+            m_write_operation.complete(UV_EBADF);
+
+            return;
+        }
+
+        unsigned int index = 0;
+        int res = uv_try_write((uv_stream_t *)&m_tcp, bufs_p, count);
+
+        if (res >= 0) {
+            while ((index < count) && ((size_t)res >= bufs_p[index].len)) {
+                res -= bufs_p[index].len;
+                index++;
+            }
+
+            if (index == count) {
+                m_write_operation.complete(0);
+
+                return;
+            }
+
+            bufs_p[index].base += res;
+            bufs_p[index].len -= res;
+        } else if (res != UV_EAGAIN) {
+            m_write_operation.complete(res);
+
+            return;
+        }
+
+        res = uv_write(&m_write,
+                       (uv_stream_t *)&m_tcp,
+                       &bufs_p[index],
+                       count - index,
+                       on_write);
+
+        if (res != 0) {
+            m_write_operation.complete(res);
+        }
+    });
+
+    if (m_write_operation.wait()) {
+        return UV_ECANCELED;
+    }
+
+    return m_write_operation.result;
+}
+
+void TcpHandle::close()
+{
+    call_in_reactor([this]() {
+        close_in_reactor();
+    });
+}
+
+UdpHandle::UdpHandle()
+    : m_receiving(false),
+      m_recv_buf_p(NULL),
+      m_recv_size(0),
+      m_sender_p(NULL),
+      m_closing(false),
+      m_closed(false),
+      m_delete_on_close(false)
+{
+}
+
+void UdpHandle::init()
+{
+    uv_udp_init(uv_default_loop(), &m_udp);
+    m_udp.data = this;
+}
+
+UdpHandle *UdpHandle::create()
+{
+    UdpHandle *handle_p = new UdpHandle();
+
+    call_in_reactor([handle_p]() {
+        handle_p->init();
+    });
+
+    return handle_p;
+}
+
+void UdpHandle::destroy(UdpHandle *handle_p)
+{
+    call_in_reactor([handle_p]() {
+        handle_p->m_delete_on_close = true;
+
+        if (!handle_p->m_closing) {
+            handle_p->close_in_reactor();
+        } else if (handle_p->m_closed) {
+            delete handle_p;
+        }
+    });
+}
+
+void UdpHandle::close_in_reactor()
+{
+    if (m_closing) {
+        return;
+    }
+
+    m_closing = true;
+
+    if (m_receiving) {
+        stop_receiving(UV_EBADF);
+    }
+
+    uv_close((uv_handle_t *)&m_udp, on_close);
+}
+
+void UdpHandle::on_close(uv_handle_t *handle_p)
+{
+    UdpHandle *self_p = (UdpHandle *)handle_p->data;
+
+    self_p->m_closed = true;
+
+    if (self_p->m_delete_on_close) {
+        delete self_p;
+    }
+}
+
+int UdpHandle::bind(const sockaddr_storage& address)
+{
+    return call_in_reactor_and_wait([this, &address]() {
+        return uv_udp_bind(&m_udp, (const sockaddr *)&address, 0);
+    });
+}
+
+int UdpHandle::address(sockaddr_storage& address)
+{
+    return call_in_reactor_and_wait([this, &address]() {
+        int length = sizeof(address);
+
+        return uv_udp_getsockname(&m_udp, (sockaddr *)&address, &length);
+    });
+}
+
+void UdpHandle::on_send(uv_udp_send_t *request_p, int status)
+{
+    UdpHandle *self_p = (UdpHandle *)request_p->handle->data;
+
+    self_p->m_send_operation.complete(closed_status(status));
+}
+
+int UdpHandle::send(uv_buf_t *bufs_p,
+                    unsigned int count,
+                    const sockaddr_storage& address)
+{
+    m_send_operation.start();
+    call_in_reactor([this, bufs_p, count, &address]() {
+        if (m_closing) {
+            m_send_operation.complete(UV_EBADF);
+
+            return;
+        }
+
+        int res = uv_udp_try_send(&m_udp,
+                                  bufs_p,
+                                  count,
+                                  (const sockaddr *)&address);
+
+        if (res >= 0) {
+            m_send_operation.complete(0);
+
+            return;
+        } else if (res != UV_EAGAIN) {
+            m_send_operation.complete(res);
+
+            return;
+        }
+
+        res = uv_udp_send(&m_send,
+                          &m_udp,
+                          bufs_p,
+                          count,
+                          (const sockaddr *)&address,
+                          on_send);
+
+        if (res != 0) {
+            m_send_operation.complete(res);
+        }
+    });
+
+    if (m_send_operation.wait()) {
+        return UV_ECANCELED;
+    }
+
+    return m_send_operation.result;
+}
+
+void UdpHandle::stop_receiving(ssize_t result)
+{
+    uv_udp_recv_stop(&m_udp);
+    m_receiving = false;
+    m_recv_operation.complete(result);
+}
+
+// Datagrams are received directly into the buffer given to recv().
+void UdpHandle::on_alloc(uv_handle_t *handle_p, size_t size, uv_buf_t *buf_p)
+{
+    UdpHandle *self_p = (UdpHandle *)handle_p->data;
+
+    *buf_p = uv_buf_init((char *)self_p->m_recv_buf_p, self_p->m_recv_size);
+}
+
+void UdpHandle::on_recv(uv_udp_t *udp_p,
+                        ssize_t nread,
+                        const uv_buf_t *buf_p,
+                        const sockaddr *address_p,
+                        unsigned flags)
+{
+    UdpHandle *self_p = (UdpHandle *)udp_p->data;
+
+    // Nothing more to receive for now.
+    if ((nread == 0) && (address_p == NULL)) {
+        return;
+    }
+
+    if (address_p != NULL) {
+        if (address_p->sa_family == AF_INET6) {
+            memcpy(self_p->m_sender_p, address_p, sizeof(sockaddr_in6));
+        } else {
+            memcpy(self_p->m_sender_p, address_p, sizeof(sockaddr_in));
+        }
+    }
+
+    self_p->stop_receiving(nread);
+}
+
+ssize_t UdpHandle::recv(u8 *buf_p, size_t size, sockaddr_storage& sender)
+{
+    m_recv_operation.start();
+    call_in_reactor([this, buf_p, size, &sender]() {
+        if (m_closing) {
+            m_recv_operation.complete(UV_EBADF);
+
+            return;
+        }
+
+        m_recv_buf_p = buf_p;
+        m_recv_size = size;
+        m_sender_p = &sender;
+        int res = uv_udp_recv_start(&m_udp, on_alloc, on_recv);
+
+        if (res != 0) {
+            m_recv_operation.complete(res);
+
+            return;
+        }
+
+        m_receiving = true;
+    });
+
+    // A datagram received before receiving was stopped is lost.
+    bool cancelled = m_recv_operation.wait([this]() {
+        if (m_receiving) {
+            stop_receiving(UV_ECANCELED);
+        }
+    });
+
+    if (cancelled) {
+        return UV_ECANCELED;
+    }
+
+    return m_recv_operation.result;
+}
+
+void UdpHandle::close()
+{
+    call_in_reactor([this]() {
+        close_in_reactor();
+    });
+}
+
+}
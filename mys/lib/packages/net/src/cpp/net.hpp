@@ -0,0 +1,134 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include "mys.hpp"
+#include "mys/uring.hpp"
+
+// Sockets for fibers. All libuv calls are made in the reactor, that is
+// the idle fiber in single-core builds and the reactor thread in
+// multi-core builds, while the calling fiber is suspended.
+//
+// Functions returning a libuv status code return UV_ECANCELED if the
+// calling fiber was cancelled.
+//
+// TCP reads use io_uring instead of libuv if enabled, see mys/uring.hpp.
+namespace mys::net {
+
+// Resolve given host and port. Numeric addresses are parsed at once,
+// others are looked up by the reactor.
+int resolve(const std::string& host, int port, sockaddr_storage& address);
+
+// Host and port of given IPv4 or IPv6 address.
+void host_and_port(const sockaddr_storage& address, std::string& host, int& port);
+
+class TcpHandle {
+private:
+    uv_tcp_t m_tcp;
+    uv_connect_t m_connect;
+    uv_write_t m_write;
+    // Accept, read and close states, only accessed by the reactor.
+    int m_pending_connections;
+    bool m_accepting;
+    TcpHandle *m_accepted_p;
+    bool m_reading;
+    u8 *m_read_buf_p;
+    size_t m_read_size;
+    bool m_closing;
+    bool m_closed;
+    bool m_delete_on_close;
+    // Received data of a cancelled read, returned by next read.
+    std::vector<u8> m_pending;
+    // Accepting and reading.
+    Operation m_read_operation;
+    // Connecting and writing.
+    Operation m_write_operation;
+
+    TcpHandle();
+    void init();
+    void close_in_reactor();
+    void do_accept();
+    void stop_reading(ssize_t result);
+    void recv_with_uring(u8 *buf_p, size_t size);
+    static void on_connection(uv_stream_t *stream_p, int status);
+    static void on_connect(uv_connect_t *request_p, int status);
+    static void on_alloc(uv_handle_t *handle_p, size_t size, uv_buf_t *buf_p);
+    static void on_read(uv_stream_t *stream_p, ssize_t nread, const uv_buf_t *buf_p);
+    static void on_write(uv_write_t *request_p, int status);
+    static void on_close(uv_handle_t *handle_p);
+
+public:
+    // Create a handle, initialized by the reactor.
+    static TcpHandle *create();
+
+    // Close the handle, if not already closed, and then delete it.
+    static void destroy(TcpHandle *handle_p);
+
+    int bind(const sockaddr_storage& address);
+    int listen(int backlog);
+    int accept(TcpHandle *& handle_p);
+    int connect(const sockaddr_storage& address);
+    int address(sockaddr_storage& address);
+
+    // Reads at most given number of bytes into given buffer. Returns
+    // number of read bytes, zero at end of stream or if closed, or a
+    // libuv status code.
+    ssize_t read(u8 *buf_p, size_t size);
+
+    // Writes given buffers in order. Tries to write them all at once
+    // without suspending first.
+    int write(uv_buf_t *bufs_p, unsigned int count);
+
+    void close();
+};
+
+class UdpHandle {
+private:
+    uv_udp_t m_udp;
+    uv_udp_send_t m_send;
+    // Receive and close states, only accessed by the reactor.
+    bool m_receiving;
+    u8 *m_recv_buf_p;
+    size_t m_recv_size;
+    sockaddr_storage *m_sender_p;
+    bool m_closing;
+    bool m_closed;
+    bool m_delete_on_close;
+    Operation m_recv_operation;
+    Operation m_send_operation;
+
+    UdpHandle();
+    void init();
+    void close_in_reactor();
+    void stop_receiving(ssize_t result);
+    static void on_alloc(uv_handle_t *handle_p, size_t size, uv_buf_t *buf_p);
+    static void on_recv(uv_udp_t *udp_p,
+                        ssize_t nread,
+                        const uv_buf_t *buf_p,
+                        const sockaddr *address_p,
+                        unsigned flags);
+    static void on_send(uv_udp_send_t *request_p, int status);
+    static void on_close(uv_handle_t *handle_p);
+
+public:
+    // Create a handle, initialized by the reactor.
+    static UdpHandle *create();
+
+    // Close the handle, if not already closed, and then delete it.
+    static void destroy(UdpHandle *handle_p);
+
+    int bind(const sockaddr_storage& address);
+    int address(sockaddr_storage& address);
+
+    // Sends given buffers as one datagram. Tries to send it without
+    // suspending first.
+    int send(uv_buf_t *bufs_p, unsigned int count, const sockaddr_storage& address);
+
+    // Receives one datagram into given buffer, truncated to given
+    // size. Returns its size, or a libuv status code.
+    ssize_t recv(u8 *buf_p, size_t size, sockaddr_storage& sender);
+
+    void close();
+};
+
+}
@@ -0,0 +1,364 @@
+#include "mys/uring.hpp"
+
+#if defined(__linux__)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#if !defined(__NR_io_uring_setup)
+#    define __NR_io_uring_setup 425
+#    define __NR_io_uring_enter 426
+#    define __NR_io_uring_register 427
+#endif
+
+namespace mys::uring {
+
+static int io_uring_setup(unsigned entries, io_uring_params *params_p)
+{
+    return syscall(__NR_io_uring_setup, entries, params_p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, 0, 0, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void *arg_p, unsigned count)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg_p, count);
+}
+
+class Ring {
+private:
+    int m_fd;
+    unsigned *m_sq_head_p;
+    unsigned *m_sq_tail_p;
+    unsigned m_sq_mask;
+    unsigned *m_sq_array_p;
+    unsigned m_sq_entries;
+    io_uring_sqe *m_sqes_p;
+    unsigned *m_cq_head_p;
+    unsigned *m_cq_tail_p;
+    unsigned m_cq_mask;
+    io_uring_cqe *m_cqes_p;
+    // Number of requests added to the submission queue but not yet
+    // passed to the kernel.
+    unsigned m_to_submit;
+    // Number of requests submitted but not yet completed. The ring is
+    // only polled when non-zero, so that the loop can run out of events.
+    size_t m_in_flight;
+    uv_poll_t m_poll;
+    uv_prepare_t m_prepare;
+    std::vector<iovec> m_buffers;
+
+    static void on_prepare(uv_prepare_t *handle_p);
+    static void on_poll(uv_poll_t *handle_p, int status, int events);
+
+public:
+    bool setup(unsigned entries);
+    io_uring_sqe *get_sqe();
+    void flush();
+    void reap();
+    void started();
+    int register_buffers(const std::vector<iovec>& buffers);
+    void unregister_buffers();
+    int find_buffer(const void *buf_p, size_t size);
+};
+
+bool Ring::setup(unsigned entries)
+{
+    io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    m_fd = io_uring_setup(entries, &params);
+
+    if (m_fd < 0) {
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sq_size = std::max(sq_size, cq_size);
+        cq_size = sq_size;
+    }
+
+    u8 *sq_p = (u8 *)mmap(NULL,
+                          sq_size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          m_fd,
+                          IORING_OFF_SQ_RING);
+
+    if (sq_p == MAP_FAILED) {
+        close(m_fd);
+
+        return false;
+    }
+
+    u8 *cq_p = sq_p;
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq_p = (u8 *)mmap(NULL,
+                          cq_size,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          m_fd,
+                          IORING_OFF_CQ_RING);
+
+        if (cq_p == MAP_FAILED) {
+            close(m_fd);
+
+            return false;
+        }
+    }
+
+    m_sqes_p = (io_uring_sqe *)mmap(NULL,
+                                    params.sq_entries * sizeof(io_uring_sqe),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE,
+                                    m_fd,
+                                    IORING_OFF_SQES);
+
+    if (m_sqes_p == MAP_FAILED) {
+        close(m_fd);
+
+        return false;
+    }
+
+    m_sq_head_p = (unsigned *)(sq_p + params.sq_off.head);
+    m_sq_tail_p = (unsigned *)(sq_p + params.sq_off.tail);
+    m_sq_mask = *(unsigned *)(sq_p + params.sq_off.ring_mask);
+    m_sq_array_p = (unsigned *)(sq_p + params.sq_off.array);
+    m_sq_entries = params.sq_entries;
+    m_cq_head_p = (unsigned *)(cq_p + params.cq_off.head);
+    m_cq_tail_p = (unsigned *)(cq_p + params.cq_off.tail);
+    m_cq_mask = *(unsigned *)(cq_p + params.cq_off.ring_mask);
+    m_cqes_p = (io_uring_cqe *)(cq_p + params.cq_off.cqes);
+    m_to_submit = 0;
+    m_in_flight = 0;
+    uv_poll_init(uv_default_loop(), &m_poll, m_fd);
+    m_poll.data = this;
+    uv_prepare_init(uv_default_loop(), &m_prepare);
+    m_prepare.data = this;
+
+    return true;
+}
+
+// Next free submission queue entry. Passes queued requests to the
+// kernel if the queue is full.
+io_uring_sqe *Ring::get_sqe()
+{
+    unsigned tail = *m_sq_tail_p;
+
+    while (tail - __atomic_load_n(m_sq_head_p, __ATOMIC_ACQUIRE) == m_sq_entries) {
+        flush();
+
+        if (m_to_submit > 0) {
+            reap();
+        }
+    }
+
+    unsigned index = tail & m_sq_mask;
+    m_sq_array_p[index] = index;
+
+    return &m_sqes_p[index];
+}
+
+// Called after the entry returned by get_sqe() has been filled in.
+void Ring::started()
+{
+    __atomic_store_n(m_sq_tail_p, *m_sq_tail_p + 1, __ATOMIC_RELEASE);
+
+    if (m_to_submit == 0) {
+        uv_prepare_start(&m_prepare, on_prepare);
+    }
+
+    m_to_submit++;
+
+    if (m_in_flight == 0) {
+        uv_poll_start(&m_poll, UV_READABLE, on_poll);
+    }
+
+    m_in_flight++;
+}
+
+void Ring::flush()
+{
+    while (m_to_submit > 0) {
+        int res = io_uring_enter(m_fd, m_to_submit);
+
+        if (res < 0) {
+            if ((errno == EINTR) || (errno == EAGAIN)) {
+                continue;
+            }
+
+            if (errno == EBUSY) {
+                // The completion queue is full. Submit the rest once
+                // completions have been reaped.
+                return;
+            }
+
+            print_traceback();
+            std::cerr << "\nPanic(message=\"io_uring_enter() failed with "
+                      << strerror(errno) << ".\")\n";
+            abort();
+        }
+
+        m_to_submit -= res;
+    }
+
+    uv_prepare_stop(&m_prepare);
+}
+
+void Ring::reap()
+{
+    unsigned head = *m_cq_head_p;
+    unsigned tail = __atomic_load_n(m_cq_tail_p, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        io_uring_cqe *cqe_p = &m_cqes_p[head & m_cq_mask];
+        Operation *operation_p = (Operation *)cqe_p->user_data;
+        int res = cqe_p->res;
+        head++;
+        __atomic_store_n(m_cq_head_p, head, __ATOMIC_RELEASE);
+        m_in_flight--;
+
+        // Cancel requests have no operation.
+        if (operation_p != NULL) {
+            operation_p->complete(res);
+        }
+
+        tail = __atomic_load_n(m_cq_tail_p, __ATOMIC_ACQUIRE);
+    }
+
+    if (m_in_flight == 0) {
+        uv_poll_stop(&m_poll);
+    }
+}
+
+// Requests queued by fibers since the last loop iteration are passed
+// to the kernel at once. Completions are not reaped here, as libuv has
+// already decided to wait for events, but when the ring's file
+// descriptor becomes readable.
+void Ring::on_prepare(uv_prepare_t *handle_p)
+{
+    ((Ring *)handle_p->data)->flush();
+}
+
+void Ring::on_poll(uv_poll_t *handle_p, int status, int events)
+{
+    Ring *ring_p = (Ring *)handle_p->data;
+
+    ring_p->reap();
+
+    if (ring_p->m_to_submit > 0) {
+        ring_p->flush();
+    }
+}
+
+int Ring::register_buffers(const std::vector<iovec>& buffers)
+{
+    unregister_buffers();
+
+    if (io_uring_register(m_fd,
+                          IORING_REGISTER_BUFFERS,
+                          buffers.data(),
+                          buffers.size()) < 0) {
+        return -errno;
+    }
+
+    m_buffers = buffers;
+
+    return 0;
+}
+
+void Ring::unregister_buffers()
+{
+    if (!m_buffers.empty()) {
+        io_uring_register(m_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+        m_buffers.clear();
+    }
+}
+
+int Ring::find_buffer(const void *buf_p, size_t size)
+{
+    for (size_t i = 0; i < m_buffers.size(); i++) {
+        u8 *base_p = (u8 *)m_buffers[i].iov_base;
+
+        if (((u8 *)buf_p >= base_p)
+            && ((u8 *)buf_p + size <= base_p + m_buffers[i].iov_len)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static Ring *ring_p = NULL;
+static bool is_initialized = false;
+
+static Ring *ring()
+{
+    if (!is_initialized) {
+        const char *value_p = getenv("MYS_IO_URING");
+
+        if ((value_p != NULL) && (strcmp(value_p, "yes") == 0)) {
+            ring_p = new Ring();
+
+            if (!ring_p->setup(256)) {
+                delete ring_p;
+                ring_p = NULL;
+            }
+        }
+
+        is_initialized = true;
+    }
+
+    return ring_p;
+}
+
+bool is_enabled()
+{
+    return ring() != NULL;
+}
+
+void submit(io_uring_sqe& sqe, Operation *operation_p)
+{
+    io_uring_sqe *sqe_p = ring()->get_sqe();
+
+    *sqe_p = sqe;
+    sqe_p->user_data = (u64)operation_p;
+    ring()->started();
+}
+
+void cancel(Operation *operation_p)
+{
+    io_uring_sqe *sqe_p = ring()->get_sqe();
+
+    memset(sqe_p, 0, sizeof(*sqe_p));
+    sqe_p->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe_p->addr = (u64)operation_p;
+    sqe_p->user_data = 0;
+    ring()->started();
+}
+
+int register_buffers(const std::vector<iovec>& buffers)
+{
+    return ring()->register_buffers(buffers);
+}
+
+void unregister_buffers()
+{
+    ring()->unregister_buffers();
+}
+
+int find_buffer(const void *buf_p, size_t size)
+{
+    return ring()->find_buffer(buf_p, size);
+}
+
+}
+
+#endif
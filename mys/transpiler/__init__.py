@@ -14,6 +14,7 @@ from pygments.token import Text
 
 from ..parser import ast
 from .class_transformer import ClassTransformer
+from .context import Features
 from .coverage_transformer import CoverageTransformer
 from .definitions import find_definitions
 from .definitions import make_fully_qualified_names_module
@@ -72,7 +73,8 @@ def transpile_file(tree,
                    has_main,
                    specialized_functions,
                    specialized_classes,
-                   coverage_variables):
+                   coverage_variables,
+                   features):
     namespace = 'mys::' + '::'.join(module_levels)
     source_visitor = SourceVisitor(namespace,
                                    module_levels,
@@ -85,7 +87,8 @@ def transpile_file(tree,
                                    skip_tests,
                                    specialized_functions,
                                    specialized_classes,
-                                   coverage_variables)
+                                   coverage_variables,
+                                   features)
     source_visitor.visit(tree)
     header_visitor = HeaderVisitor(namespace,
                                    module_levels,
@@ -95,7 +98,8 @@ def transpile_file(tree,
                                    module_definitions,
                                    has_main,
                                    specialized_classes,
-                                   source_visitor.method_comprehensions)
+                                   source_visitor.method_comprehensions,
+                                   features)
     header_visitor.visit(tree)
 
     return header_visitor, source_visitor
@@ -137,7 +141,15 @@ class Source:
             f'  skip_tests: {self.skip_tests}'
         ])
 
-def transpile(sources, coverage=False):
+def transpile(sources, coverage=False, features=None):
+    """Transpile given sources to C++. Language features used by the
+    program are recorded in given features, if not None.
+
+    """
+
+    if features is None:
+        features = Features()
+
     visitors = {}
     specialized_functions = {}
     specialized_classes = {}
@@ -200,7 +212,8 @@ def transpile(sources, coverage=False):
                 source.has_main,
                 specialized_functions,
                 specialized_classes,
-                source.coverage_variables)
+                source.coverage_variables,
+                features)
             visitors[source.module] = (header_visitor, source_visitor)
 
         for name, function in specialized_functions.items():
@@ -1,17 +1,21 @@
+import re
 import textwrap
+import warnings
 
 from ..parser import ast
 from .constant_visitor import is_constant
+from .context import Scope
 from .generics import TypeVisitor
 from .generics import add_generic_class
 from .generics import find_chosen_types
 from .generics import make_generic_name
 from .generics import specialize_function
-from .utils import BUILTIN_CALLS
+from .iterators import rename_locals
 from .utils import BUILTIN_ERRORS
 from .utils import BYTES_METHODS
 from .utils import CHAR_METHODS
 from .utils import COMPARISON_METHODS
+from .utils import DEQUE_METHODS
 from .utils import INTEGER_TYPES
 from .utils import LIST_METHODS
 from .utils import NUMBER_TYPES
@@ -20,21 +24,31 @@ from .utils import OPERATORS_TO_AUG_METHOD
 from .utils import OPERATORS_TO_METHOD
 from .utils import REGEX_METHODS
 from .utils import REGEXMATCH_METHODS
+from .utils import REGEXSET_METHODS
 from .utils import SET_METHODS
+from .utils import SORTED_DICT_METHODS
+from .utils import SORTED_SET_METHODS
 from .utils import STRING_METHODS
 from .utils import CompileError
+from .utils import Deque
 from .utils import GenericType
 from .utils import InternalError
+from .utils import SortedDict
+from .utils import SortedSet
 from .utils import dedent
 from .utils import dot2ns
 from .utils import format_binop
 from .utils import format_default_call
 from .utils import format_mys_type
+from .utils import has_docstring
 from .utils import indent
+from .utils import indent_lines
+from .utils import is_builtin_generic_subscript
 from .utils import is_float_literal
 from .utils import is_float_type
 from .utils import is_integer_literal
 from .utils import is_integer_type
+from .utils import is_name_assigned
 from .utils import is_primitive_type
 from .utils import is_private
 from .utils import is_snake_case
@@ -49,6 +63,7 @@ from .utils import mys_to_cpp_type
 from .utils import raise_if_wrong_types
 from .utils import raise_if_wrong_visited_type
 from .utils import raise_types_differs
+from .utils import sorted_method_types
 from .utils import split_dict_mys_type
 from .value_check_type_visitor import ValueCheckTypeVisitor
 from .value_type_visitor import Dict
@@ -64,6 +79,11 @@ BOOL_OPS = {
 }
 
 FOR_LOOP_FUNCS = set(['enumerate', 'range', 'reversed', 'slice', 'zip'])
+ITERATOR_FUNCS = set(['map', 'filter', 'take', 'chain'])
+
+# The for-loop body is inlined at each yield of an iterator function,
+# unless that would inline more than this number of nodes in total.
+MAX_INLINED_LOOP_BODY_NODES = 200
 
 
 def is_for_loop_func_call(node):
@@ -80,6 +100,48 @@ def is_for_loop_func_call(node):
     return node.iter.func.id in FOR_LOOP_FUNCS
 
 
+def is_iterator_call(node, context):
+    """Returns true if given node is a call to map(), filter(), take() or
+    chain(), or zip() with any of them as parameter.
+
+    """
+
+    if not isinstance(node, ast.Call):
+        return False
+
+    if not isinstance(node.func, ast.Name):
+        return False
+
+    if not context.is_builtin_call(node.func.id):
+        return False
+
+    if node.func.id in ITERATOR_FUNCS:
+        return True
+
+    if node.func.id == 'zip':
+        return any(is_iterator_call(arg, context) for arg in node.args)
+
+    return False
+
+
+def is_builtin_call(node, name):
+    if not isinstance(node, ast.Call):
+        return False
+
+    if not isinstance(node.func, ast.Name):
+        return False
+
+    return node.func.id == name
+
+
+def is_range_call(node):
+    return is_builtin_call(node, 'range')
+
+
+def is_zip_call(node):
+    return is_builtin_call(node, 'zip')
+
+
 def mys_type_to_target_cpp_type(mys_type):
     if is_primitive_type(mys_type):
         return 'auto'
@@ -294,6 +356,37 @@ class Zip:
         self.children = children
 
 
+class InlinedIterator:
+
+    def __init__(self, node, function, break_label):
+        self.node = node
+        self.function = function
+        self.item_mys_type = function.returns
+        self.break_label = break_label
+        self.break_used = False
+        # Name of the lambda called at each yield, or None if the loop
+        # body is inlined at each yield.
+        self.body_lambda = None
+        # Local variables of the function with the loop, hidden while
+        # the iterator function body is visited.
+        self.caller_scope = None
+
+
+class LoopBodyLambda:
+    """A for-loop body in a lambda called at each yield. It returns true
+    to break the loop.
+
+    """
+
+
+class InlinedLoopBody:
+
+    def __init__(self, iterator, continue_label):
+        self.iterator = iterator
+        self.continue_label = continue_label
+        self.continue_used = False
+
+
 class Data:
 
     def __init__(self, target, target_node, value, mys_type):
@@ -307,12 +400,16 @@ def is_ascii(value):
     return len(value) == len(value.encode('utf-8'))
 
 
+def make_c_string(value):
+    value = value.encode("unicode_escape").decode('utf-8')
+    value = value.replace('"', '\\"')
+
+    return f'"{value}"'
+
+
 def handle_string(value):
     if is_ascii(value):
-        value = value.encode("unicode_escape").decode('utf-8')
-        value = value.replace('"', '\\"')
-
-        return f'mys::String("{value}")'
+        return f'mys::String({make_c_string(value)})'
     else:
         values = []
 
@@ -324,6 +421,53 @@ def handle_string(value):
         return f'mys::String({{{value}}})'
 
 
+# Errors reported by Python's re module that PCRE2 reports as well. Other
+# errors are not reliable as the two regex dialects differ.
+REGEX_ERRORS = [
+    'missing ), unterminated subpattern',
+    'unbalanced parenthesis',
+    'unterminated character set',
+    'nothing to repeat'
+]
+
+REGEX_FLAGS = {
+    'i': re.IGNORECASE,
+    'm': re.MULTILINE,
+    's': re.DOTALL,
+    'x': re.VERBOSE
+}
+
+
+def raise_if_invalid_regex(pattern, flags, node):
+    # Python does not know PCRE2 verbs and start of pattern options,
+    # like (*UTF) and (*SKIP), so those patterns are checked when
+    # compiled at runtime instead.
+    if '(*' in pattern:
+        return
+
+    re_flags = 0
+
+    for flag in flags:
+        re_flags |= REGEX_FLAGS.get(flag, 0)
+
+    try:
+        with warnings.catch_warnings():
+            warnings.simplefilter('ignore')
+            re.compile(pattern, re_flags)
+    except re.error as e:
+        if e.msg in REGEX_ERRORS:
+            raise CompileError(f"invalid regex: {e.msg} at offset {e.pos}",
+                               node)
+
+
+def is_string_constant(node):
+    return isinstance(node, ast.Constant) and isinstance(node.value, str)
+
+
+def is_ascii_string_constant(node):
+    return is_string_constant(node) and is_ascii(node.value)
+
+
 def find_item_with_length(items):
     for item in items:
         if isinstance(item, (Slice, OpenSlice, Reversed)):
@@ -345,6 +489,10 @@ class BaseVisitor(ast.NodeVisitor):
         self.constants = []
         self.value_check_type_visitor = ValueCheckTypeVisitor(self)
         self.in_comprehension = False
+        # None for loops, InlinedLoopBody for for-loop bodies inlined
+        # into iterator functions.
+        self.loops = []
+        self.iterators = []
 
     def unique_number(self):
         return self.context.unique_number()
@@ -497,6 +645,10 @@ class BaseVisitor(ast.NodeVisitor):
 
         if nargs == 0:
             raise CompileError("expected at least one parameter", node)
+        elif nargs == 1 and self.is_lazy_iterable(node.args[0]):
+            iterator, self.context.mys_type = self.visit_iterator(node.args[0])
+
+            return f'mys::iter_{name}({iterator})'
         elif nargs == 1:
             values = [self.visit(node.args[0])]
 
@@ -520,6 +672,11 @@ class BaseVisitor(ast.NodeVisitor):
         if nargs != 1:
             raise CompileError("expected one parameter", node)
 
+        if self.is_lazy_iterable(node.args[0]):
+            iterator, self.context.mys_type = self.visit_iterator(node.args[0])
+
+            return f'mys::iter_sum({iterator})'
+
         values = self.visit(node.args[0])
         if not isinstance(self.context.mys_type, list):
             raise CompileError('expected a list', node.args[0])
@@ -528,6 +685,17 @@ class BaseVisitor(ast.NodeVisitor):
 
         return f'sum({values})'
 
+    def handle_any(self, node):
+        raise_if_wrong_number_of_parameters(len(node.args), 1, node)
+        iterator, item_mys_type = self.visit_iterator(node.args[0])
+
+        if item_mys_type != 'bool':
+            raise CompileError('expected bool items', node.args[0])
+
+        self.context.mys_type = 'bool'
+
+        return f'mys::iter_any({iterator})'
+
     def handle_len(self, node):
         raise_if_wrong_number_of_parameters(len(node.args), 1, node)
         value = self.visit(node.args[0])
@@ -617,11 +785,24 @@ class BaseVisitor(ast.NodeVisitor):
 
         self.context.mys_type = 'regex'
 
-        if value_type == 'string' and flags_type == 'string':
-            return f'Regex({value}, {flags})'
-        else:
+        if value_type != 'string' or flags_type != 'string':
             raise CompileError("not supported", node)
 
+        if (is_string_constant(node.args[0])
+            and is_string_constant(node.args[1])):
+            raise_if_invalid_regex(node.args[0].value, node.args[1].value, node)
+
+            return self.create_regex_constant(f'{value}, {flags}')
+
+        return f'Regex({value}, {flags})'
+
+    def handle_regexset(self, node):
+        raise_if_wrong_number_of_parameters(len(node.args), 1, node)
+        value = self.visit_check_type(node.args[0], ['regex'])
+        self.context.mys_type = 'regexset'
+
+        return make_shared('RegexSet', value)
+
     def handle_set(self, node):
         raise_if_wrong_number_of_parameters(len(node.args), 1, node)
         value = self.visit(node.args[0])
@@ -760,6 +941,11 @@ class BaseVisitor(ast.NodeVisitor):
     def visit_call_function(self, full_name, node):
         function = ValueTypeVisitor(self.context).find_called_function(full_name,
                                                                        node)
+
+        if function.is_iterator:
+            raise CompileError('iterator functions can only be used in for-loops',
+                               node)
+
         args = self.visit_call_params(full_name, function, node)
         self.context.mys_type = function.returns
 
@@ -797,6 +983,8 @@ class BaseVisitor(ast.NodeVisitor):
             code = self.handle_min_max(node, name)
         elif name == 'sum':
             code = self.handle_sum(node)
+        elif name == 'any':
+            code = self.handle_any(node)
         elif name == 'len':
             code = self.handle_len(node)
         elif name == 'str':
@@ -811,10 +999,17 @@ class BaseVisitor(ast.NodeVisitor):
             code = self.handle_char(node)
         elif name == 'regex':
             code = self.handle_regex(node)
+        elif name == 'regexset':
+            code = self.handle_regexset(node)
         elif name == 'set':
             code = self.handle_set(node)
         elif name in FOR_LOOP_FUNCS:
             raise CompileError('function can only be used in for-loops', node)
+        elif name in ITERATOR_FUNCS:
+            raise CompileError(
+                'function can only be used in for-loops, any(), min(), max() '
+                'and sum()',
+                node)
         elif name == 'input':
             code = self.handle_input(node)
         elif name == 'default':
@@ -874,6 +1069,41 @@ class BaseVisitor(ast.NodeVisitor):
             args.append('std::nullopt')
         raise_if_wrong_number_of_parameters(len(args), len(spec[0]), node)
 
+    def visit_call_method_deque(self, name, mys_type, args, node):
+        spec = DEQUE_METHODS.get(name)
+
+        if spec is None:
+            raise CompileError('deque method not implemented', node)
+
+        if spec[1] == '<dequetype>':
+            self.context.mys_type = mys_type.item_type
+        else:
+            self.context.mys_type = spec[1]
+
+        raise_if_wrong_number_of_parameters(len(args), len(spec[0]), node)
+
+    def visit_call_method_sorted(self, name, methods, mys_type, args, node):
+        """Sorted dict and sorted set methods. Arguments are type checked,
+        so integer literals get the key type.
+
+        """
+
+        spec = methods.get(name)
+
+        if spec is None:
+            if isinstance(mys_type, SortedDict):
+                raise CompileError('sorted dict method not implemented', node.func)
+            else:
+                raise CompileError('sorted set method not implemented', node.func)
+
+        raise_if_wrong_number_of_parameters(len(args), len(spec[0]), node.func)
+        param_mys_types, returns = sorted_method_types(spec, mys_type)
+
+        for i, (arg, param_mys_type) in enumerate(zip(node.args, param_mys_types)):
+            args[i] = self.visit_check_type(arg, param_mys_type)
+
+        self.context.mys_type = returns
+
     def visit_call_method_dict(self, name, mys_type, args, node):
         if name == 'keys':
             raise_if_wrong_number_of_parameters(len(args), 0, node)
@@ -971,6 +1201,15 @@ class BaseVisitor(ast.NodeVisitor):
 
         return '.'
 
+    def visit_call_method_regexset(self, name, args, node):
+        spec = REGEXSET_METHODS.get(name)
+
+        if spec is None:
+            raise CompileError('regex set method not implemented', node)
+
+        raise_if_wrong_number_of_parameters(len(args), len(spec[0]), node)
+        self.context.mys_type = spec[1]
+
     def visit_call_method_char(self, name, node):
         spec = CHAR_METHODS.get(name)
 
@@ -1038,7 +1277,25 @@ class BaseVisitor(ast.NodeVisitor):
 
         if isinstance(mys_type, list):
             self.visit_call_method_list(name, mys_type, args, node.func)
+        elif isinstance(mys_type, Deque):
+            self.visit_call_method_deque(name, mys_type, args, node.func)
+        elif isinstance(mys_type, SortedDict):
+            self.visit_call_method_sorted(name,
+                                          SORTED_DICT_METHODS,
+                                          mys_type,
+                                          args,
+                                          node)
+        elif isinstance(mys_type, SortedSet):
+            self.visit_call_method_sorted(name,
+                                          SORTED_SET_METHODS,
+                                          mys_type,
+                                          args,
+                                          node)
         elif isinstance(mys_type, dict):
+            if name in ['get', 'pop'] and args:
+                key_mys_type = split_dict_mys_type(mys_type)[0]
+                args[0] = self.visit_lookup_key(node.args[0], key_mys_type)
+
             self.visit_call_method_dict(name, mys_type, args, node.func)
         elif isinstance(mys_type, set):
             name = self.visit_call_method_set(name, args, node.func)
@@ -1048,6 +1305,8 @@ class BaseVisitor(ast.NodeVisitor):
             op = self.visit_call_method_regexmatch(name, node.func)
         elif mys_type == 'regex':
             op = self.visit_call_method_regex(name, node.func)
+        elif mys_type == 'regexset':
+            self.visit_call_method_regexset(name, args, node.func)
         elif mys_type == 'char':
             op = self.visit_call_method_char(name, node.func)
         elif mys_type == 'bytes':
@@ -1115,8 +1374,53 @@ class BaseVisitor(ast.NodeVisitor):
 
         return make_shared(dot2ns(specialized_full_name), args)
 
+    def visit_call_deque(self, node):
+        mys_type = TypeVisitor(self.context).visit(node.func)
+        cpp_type = self.mys_to_cpp_type(mys_type.item_type)
+        nargs = len(node.args)
+
+        if nargs == 0:
+            value = ''
+        elif nargs == 1:
+            value = self.visit_check_type(node.args[0], [mys_type.item_type])
+        else:
+            raise_if_wrong_number_of_parameters(nargs, 1, node)
+
+        self.context.mys_type = mys_type
+
+        return f'mys::make_shared<Deque<{cpp_type}>>({value})'
+
+    def visit_call_sorted(self, node):
+        mys_type = TypeVisitor(self.context).visit(node.func)
+        nargs = len(node.args)
+
+        if isinstance(mys_type, SortedDict):
+            key_cpp_type = self.mys_to_cpp_type(mys_type.key_type)
+            value_cpp_type = self.mys_to_cpp_type(mys_type.value_type)
+            cpp_type = f'SortedDict<{key_cpp_type}, {value_cpp_type}>'
+            arg_mys_type = {mys_type.key_type: mys_type.value_type}
+        else:
+            cpp_type = f'SortedSet<{self.mys_to_cpp_type(mys_type.item_type)}>'
+            arg_mys_type = [mys_type.item_type]
+
+        if nargs == 0:
+            value = ''
+        elif nargs == 1:
+            value = self.visit_check_type(node.args[0], arg_mys_type)
+        else:
+            raise_if_wrong_number_of_parameters(nargs, 1, node)
+
+        self.context.mys_type = mys_type
+
+        return f'mys::make_shared<{cpp_type}>({value})'
+
     def visit_call_generic(self, node):
-        if isinstance(node.func.value, ast.Name):
+        if is_builtin_generic_subscript(node.func):
+            if node.func.value.id == 'Deque':
+                return self.visit_call_deque(node)
+            else:
+                return self.visit_call_sorted(node)
+        elif isinstance(node.func.value, ast.Name):
             if self.context.is_class_defined(node.func.value.id):
                 return self.visit_call_generic_class(node)
             else:
@@ -1129,7 +1433,7 @@ class BaseVisitor(ast.NodeVisitor):
         if isinstance(node.func, ast.Name):
             name = node.func.id
 
-            if name in BUILTIN_CALLS:
+            if self.context.is_builtin_call(name):
                 return self.visit_call_builtin(name, node)
             else:
                 full_name = self.context.make_full_name(name)
@@ -1204,14 +1508,108 @@ class BaseVisitor(ast.NodeVisitor):
             return f'Bytes({{{values}}})'
         elif isinstance(node.value, tuple) and len(node.value) == 2:
             self.context.mys_type = 'regex'
+            raise_if_invalid_regex(*node.value, node)
             args = ', '.join([handle_string(s) for s in node.value])
-            return f'Regex({args})'
+
+            return self.create_regex_constant(args)
         else:
             raise InternalError(f"constant node {ast.dump(node)}", node)
 
     def visit_Expr(self, node):
+        if isinstance(node.value, ast.Yield):
+            return '\n'.join(self.visit_yield(node.value))
+
         return self.visit(node.value) + ';'
 
+    def visit_yield(self, node):
+        """Inlines the body of the for-loop iterating over current iterator
+        function.
+
+        """
+
+        if not self.iterators:
+            raise CompileError("'yield' outside iterator function", node)
+
+        if node.value is None:
+            raise CompileError("'yield' requires a value", node)
+
+        iterator = self.iterators[-1]
+
+        if iterator.body_lambda is not None:
+            value = self.visit_check_type(node.value, iterator.item_mys_type)
+            iterator.break_used = True
+
+            return [
+                f'if ({iterator.body_lambda}({value})) {{',
+                f'    goto {iterator.break_label};',
+                '}'
+            ]
+
+        self.iterators.pop()
+        code, targets = self.visit_yield_value(node.value,
+                                               iterator.node.target,
+                                               iterator.item_mys_type)
+        scope = self.context.swap_scope(iterator.caller_scope)
+        self.context.push()
+
+        for target, item, item_mys_type in targets:
+            code += self.visit_iterator_target(target, item, item_mys_type)
+
+        code = [indent(line) for line in code]
+        body = InlinedLoopBody(iterator, self.unique('continue'))
+        self.loops.append(body)
+        code += self.visit_body(iterator.node.body)
+        self.loops.pop()
+        self.context.pop()
+        self.context.swap_scope(scope)
+        self.iterators.append(iterator)
+        code = ['{'] + code + ['}']
+
+        if body.continue_used:
+            code.append(f'{body.continue_label}:;')
+
+        return code
+
+    def visit_yield_value(self, value, target, item_mys_type):
+        """Returns C++ code creating the items of given yielded value, and
+        the for-loop targets to assign them to. Yielded tuples are
+        unpacked directly into tuple targets, without creating a tuple
+        object.
+
+        """
+
+        if (isinstance(value, ast.Tuple)
+            and isinstance(target, ast.Tuple)
+            and isinstance(item_mys_type, tuple)
+            and len(value.elts) == len(target.elts) == len(item_mys_type)):
+            targets = []
+            code = []
+
+            for elt, target_elt, elt_mys_type in zip(value.elts,
+                                                     target.elts,
+                                                     item_mys_type):
+                item = self.unique('item')
+                item_cpp_type = self.mys_to_cpp_type(elt_mys_type)
+                code.append(f'{item_cpp_type} {item} = '
+                            f'{self.visit_check_type(elt, elt_mys_type)};')
+                targets.append((target_elt, item, elt_mys_type))
+        else:
+            item = self.unique('item')
+            item_cpp_type = self.mys_to_cpp_type(item_mys_type)
+            code = [
+                f'{item_cpp_type} {item} = '
+                f'{self.visit_check_type(value, item_mys_type)};'
+            ]
+            targets = [(target, item, item_mys_type)]
+
+        return code, targets
+
+    def visit_Yield(self, node):
+        if not self.iterators:
+            raise CompileError("'yield' outside iterator function", node)
+
+        raise CompileError("'yield' can only be used as a statement", node)
+
     def visit_binop_class(self, node, left_value_type):
         left = self.visit_check_type(node.left, left_value_type)
         op_method = OPERATORS_TO_METHOD[type(node.op)]
@@ -1332,7 +1730,7 @@ class BaseVisitor(ast.NodeVisitor):
         cpp_type = self.mys_to_cpp_type(self.context.mys_type)
         items = ', '.join(items)
 
-        return make_shared(cpp_type[6:], items)
+        return f'{cpp_type}({items})'
 
     def visit_List(self, node):
         items = []
@@ -1429,6 +1827,28 @@ class BaseVisitor(ast.NodeVisitor):
             '}'
         ]
 
+    def visit_for_deque(self, node, value, mys_type):
+        item_mys_type = mys_type.item_type
+        items = self.unique('items')
+        i = self.unique('i')
+        name = node.target.id
+
+        if not name.startswith('_'):
+            self.context.define_local_variable(name, item_mys_type, node.target)
+
+        body = indent('\n'.join([
+            self.visit(item)
+            for item in node.body
+        ]))
+
+        return [
+            f'auto {items} = {value};',
+            f'for (auto {i} = 0; {i} < {items}->__len__(); {i}++) {{',
+            f'    auto {make_name(name)} = {items}->get({i});',
+            body,
+            '}'
+        ]
+
     def visit_body(self, node):
         body = []
 
@@ -1440,8 +1860,13 @@ class BaseVisitor(ast.NodeVisitor):
 
         return body
 
-    def visit_for_dict(self, node, dvalue, mys_type):
-        key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
+    def visit_for_dict(self,
+                       node,
+                       dvalue,
+                       key_mys_type,
+                       value_mys_type,
+                       view='items_view()',
+                       is_sorted=False):
         items = self.unique('items')
         i = self.unique('i')
 
@@ -1463,6 +1888,161 @@ class BaseVisitor(ast.NodeVisitor):
         if not value_name.startswith('_'):
             self.context.define_local_variable(value_name, value_mys_type, value)
 
+        if self.is_read_only_loop_body(node.body):
+            iterable = f'{items}->{view}'
+        elif is_sorted:
+            iterable = self.make_sorted_snapshot(items, view)
+        else:
+            iterable = f'{items}->walk_items()'
+
+        key_ref = self.dict_item_reference(node, key_name)
+        value_ref = self.dict_item_reference(node, value_name)
+
+        body = indent('\n'.join([
+            self.visit(item)
+            for item in node.body
+        ]))
+
+        return [
+            f'auto {items} = {dvalue};',
+            f'for (auto& {i} : {iterable}) {{',
+            f'    auto{key_ref} {make_name(key_name)} = {i}.first;',
+            f'    auto{value_ref} {make_name(value_name)} = {i}.second;',
+            body,
+            '}'
+        ]
+
+    def make_sorted_snapshot(self, items, view):
+        """Returns a copy of given view of given sorted container, for
+        loops that may change it. A B-tree has no stable positions to
+        walk by, as inserts split its leaves.
+
+        """
+
+        if view == 'items_view()':
+            return f'mys::snapshot({items}->{view}, {items}->__len__())'
+        else:
+            return f'mys::snapshot({items}->{view})'
+
+    def dict_item_reference(self, node, name):
+        """Returns '&' if given loop variable can refer to the dict entry
+        instead of being a copy of it. That is, if the loop body does not
+        assign to it.
+
+        """
+
+        if is_name_assigned(node.body, name):
+            return ''
+
+        return '&'
+
+    def is_read_only_loop_body(self, nodes):
+        """Returns True if given loop body provably neither changes any
+        container nor runs any user code, that in turn could change
+        it. Only such loops may iterate containers by reference, as
+        changing a container invalidates references to its entries.
+
+        Calls, yields, deletes and subscript assignments are never read
+        only. Operators and lookups are only read only if their operands
+        are primitive values or strings, as they could otherwise call
+        user defined methods.
+
+        """
+
+        for node in nodes:
+            for item in ast.walk(node):
+                if isinstance(item, (ast.Call,
+                                     ast.Yield,
+                                     ast.YieldFrom,
+                                     ast.Delete,
+                                     ast.FormattedValue)):
+                    return False
+                elif isinstance(item, ast.Subscript):
+                    if not isinstance(item.ctx, ast.Load):
+                        return False
+
+                    if not self.is_primitive_value(item):
+                        return False
+
+                    if isinstance(item.slice, ast.Slice):
+                        return False
+
+                    if not self.is_primitive_value(item.slice):
+                        return False
+                elif isinstance(item, ast.BinOp):
+                    if not self.is_primitive_value(item.left):
+                        return False
+
+                    if not self.is_primitive_value(item.right):
+                        return False
+                elif isinstance(item, ast.AugAssign):
+                    if not self.is_primitive_value(item.target):
+                        return False
+
+                    if not self.is_primitive_value(item.value):
+                        return False
+                elif isinstance(item, ast.Compare):
+                    if isinstance(item.ops[0], (ast.Is, ast.IsNot)):
+                        continue
+
+                    if not self.is_primitive_value(item.left):
+                        return False
+
+                    if not self.is_primitive_value(item.comparators[0]):
+                        return False
+
+        return True
+
+    def is_primitive_value(self, node):
+        """Returns True if given expression is known to be a primitive value
+        or a string. Expressions using variables defined in the loop body
+        are not known.
+
+        """
+
+        try:
+            value_type = ValueTypeVisitor(self.context).visit(node)
+        except CompileError:
+            return False
+
+        if isinstance(value_type, list) and len(value_type) > 1:
+            value_type = value_type[0]
+
+        return value_type == 'string' or is_primitive_type(value_type)
+
+    def visit_for_dict_view(self, node, dvalue, mys_type):
+        """Iterate over ``d.keys()`` or ``d.values()`` without creating a
+        list, if the loop body is read only. Otherwise iterate over a list
+        of the keys or values, so the body may change the dict.
+
+        """
+
+        key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
+        view = node.iter.func.attr
+
+        if view == 'keys':
+            item_mys_type = key_mys_type
+        else:
+            item_mys_type = value_mys_type
+
+        items = self.unique('items')
+        name = node.target.id
+
+        if not name.startswith('_'):
+            self.context.define_local_variable(name, item_mys_type, node.target)
+
+        if not self.is_read_only_loop_body(node.body):
+            iterable = f'{items}->m_list'
+            dvalue = f'{dvalue}->{view}()'
+            target = f'auto& {make_name(name)}'
+        else:
+            iterable = f'{items}->{view}_view()'
+
+            if is_name_assigned(node.body, name):
+                target = f'auto {make_name(name)}'
+            else:
+                target = f'auto& {make_name(name)}'
+
         body = indent('\n'.join([
             self.visit(item)
             for item in node.body
@@ -1470,9 +2050,165 @@ class BaseVisitor(ast.NodeVisitor):
 
         return [
             f'auto {items} = {dvalue};',
-            f'for (auto {i} : {items}->m_map) {{',
-            f'    auto {make_name(key_name)} = {i}.first;',
-            f'    auto {make_name(value_name)} = {i}.second;',
+            f'for ({target} : {iterable}) {{',
+            body,
+            '}'
+        ]
+
+    def is_dict_view_call(self, node):
+        """Returns true if given for loop iterates over ``d.keys()`` or
+        ``d.values()``, where ``d`` is a dict.
+
+        """
+
+        if not isinstance(node.target, ast.Name):
+            return False
+
+        call = node.iter
+
+        if not isinstance(call, ast.Call):
+            return False
+
+        if not isinstance(call.func, ast.Attribute):
+            return False
+
+        if call.func.attr not in ['keys', 'values'] or call.args:
+            return False
+
+        self.visit(call.func.value)
+
+        return isinstance(self.context.mys_type, dict)
+
+    def visit_for_sorted_set(self, node, value, item_mys_type, view='items_view()'):
+        items = self.unique('items')
+        name = node.target.id
+
+        if not name.startswith('_'):
+            self.context.define_local_variable(name, item_mys_type, node.target)
+
+        if self.is_read_only_loop_body(node.body):
+            iterable = f'{items}->{view}'
+        else:
+            iterable = self.make_sorted_snapshot(items, view)
+
+        if is_name_assigned(node.body, name):
+            target = f'auto {make_name(name)}'
+        else:
+            target = f'const auto& {make_name(name)}'
+
+        body = indent('\n'.join([
+            self.visit(item)
+            for item in node.body
+        ]))
+
+        return [
+            f'auto {items} = {value};',
+            f'for ({target} : {iterable}) {{',
+            body,
+            '}'
+        ]
+
+    def is_sorted_range_call(self, node):
+        """Returns true if given for loop iterates over ``items.range(lower,
+        upper)``, where ``items`` is a sorted dict or a sorted set.
+
+        """
+
+        call = node.iter
+
+        if not isinstance(call, ast.Call):
+            return False
+
+        if not isinstance(call.func, ast.Attribute):
+            return False
+
+        if call.func.attr != 'range':
+            return False
+
+        self.visit(call.func.value)
+
+        return isinstance(self.context.mys_type, (SortedDict, SortedSet))
+
+    def visit_for_sorted_range(self, node):
+        call = node.iter
+        value = self.visit(call.func.value)
+        mys_type = self.context.mys_type
+        raise_if_wrong_number_of_parameters(len(call.args), 2, call)
+
+        if isinstance(mys_type, SortedDict):
+            key_mys_type = mys_type.key_type
+        else:
+            key_mys_type = mys_type.item_type
+
+        lower = self.visit_check_type(call.args[0], key_mys_type)
+        upper = self.visit_check_type(call.args[1], key_mys_type)
+        view = f'range({lower}, {upper})'
+
+        if isinstance(mys_type, SortedDict):
+            return self.visit_for_dict(node,
+                                       value,
+                                       mys_type.key_type,
+                                       mys_type.value_type,
+                                       view,
+                                       is_sorted=True)
+        else:
+            return self.visit_for_sorted_set(node, value, key_mys_type, view)
+
+    def is_regex_find_iter_call(self, node):
+        """Returns true if given for loop iterates over
+        ``regex.find_iter(string)``.
+
+        """
+
+        call = node.iter
+
+        if not isinstance(call, ast.Call):
+            return False
+
+        if not isinstance(call.func, ast.Attribute):
+            return False
+
+        if call.func.attr != 'find_iter':
+            return False
+
+        self.visit(call.func.value)
+
+        return self.context.mys_type == 'regex'
+
+    def visit_for_regex_find_iter(self, node):
+        """Matches are found one at a time as the loop runs.
+
+        """
+
+        call = node.iter
+        value = self.visit(call.func.value)
+        raise_if_wrong_number_of_parameters(len(call.args), 1, call)
+        string = self.visit_check_type(call.args[0], 'string')
+
+        if not isinstance(node.target, ast.Name):
+            raise CompileError('unsupported type', node.target)
+
+        matches = self.unique('matches')
+        name = node.target.id
+
+        if not name.startswith('_'):
+            self.context.define_local_variable(name, 'regexmatch', node.target)
+        else:
+            name = self.unique('match')
+
+        body = indent('\n'.join([
+            self.visit(item)
+            for item in node.body
+        ]))
+
+        return [
+            f'auto {matches} = mys::regex_not_none({value}).find_iter('
+            f'mys::string_not_none({string}));',
+            'while (true) {',
+            f'    RegexMatch {name} = {matches}.next();',
+            f'    if (!{name}.m_match_data) {{',
+            '        break;',
+            '    }',
             body,
             '}'
         ]
@@ -1627,6 +2363,8 @@ class BaseVisitor(ast.NodeVisitor):
             mys_type = 'char'
         elif isinstance(self.context.mys_type, list):
             mys_type = self.context.mys_type[0]
+        elif isinstance(self.context.mys_type, Deque):
+            mys_type = self.context.mys_type.item_type
         else:
             mys_type = format_mys_type(self.context.mys_type)
 
@@ -1813,13 +2551,452 @@ class BaseVisitor(ast.NodeVisitor):
 
         return code
 
+    def is_fusable_comprehension(self, node):
+        """Returns true if given list comprehension or generator expression
+        can be evaluated one item at a time.
+
+        """
+
+        if not isinstance(node, (ast.ListComp, ast.GeneratorExp)):
+            return False
+
+        if len(node.generators) != 1:
+            return False
+
+        iter_node = node.generators[0].iter
+
+        if is_iterator_call(iter_node, self.context) or is_range_call(iter_node):
+            return True
+
+        # Zipped lists of different lengths are an error in list
+        # comprehensions, but generator expressions are always lazy.
+        if isinstance(node, ast.GeneratorExp) and is_zip_call(iter_node):
+            return True
+
+        if (isinstance(iter_node, ast.Call)
+            and isinstance(iter_node.func, ast.Name)
+            and iter_node.func.id in FOR_LOOP_FUNCS):
+            return False
+
+        mys_type = ValueTypeVisitor(self.context).visit(iter_node)
+
+        return isinstance(mys_type, list) or mys_type == 'string'
+
+    def is_lazy_iterable(self, node):
+        """Returns true if given node given to any(), min(), max() or sum()
+        is iterated over using a lazy iterator instead of a list.
+
+        """
+
+        if is_iterator_call(node, self.context) or is_range_call(node):
+            return True
+
+        return self.is_fusable_comprehension(node)
+
+    def visit_iterator_target(self, target, item, item_mys_type):
+        """Defines given for-loop target variables and returns C++ code
+        assigning them from given item.
+
+        """
+
+        target_type = mys_type_to_target_cpp_type(item_mys_type)
+        code = []
+
+        if isinstance(target, ast.Tuple):
+            if (not isinstance(item_mys_type, tuple)
+                or len(item_mys_type) != len(target.elts)):
+                raise CompileError('cannot unpack item', target)
+
+            for i, elt in enumerate(target.elts):
+                name = elt.id
+
+                if not name.startswith('_'):
+                    self.context.define_local_variable(name, item_mys_type[i], elt)
+                    code.append(f'{target_type} {make_name(name)} = '
+                                f'std::get<{i}>({item}->m_tuple);')
+        else:
+            name = target.id
+
+            if not name.startswith('_'):
+                self.context.define_local_variable(name, item_mys_type, target)
+                code.append(f'{target_type} {make_name(name)} = {item};')
+
+        return code
+
+    def visit_iterator_lambda(self, target, value, item_mys_type):
+        """Returns a C++ lambda that assigns an item to given target and
+        returns given value, and the type of the value.
+
+        """
+
+        item = self.unique('item')
+        item_cpp_type = self.mys_to_cpp_type(item_mys_type)
+        self.context.push()
+        code = self.visit_iterator_target(target, item, item_mys_type)
+        code.append(f'return {self.visit(value)};')
+        mys_type = self.context.mys_type
+        self.context.pop()
+        code = ' '.join(code)
+
+        return f'[&](const {item_cpp_type}& {item}) {{ {code} }}', mys_type
+
+    def visit_iterator_comprehension(self, node):
+        generator = node.generators[0]
+
+        if len(generator.ifs) > 1:
+            raise CompileError("at most one if allowed", node)
+
+        iterator, item_mys_type = self.visit_iterator(generator.iter)
+
+        if generator.ifs:
+            function, mys_type = self.visit_iterator_lambda(generator.target,
+                                                            generator.ifs[0],
+                                                            item_mys_type)
+            raise_if_not_bool(mys_type, generator.ifs[0], self.context)
+            iterator = f'mys::FilterIter({iterator}, {function})'
+
+        function, mys_type = self.visit_iterator_lambda(generator.target,
+                                                        node.elt,
+                                                        item_mys_type)
+
+        return f'mys::MapIter({iterator}, {function})', mys_type
+
+    def visit_iterator_function(self, node, item_mys_type):
+        """Returns a C++ lambda calling function with given name with one
+        item, and its return type.
+
+        """
+
+        if not isinstance(node, ast.Name):
+            raise CompileError('expected a function name', node)
+
+        item = self.unique('item')
+        self.context.push()
+        self.context.define_local_variable(item, item_mys_type, node)
+        call = self.visit(ast.Call(func=node,
+                                   args=[ast.Name(id=item,
+                                                  lineno=node.lineno,
+                                                  col_offset=node.col_offset)],
+                                   keywords=[],
+                                   lineno=node.lineno,
+                                   col_offset=node.col_offset))
+        mys_type = self.context.mys_type
+        self.context.pop()
+
+        if mys_type is None:
+            raise CompileError('function does not return a value', node)
+
+        item_cpp_type = self.mys_to_cpp_type(item_mys_type)
+
+        return f'[&](const {item_cpp_type}& {item}) {{ return {call}; }}', mys_type
+
+    def visit_iterator_map(self, node):
+        raise_if_wrong_number_of_parameters(len(node.args), 2, node)
+        iterator, item_mys_type = self.visit_iterator(node.args[1])
+        function, mys_type = self.visit_iterator_function(node.args[0],
+                                                          item_mys_type)
+
+        return f'mys::MapIter({iterator}, {function})', mys_type
+
+    def visit_iterator_filter(self, node):
+        raise_if_wrong_number_of_parameters(len(node.args), 2, node)
+        iterator, item_mys_type = self.visit_iterator(node.args[1])
+        function, mys_type = self.visit_iterator_function(node.args[0],
+                                                          item_mys_type)
+
+        if mys_type != 'bool':
+            raise CompileError('filter function must return a bool',
+                               node.args[0])
+
+        return f'mys::FilterIter({iterator}, {function})', item_mys_type
+
+    def visit_iterator_take(self, node):
+        raise_if_wrong_number_of_parameters(len(node.args), 2, node)
+        iterator, item_mys_type = self.visit_iterator(node.args[0])
+        count, _ = self.visit_iter_parameter(node.args[1], 'i64')
+
+        return f'mys::TakeIter({iterator}, {count})', item_mys_type
+
+    def visit_iterator_chain(self, node):
+        if len(node.args) < 2:
+            raise CompileError('expected at least 2 parameters', node)
+
+        iterator, item_mys_type = self.visit_iterator(node.args[0])
+
+        for arg in node.args[1:]:
+            iterator_2, item_mys_type_2 = self.visit_iterator(arg)
+            raise_if_wrong_types(item_mys_type_2, item_mys_type, arg, self.context)
+            iterator = f'mys::ChainIter({iterator}, {iterator_2})'
+
+        return iterator, item_mys_type
+
+    def visit_iterator_zip(self, node):
+        if len(node.args) < 2:
+            raise CompileError('expected at least 2 parameters', node)
+
+        iterators = []
+        item_mys_types = []
+
+        for arg in node.args:
+            iterator, item_mys_type = self.visit_iterator(arg)
+            iterators.append(iterator)
+            item_mys_types.append(item_mys_type)
+
+        iterators = ', '.join(iterators)
+
+        return f'mys::ZipIter({iterators})', tuple(item_mys_types)
+
+    def visit_iterator_range(self, node):
+        nargs = len(node.args)
+
+        if nargs == 1:
+            begin = 0
+            end, mys_type = self.visit_iter_parameter(node.args[0], 'i64')
+            step = 1
+        elif nargs == 2:
+            begin, mys_type = self.visit_iter_parameter(node.args[0], 'i64')
+            end, _ = self.visit_iter_parameter(node.args[1], mys_type)
+            step = 1
+        elif nargs == 3:
+            begin, mys_type = self.visit_iter_parameter(node.args[0], 'i64')
+            end, _ = self.visit_iter_parameter(node.args[1], mys_type)
+            step, _ = self.visit_iter_parameter(node.args[2], mys_type)
+        else:
+            raise CompileError(f"expected 1 to 3 parameters, got {nargs}", node)
+
+        cpp_type = self.mys_to_cpp_type(mys_type)
+
+        return f'mys::RangeIter<{cpp_type}>({begin}, {end}, {step})', mys_type
+
+    def visit_iterator(self, node):
+        """Returns C++ code creating a lazy iterator over given node, and the
+        type of its items.
+
+        """
+
+        if isinstance(node, ast.Call) and isinstance(node.func, ast.Name):
+            name = node.func.id
+
+            if name == 'map':
+                return self.visit_iterator_map(node)
+            elif name == 'filter':
+                return self.visit_iterator_filter(node)
+            elif name == 'take':
+                return self.visit_iterator_take(node)
+            elif name == 'chain':
+                return self.visit_iterator_chain(node)
+            elif name == 'zip':
+                return self.visit_iterator_zip(node)
+            elif name == 'range':
+                return self.visit_iterator_range(node)
+        elif self.is_fusable_comprehension(node):
+            return self.visit_iterator_comprehension(node)
+
+        value = self.visit(node)
+        mys_type = self.context.mys_type
+
+        if isinstance(mys_type, list):
+            return f'mys::ListIter({value})', mys_type[0]
+        elif mys_type == 'string':
+            return f'mys::StringIter({value})', 'char'
+        else:
+            mys_type = format_mys_type(mys_type)
+
+            raise CompileError(f'iteration over {mys_type} not supported', node)
+
+    def visit_for_iterator(self, node):
+        iterator, item_mys_type = self.visit_iterator(node.iter)
+        iterator_name = self.unique('iterator')
+        item = self.unique('item')
+        item_cpp_type = self.mys_to_cpp_type(item_mys_type)
+        code = [
+            f'auto {iterator_name} = {iterator};',
+            f'{item_cpp_type} {item};',
+            f'while ({iterator_name}.next({item})) {{'
+        ]
+        code += [
+            indent(line)
+            for line in self.visit_iterator_target(node.target,
+                                                   item,
+                                                   item_mys_type)
+        ]
+        code += self.visit_body(node.body)
+        code.append('}')
+
+        return code
+
+    def find_iterator_function(self, node):
+        """Returns the iterator function called by given node, or None if
+        it is not an iterator function call.
+
+        """
+
+        if not isinstance(node, ast.Call) or not isinstance(node.func, ast.Name):
+            return None
+
+        name = node.func.id
+
+        if self.context.is_builtin_call(name):
+            return None
+
+        full_name = self.context.make_full_name(name)
+
+        if full_name is None or not self.context.is_function_defined(full_name):
+            return None
+
+        function = ValueTypeVisitor(self.context).find_called_function(full_name,
+                                                                       node)
+
+        if not function.is_iterator:
+            return None
+
+        if full_name != self.context.make_full_name_this_module(name):
+            raise CompileError(
+                'iterator functions can only be used in the module they are '
+                'defined in',
+                node)
+
+        return function
+
+    def visit_iterator_function_params(self, function, node):
+        keyword_args = self.visit_call_params_keywords(function, node)
+        values = []
+
+        for i, (param, default) in enumerate(function.args):
+            if i < len(node.args):
+                value = node.args[i]
+            else:
+                value = keyword_args.get(param.name, default)
+
+                if value is None:
+                    param_type = format_mys_type(param.type)
+
+                    raise CompileError(
+                        f"parameter '{param.name}: {param_type}' not given",
+                        node)
+
+            values.append(self.visit_check_type(value, param.type))
+
+        min_args = len([default for _, default in function.args if default is None])
+        raise_if_wrong_number_of_parameters(len(node.args) + len(node.keywords),
+                                            len(function.args),
+                                            node.func,
+                                            min_args)
+
+        return values
+
+    def visit_for_iterator_function(self, node, function):
+        """Inlines given iterator function into the for-loop. The loop body
+        is inlined at each yield, so no iterator object is created.
+
+        """
+
+        if any(iterator.function is function for iterator in self.iterators):
+            raise CompileError('recursive iterator functions are not supported',
+                               node.iter)
+
+        values = self.visit_iterator_function_params(function, node.iter)
+        body, names = rename_locals(
+            function.node,
+            lambda name: f'{name}__{self.unique_number()}')
+
+        if has_docstring(function.node):
+            body = body[1:]
+
+        iterator = InlinedIterator(node, function, self.unique('break'))
+
+        if self.is_loop_body_lambda_needed(node, body):
+            iterator.body_lambda = self.unique('body')
+            code = self.visit_loop_body_lambda(iterator)
+        else:
+            code = []
+
+        # The iterator function body only sees its own local variables.
+        iterator.caller_scope = self.context.swap_scope(Scope())
+
+        for (param, _), value in zip(function.args, values):
+            name = names.get(param.name, param.name)
+            self.context.define_local_variable(name, param.type, node.iter)
+            cpp_type = self.mys_to_cpp_type(param.type)
+            code.append(indent(f'{cpp_type} {make_name(name)} = {value};'))
+
+        self.iterators.append(iterator)
+        code += self.visit_body(body)
+        self.iterators.pop()
+        self.context.swap_scope(iterator.caller_scope)
+        code = ['{'] + code + ['}']
+
+        if iterator.break_used:
+            code.append(f'{iterator.break_label}:;')
+
+        return code
+
+    def is_loop_body_lambda_needed(self, node, body):
+        """Returns true if given for-loop body should be put in a lambda
+        instead of being inlined at each yield of given iterator function
+        body. Bodies returning or yielding are always inlined.
+
+        """
+
+        yields = 0
+
+        for item in body:
+            for child in ast.walk(item):
+                if isinstance(child, ast.Yield):
+                    yields += 1
+
+        if yields < 2:
+            return False
+
+        nodes = 0
+
+        for item in node.body:
+            for child in ast.walk(item):
+                if isinstance(child, (ast.Return, ast.Yield)):
+                    return False
+
+                nodes += 1
+
+        return yields * nodes > MAX_INLINED_LOOP_BODY_NODES
+
+    def visit_loop_body_lambda(self, iterator):
+        item = self.unique('item')
+        item_cpp_type = self.mys_to_cpp_type(iterator.item_mys_type)
+        self.context.push()
+        code = self.visit_iterator_target(iterator.node.target,
+                                          item,
+                                          iterator.item_mys_type)
+        code = indent_lines(code)
+        self.loops.append(LoopBodyLambda())
+        code += self.visit_body(iterator.node.body)
+        self.loops.pop()
+        self.context.pop()
+
+        code = [
+            f'auto {iterator.body_lambda} = '
+            f'[&](const {item_cpp_type}& {item}) -> bool {{'
+        ] + code + [
+            '    return false;',
+            '};'
+        ]
+
+        return indent_lines(code)
+
     def visit_For(self, node):
         if node.orelse:
             raise CompileError('for else clause not supported', node)
 
         self.context.push()
-
-        if is_for_loop_func_call(node):
+        self.loops.append(None)
+        function = self.find_iterator_function(node.iter)
+
+        if function is not None:
+            code = self.visit_for_iterator_function(node, function)
+        elif (is_iterator_call(node.iter, self.context)
+            or (isinstance(node.iter, ast.GeneratorExp)
+                and self.is_fusable_comprehension(node.iter))):
+            code = self.visit_for_iterator(node)
+        elif is_for_loop_func_call(node):
             target = UnpackVisitor().visit(node.target)
             items = []
             self.visit_for_call(items, target, node.iter)
@@ -1833,14 +3010,35 @@ class BaseVisitor(ast.NodeVisitor):
             code += self.visit_for_items_body(items)
             code += self.visit_body(node.body)
             code.append('}')
+        elif self.is_sorted_range_call(node):
+            code = self.visit_for_sorted_range(node)
+        elif self.is_regex_find_iter_call(node):
+            code = self.visit_for_regex_find_iter(node)
+        elif self.is_dict_view_call(node):
+            value = self.visit(node.iter.func.value)
+            code = self.visit_for_dict_view(node, value, self.context.mys_type)
         else:
             value = self.visit(node.iter)
             mys_type = self.context.mys_type
 
             if isinstance(mys_type, list):
                 code = self.visit_for_list(node, value, mys_type)
+            elif isinstance(mys_type, Deque):
+                code = self.visit_for_deque(node, value, mys_type)
             elif isinstance(mys_type, dict):
-                code = self.visit_for_dict(node, value, mys_type)
+                key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
+                code = self.visit_for_dict(node,
+                                           value,
+                                           key_mys_type,
+                                           value_mys_type)
+            elif isinstance(mys_type, SortedDict):
+                code = self.visit_for_dict(node,
+                                           value,
+                                           mys_type.key_type,
+                                           mys_type.value_type,
+                                           is_sorted=True)
+            elif isinstance(mys_type, SortedSet):
+                code = self.visit_for_sorted_set(node, value, mys_type.item_type)
             elif isinstance(mys_type, tuple):
                 raise CompileError('iteration over tuples not allowed',
                                    node.iter)
@@ -1850,6 +3048,7 @@ class BaseVisitor(ast.NodeVisitor):
                 raise CompileError(f'iteration over {mys_type} not supported',
                                    node.iter)
 
+        self.loops.pop()
         self.context.pop()
 
         return '\n'.join(code)
@@ -1929,6 +3128,35 @@ class BaseVisitor(ast.NodeVisitor):
 
         return variable
 
+    def create_regex_constant(self, args):
+        """Regexes are compiled once per thread, when first used. Copies
+        of a regex change reference counts that are not atomic in
+        single-core applications, so threads in the fiber thread pool
+        must not share them.
+
+        """
+
+        value = f'Regex({args})'
+        constant = self.context.constants.get(value)
+
+        if constant is None:
+            variable = self.unique('constant')
+            self.context.constants[value] = (
+                f'{variable}()',
+                '\n'.join([
+                    f'static const Regex& {variable}()',
+                    '{',
+                    f'    thread_local const Regex regex({args});',
+                    '',
+                    '    return regex;',
+                    '}'
+                ]))
+            variable = f'{variable}()'
+        else:
+            variable = constant[0]
+
+        return variable
+
     def visit_compare(self, node):
         if len(node.comparators) != 1:
             raise CompileError("can only compare two values", node)
@@ -1952,6 +3180,25 @@ class BaseVisitor(ast.NodeVisitor):
                     right_value_type[0],
                     node)
                 right_value_type = [right_value_type]
+            elif isinstance(right_value_type, Deque):
+                left_value_type, right_value_type = intersection_of(
+                    left_value_type,
+                    right_value_type.item_type,
+                    node)
+                right_value_type = Deque(right_value_type)
+            elif isinstance(right_value_type, SortedDict):
+                left_value_type, right_key_value_type = intersection_of(
+                    left_value_type,
+                    right_value_type.key_type,
+                    node)
+                right_value_type = SortedDict(right_key_value_type,
+                                              right_value_type.value_type)
+            elif isinstance(right_value_type, SortedSet):
+                left_value_type, right_value_type = intersection_of(
+                    left_value_type,
+                    right_value_type.item_type,
+                    node)
+                right_value_type = SortedSet(right_value_type)
             elif right_value_type == 'string':
                 pass
             else:
@@ -1961,6 +3208,9 @@ class BaseVisitor(ast.NodeVisitor):
                 if left_value_type is None or right_value_type is None:
                     raise CompileError("use 'is' and 'is not' to compare to None",
                                        node)
+            elif (isinstance(left_value_type, tuple)
+                  and isinstance(right_value_type, tuple)):
+                self.context.use_shared_tuples(node)
 
             left_value_type, right_value_type = intersection_of(
                     left_value_type,
@@ -1995,6 +3245,10 @@ class BaseVisitor(ast.NodeVisitor):
         left_mys_type, left = items[0]
         right_mys_type, right = items[1]
         op_class = ops[0]
+
+        if op_class in [ast.In, ast.NotIn] and isinstance(right_mys_type, (dict, set)):
+            left = self.visit_lookup_key(node.left, left_mys_type)
+
         self.context.mys_type = 'bool'
 
         if op_class == ast.In:
@@ -2339,6 +3593,12 @@ class BaseVisitor(ast.NodeVisitor):
             key = self.visit_check_type(target.slice, key_mys_type)
             value = self.visit_check_type(node.value, value_mys_type)
 
+            return f'{base}->__setitem__({key}, {value});'
+        elif isinstance(self.context.mys_type, SortedDict):
+            mys_type = self.context.mys_type
+            key = self.visit_check_type(target.slice, mys_type.key_type)
+            value = self.visit_check_type(node.value, mys_type.value_type)
+
             return f'{base}->__setitem__({key}, {value});'
         elif self.context.mys_type == 'string':
             raise CompileError('string item assignment not allowed', node)
@@ -2382,23 +3642,69 @@ class BaseVisitor(ast.NodeVisitor):
         if not (0 <= index < len(mys_type)):
             raise CompileError("tuple index out of range", node.slice)
 
+        if not isinstance(node.ctx, ast.Load):
+            self.context.use_shared_tuples(node)
+
         self.context.mys_type = mys_type[index]
 
         return f'std::get<{index}>({value}->m_tuple)'
 
+    def visit_lookup_key(self, node, key_mys_type):
+        """Returns given dict or set lookup key. ASCII string constants and
+        string slices are passed as views, so no string is created.
+
+        """
+
+        if key_mys_type == 'string':
+            if is_ascii_string_constant(node):
+                self.context.mys_type = 'string'
+
+                return f'mys::StringLiteral({make_c_string(node.value)})'
+            elif (isinstance(node, ast.Subscript)
+                  and isinstance(node.slice, ast.Slice)
+                  and node.slice.step is None):
+                value = self.visit(node.value)
+
+                if self.context.mys_type == 'string':
+                    lower, upper, _ = self.visit(node.slice)
+                    lower = lower or 'std::nullopt'
+                    upper = upper or 'std::nullopt'
+                    self.context.mys_type = 'string'
+
+                    return f'{value}.view({lower}, {upper})'
+
+        return self.visit_check_type(node, key_mys_type)
+
     def visit_subscript_dict(self, node, value, mys_type):
         key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
-        key = self.visit_check_type(node.slice, key_mys_type)
+
+        if isinstance(node.ctx, ast.Load):
+            key = self.visit_lookup_key(node.slice, key_mys_type)
+        else:
+            key = self.visit_check_type(node.slice, key_mys_type)
+
         self.context.mys_type = value_mys_type
 
         return f'({value})->get({key})'
 
+    def visit_subscript_sorted_dict(self, node, value, mys_type):
+        key = self.visit_check_type(node.slice, mys_type.key_type)
+        self.context.mys_type = mys_type.value_type
+
+        return f'({value})->get({key})'
+
     def visit_subscript_list(self, node, value, mys_type):
         index = self.visit(node.slice)
         self.context.mys_type = mys_type[0]
 
         return f'{value}->get({index})'
 
+    def visit_subscript_deque(self, node, value, mys_type):
+        index = self.visit_check_type(node.slice, 'i64')
+        self.context.mys_type = mys_type.item_type
+
+        return f'{value}->get({index})'
+
     def visit_subscript_string(self, node, value):
         index = self.visit(node.slice)
         self.context.mys_type = 'char'
@@ -2427,6 +3733,10 @@ class BaseVisitor(ast.NodeVisitor):
             return self.visit_subscript_dict(node, value, mys_type)
         elif isinstance(mys_type, list):
             return self.visit_subscript_list(node, value, mys_type)
+        elif isinstance(mys_type, Deque):
+            return self.visit_subscript_deque(node, value, mys_type)
+        elif isinstance(mys_type, SortedDict):
+            return self.visit_subscript_sorted_dict(node, value, mys_type)
         elif mys_type == 'string':
             return self.visit_subscript_string(node, value)
         elif mys_type == 'bytes':
@@ -2467,7 +3777,9 @@ class BaseVisitor(ast.NodeVisitor):
         condition = self.visit(node.test)
         raise_if_not_bool(self.context.mys_type, node.test, self.context)
         self.context.push()
+        self.loops.append(None)
         body = '\n'.join(self.visit_body(node.body))
+        self.loops.pop()
         self.context.pop()
 
         return '\n'.join([
@@ -2480,9 +3792,25 @@ class BaseVisitor(ast.NodeVisitor):
         return ''
 
     def visit_Break(self, _node):
+        if self.loops and isinstance(self.loops[-1], LoopBodyLambda):
+            return 'return true;'
+        elif self.loops and self.loops[-1] is not None:
+            iterator = self.loops[-1].iterator
+            iterator.break_used = True
+
+            return f'goto {iterator.break_label};'
+
         return 'break;'
 
     def visit_Continue(self, _node):
+        if self.loops and isinstance(self.loops[-1], LoopBodyLambda):
+            return 'return false;'
+        elif self.loops and self.loops[-1] is not None:
+            body = self.loops[-1]
+            body.continue_used = True
+
+            return f'goto {body.continue_label};'
+
         return 'continue;'
 
     def visit_assert_compare(self, node, prepare):
@@ -2843,6 +4171,12 @@ class BaseVisitor(ast.NodeVisitor):
 
         return self.visit_check_type(node, value_type)
 
+    def visit_GeneratorExp(self, node):
+        raise CompileError(
+            'generator expressions can only be used in for-loops, any(), min(), '
+            'max() and sum()',
+            node)
+
     def visit_DictComp(self, node):
         value_type = ValueTypeVisitor(self.context).visit(node)
         value_type = reduce_type(value_type)
@@ -1,6 +1,11 @@
 from collections import defaultdict
 
+from .utils import BUILTIN_CALLS
+from .utils import SHADOWABLE_BUILTIN_CALLS
 from .utils import CompileError
+from .utils import Deque
+from .utils import SortedDict
+from .utils import SortedSet
 from .utils import is_primitive_type
 from .utils import is_snake_case
 from .utils import split_dict_mys_type
@@ -13,6 +18,17 @@ class State:
         self.raises = raises
 
 
+class Scope:
+    """Local variables of a function body.
+
+    """
+
+    def __init__(self):
+        self.stack = [[]]
+        self.variables = {}
+        self.raises = [False]
+
+
 class SpecializedFunction:
 
     def __init__(self, function, call_module_name, call_node):
@@ -35,6 +51,44 @@ class SpecializedClass:
         return f'SpecializedClass(definitions={self.definitions})'
 
 
+class Features:
+    """Language features used anywhere in the program, that the runtime
+    is built for.
+
+    """
+
+    def __init__(self):
+        # Statements assigning to tuple items or comparing tuples with
+        # "is", as (module, line, code). Tuples must be shared instead
+        # of copied if there are any.
+        self.shared_tuples_uses = []
+
+    @property
+    def shared_tuples(self):
+        return len(self.shared_tuples_uses) > 0
+
+    def use_shared_tuples(self, module, lineno, code):
+        use = (module, lineno, code)
+
+        if use not in self.shared_tuples_uses:
+            self.shared_tuples_uses.append(use)
+
+    def format_hpp(self):
+        lines = ['#pragma once', '']
+
+        if self.shared_tuples:
+            lines.append('// Tuples are shared instead of copied, as tuple items '
+                         'are assigned')
+            lines.append('// to or tuples are compared with "is" by:')
+
+            for module, lineno, code in sorted(self.shared_tuples_uses):
+                lines.append(f'//   {module}:{lineno}: {code}')
+
+            lines.append('#define MYS_SHARED_TUPLES')
+
+        return '\n'.join(lines) + '\n'
+
+
 class Traceback:
 
     def __init__(self, source_lines):
@@ -79,7 +133,8 @@ class Context:
                  module_levels,
                  specialized_functions,
                  specialized_classes,
-                 source_lines):
+                 source_lines,
+                 features):
         self.name = '.'.join(module_levels)
         self._stack = [[]]
         self.local_variables = {}
@@ -102,6 +157,7 @@ class Context:
         self.method_comprehensions = defaultdict(list)
         self.traceback = Traceback(source_lines)
         self.package = module_levels[0]
+        self.features = features
 
     def unique_number(self):
         self.unique_count += 1
@@ -119,6 +175,20 @@ class Context:
 
         return self._name_to_full_name.get(name)
 
+    def is_builtin_call(self, name):
+        """Returns true if given name is a builtin function or class that is
+        not shadowed by a definition in current module.
+
+        """
+
+        if name not in BUILTIN_CALLS:
+            return False
+
+        if name in SHADOWABLE_BUILTIN_CALLS:
+            return self.make_full_name(name) is None
+
+        return True
+
     def define_local_variable(self, name, mys_type, node):
         if self.is_local_variable_defined(name):
             raise CompileError(f"redefining variable '{name}'", node)
@@ -276,13 +346,22 @@ class Context:
             for item_mys_type in mys_type:
                 if not self.is_type_defined(item_mys_type):
                     return False
+        elif isinstance(mys_type, (Deque, SortedSet)):
+            if not self.is_type_defined(mys_type.item_type):
+                return False
+        elif isinstance(mys_type, SortedDict):
+            if not self.is_type_defined(mys_type.key_type):
+                return False
+
+            if not self.is_type_defined(mys_type.value_type):
+                return False
         elif self.is_class_or_trait_defined(mys_type):
             return True
         elif self.is_enum_defined(mys_type):
             return True
         elif is_primitive_type(mys_type):
             return True
-        elif mys_type in ('string', 'bytes', 'regex', 'regexmatch'):
+        elif mys_type in ('string', 'bytes', 'regex', 'regexmatch', 'regexset'):
             return True
         elif mys_type is None:
             return True
@@ -329,6 +408,32 @@ class Context:
 
         return State(result, self._raises.pop())
 
+    def swap_scope(self, scope):
+        """Makes the local variables of given scope the current ones and
+        returns a scope with the previous local variables. Used to visit
+        inlined code without seeing the local variables around it.
+
+        """
+
+        previous = Scope()
+        previous.stack = self._stack
+        previous.variables = self.local_variables
+        previous.raises = self._raises
+        self._stack = scope.stack
+        self.local_variables = scope.variables
+        self._raises = scope.raises
+
+        return previous
+
+    def use_shared_tuples(self, node):
+        """Tuples are shared instead of copied in the whole program, as
+        given node assigns to a tuple item or compares tuples with "is".
+
+        """
+
+        code = self.source_lines[node.lineno - 1].strip().replace('\\', '')
+        self.features.use_shared_tuples(self.name, node.lineno, code)
+
     def set_always_raises(self, value):
         self._raises[-1] = value
 
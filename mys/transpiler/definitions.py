@@ -5,13 +5,18 @@ from ..parser import ast
 from .utils import INTEGER_TYPES
 from .utils import METHOD_BIN_OPERATORS
 from .utils import CompileError
+from .utils import Deque
 from .utils import GenericType
+from .utils import SortedDict
+from .utils import SortedSet
 from .utils import format_mys_type
 from .utils import get_import_from_info
 from .utils import has_docstring
+from .utils import is_builtin_generic_subscript
 from .utils import is_pascal_case
 from .utils import is_snake_case
 from .utils import is_upper_snake_case
+from .utils import make_builtin_generic_type
 from .utils import make_function_name
 
 
@@ -32,7 +37,7 @@ class TypeVisitor(ast.NodeVisitor):
         return tuple(self.visit(elem) for elem in node.elts)
 
     def visit_Dict(self, node):
-        return {node.keys[0].id: self.visit(node.values[0])}
+        return {self.visit(node.keys[0]): self.visit(node.values[0])}
 
     def visit_Set(self, node):
         nitems = len(node.elts)
@@ -43,6 +48,9 @@ class TypeVisitor(ast.NodeVisitor):
         return {self.visit(node.elts[0])}
 
     def visit_Subscript(self, node):
+        if is_builtin_generic_subscript(node):
+            return make_builtin_generic_type(node, self.visit(node.slice))
+
         types = self.visit(node.slice)
 
         if isinstance(node.slice, ast.Name):
@@ -110,11 +118,13 @@ class Function:
                  node,
                  module_name=None,
                  is_overloaded=False,
-                 docstring=None):
+                 docstring=None,
+                 is_iterator=False):
         self.name = name
         self.generic_types = generic_types
         self.raises = raises
         self.is_test = is_test
+        self.is_iterator = is_iterator
         self.args = args
         self.returns = returns
         self.node = node
@@ -416,7 +426,7 @@ def is_method(node):
 
 class FunctionVisitor(TypeVisitor):
 
-    ALLOWED_DECORATORS = ['generic', 'test', 'raises']
+    ALLOWED_DECORATORS = ['generic', 'test', 'raises', 'iterator']
 
     def visit_arg(self, node):
         if node.annotation is None:
@@ -457,6 +467,17 @@ class FunctionVisitor(TypeVisitor):
         else:
             docstring = None
 
+        is_iterator = 'iterator' in decorators
+
+        if is_iterator:
+            if returns is None:
+                raise CompileError("iterator functions must have a return type",
+                                   node)
+
+            if 'generic' in decorators:
+                raise CompileError("generic iterator functions are not supported",
+                                   node)
+
         return Function(node.name,
                         decorators.get('generic', []),
                         decorators.get('raises', []),
@@ -466,7 +487,8 @@ class FunctionVisitor(TypeVisitor):
                         node,
                         None,
                         None,
-                        docstring)
+                        docstring,
+                        is_iterator)
 
 
 class MethodVisitor(FunctionVisitor):
@@ -537,6 +559,11 @@ def visit_decorator_list(decorator_list, allowed_decorators):
                 raise CompileError("no parameters expected", decorator)
 
             decorators['test'] = None
+        elif name == 'iterator':
+            if values:
+                raise CompileError("no parameters expected", decorator)
+
+            decorators['iterator'] = None
         elif name == 'generic':
             if not values:
                 raise CompileError("at least one parameter required", decorator)
@@ -559,6 +586,13 @@ def validate_method_signature(method, method_node):
 
         if method.returns is None:
             raise CompileError(f'{method.name} must return a value', method_node)
+    elif method.name == '__hash__':
+        if len(method.args) != 0:
+            raise CompileError('__hash__ must not take any parameters',
+                               method_node)
+
+        if method.returns != 'i64':
+            raise CompileError('__hash__ must return i64', method_node)
 
 
 class DefinitionsVisitor(ast.NodeVisitor):
@@ -850,6 +884,13 @@ class MakeFullyQualifiedNames:
             }
         elif isinstance(mys_type, tuple):
             return tuple(self.process_type(item) for item in mys_type)
+        elif isinstance(mys_type, Deque):
+            return Deque(self.process_type(mys_type.item_type))
+        elif isinstance(mys_type, SortedDict):
+            return SortedDict(self.process_type(mys_type.key_type),
+                              self.process_type(mys_type.value_type))
+        elif isinstance(mys_type, SortedSet):
+            return SortedSet(self.process_type(mys_type.item_type))
         elif isinstance(mys_type, GenericType):
             mys_type.name = self.process_type(mys_type.name)
             types = []
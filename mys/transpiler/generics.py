@@ -4,7 +4,12 @@ from ..parser import ast
 from .definitions import Class
 from .definitions import Function
 from .utils import CompileError
+from .utils import Deque
 from .utils import GenericType
+from .utils import SortedDict
+from .utils import SortedSet
+from .utils import is_builtin_generic_subscript
+from .utils import make_builtin_generic_type
 from .utils import make_name
 from .utils import make_types_string_parts
 from .utils import mys_to_cpp_type_param
@@ -45,6 +50,13 @@ class SpecializeGenericType:
         elif isinstance(mys_type, tuple):
             mys_type = tuple(self.replace(item_mys_type)
                              for item_mys_type in mys_type)
+        elif isinstance(mys_type, Deque):
+            mys_type = Deque(self.replace(mys_type.item_type))
+        elif isinstance(mys_type, SortedDict):
+            mys_type = SortedDict(self.replace(mys_type.key_type),
+                                  self.replace(mys_type.value_type))
+        elif isinstance(mys_type, SortedSet):
+            mys_type = SortedSet(self.replace(mys_type.item_type))
         else:
             raise Exception('generic type not supported')
 
@@ -275,7 +287,7 @@ class TypeVisitor(ast.NodeVisitor):
         return tuple(self.visit(elem) for elem in node.elts)
 
     def visit_Dict(self, node):
-        return {node.keys[0].id: self.visit(node.values[0])}
+        return {self.visit(node.keys[0]): self.visit(node.values[0])}
 
     def visit_Set(self, node):
         nitems = len(node.elts)
@@ -286,4 +298,7 @@ class TypeVisitor(ast.NodeVisitor):
         return {self.visit(node.elts[0])}
 
     def visit_Subscript(self, node):
+        if is_builtin_generic_subscript(node):
+            return make_builtin_generic_type(node, self.visit(node.slice))
+
         return add_generic_class(node, self.context)[1]
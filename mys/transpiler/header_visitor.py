@@ -32,11 +32,13 @@ class HeaderVisitor(BaseVisitor):
                  module_definitions,
                  has_main,
                  specialized_classes,
-                 method_comprehensions):
+                 method_comprehensions,
+                 features):
         super().__init__(Context(module_levels,
                                  {},
                                  specialized_classes,
-                                 source_lines),
+                                 source_lines,
+                                 features),
                          '',
                          '')
         self.namespace = namespace
@@ -130,7 +132,9 @@ class HeaderVisitor(BaseVisitor):
             cpp_type = self.mys_to_cpp_type(member_type)
             members.append(f'{cpp_type} {make_name(member.name)};')
 
-        members += self.members.get(class_name, [])
+        # Specialized generic classes have embedded C++ members of their
+        # generic class.
+        members += self.members.get(definitions.node.name, [])
 
         return members
 
@@ -273,7 +277,7 @@ class HeaderVisitor(BaseVisitor):
                 if function.name == 'main':
                     main_found = True
 
-                if function.is_generic():
+                if function.is_generic() or function.is_iterator:
                     continue
 
                 self.functions += self.visit_function_declaration(function)
@@ -1,4 +1,7 @@
+import copy
+
 from ..parser import ast
+from .utils import CompileError
 
 
 class HasYieldVisitor(ast.NodeVisitor):
@@ -242,3 +245,70 @@ def transform(tree):
                 returns=ast.Name(id='i64'))
         ],
         decorator_list=[])
+
+
+class LocalNamesVisitor(ast.NodeVisitor):
+
+    def __init__(self):
+        self.names = set()
+
+    def visit_Name(self, node):
+        if isinstance(node.ctx, ast.Store):
+            self.names.add(node.id)
+
+    def visit_ExceptHandler(self, node):
+        if node.name is not None:
+            self.names.add(node.name)
+
+        self.generic_visit(node)
+
+    def visit_Return(self, node):
+        raise CompileError("'return' is not allowed in iterators", node)
+
+    def visit_Try(self, node):
+        if has_yield(node):
+            raise CompileError("'yield' is not allowed in 'try'", node)
+
+        self.generic_visit(node)
+
+
+class RenameVisitor(ast.NodeTransformer):
+
+    def __init__(self, names):
+        self.names = names
+
+    def visit_Name(self, node):
+        node.id = self.names.get(node.id, node.id)
+
+        return node
+
+    def visit_ExceptHandler(self, node):
+        if node.name is not None:
+            node.name = self.names.get(node.name, node.name)
+
+        return self.generic_visit(node)
+
+
+def rename_locals(node, make_name):
+    """Returns a copy of the body of given iterator function and a
+    dictionary of parameter and local variable names to their new
+    names created by given function. The ignored name ``_`` is not
+    renamed.
+
+    """
+
+    visitor = LocalNamesVisitor()
+
+    for item in node.body:
+        visitor.visit(item)
+
+    names = visitor.names | {arg.arg for arg in node.args.args}
+    names = {
+        name: make_name(name)
+        for name in sorted(names)
+        if name != '_'
+    }
+    renamer = RenameVisitor(names)
+    body = [renamer.visit(item) for item in copy.deepcopy(node.body)]
+
+    return body, names
@@ -10,8 +10,11 @@ from .generics import format_parameters
 from .return_checker_visitor import ReturnCheckerVisitor
 from .utils import BUILTIN_ERRORS
 from .utils import CompileError
+from .utils import Deque
 from .utils import GenericType
 from .utils import InternalError
+from .utils import SortedDict
+from .utils import SortedSet
 from .utils import format_default
 from .utils import format_method_name
 from .utils import format_return_type
@@ -83,7 +86,8 @@ class SourceVisitor(ast.NodeVisitor):
                  skip_tests,
                  specialized_functions,
                  specialized_classes,
-                 coverage_variables):
+                 coverage_variables,
+                 features):
         self.module_levels = module_levels
         self.module_hpp = module_hpp
         self.filename = filename
@@ -96,7 +100,8 @@ class SourceVisitor(ast.NodeVisitor):
         self.context = Context(module_levels,
                                specialized_functions,
                                specialized_classes,
-                               source_lines)
+                               source_lines,
+                               features)
         self.definitions = definitions
         self.module_definitions = module_definitions
         self.enums = []
@@ -243,7 +248,7 @@ class SourceVisitor(ast.NodeVisitor):
 
         for functions in self.module_definitions.functions.values():
             for function in functions:
-                if function.is_generic():
+                if function.is_generic() or function.is_iterator:
                     continue
 
                 self.body += self.visit_function_defaults(function)
@@ -319,6 +324,11 @@ class SourceVisitor(ast.NodeVisitor):
             key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
             self.define_implicitly_imported_types(key_mys_type)
             self.define_implicitly_imported_types(value_mys_type)
+        elif isinstance(mys_type, (Deque, SortedSet)):
+            self.define_implicitly_imported_types(mys_type.item_type)
+        elif isinstance(mys_type, SortedDict):
+            self.define_implicitly_imported_types(mys_type.key_type)
+            self.define_implicitly_imported_types(mys_type.value_type)
         elif isinstance(mys_type, GenericType):
             # ToDo, but what should be done?
             pass
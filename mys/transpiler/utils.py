@@ -15,6 +15,64 @@ class GenericType:
         return f'GenericType(name={self.name}, types={self.types})'
 
 
+class Deque:
+    """The builtin double-ended queue type with items of given type.
+
+    """
+
+    def __init__(self, item_type):
+        self.item_type = item_type
+
+    def __eq__(self, other):
+        return isinstance(other, Deque) and self.item_type == other.item_type
+
+    def __hash__(self):
+        return hash(('Deque', self.item_type))
+
+    def __str__(self):
+        return f'Deque({self.item_type})'
+
+
+class SortedDict:
+    """The builtin dict type ordered by key, with keys and values of given
+    types.
+
+    """
+
+    def __init__(self, key_type, value_type):
+        self.key_type = key_type
+        self.value_type = value_type
+
+    def __eq__(self, other):
+        return (isinstance(other, SortedDict)
+                and self.key_type == other.key_type
+                and self.value_type == other.value_type)
+
+    def __hash__(self):
+        return hash(('SortedDict', self.key_type, self.value_type))
+
+    def __str__(self):
+        return f'SortedDict({self.key_type}, {self.value_type})'
+
+
+class SortedSet:
+    """The builtin set type ordered by value, with items of given type.
+
+    """
+
+    def __init__(self, item_type):
+        self.item_type = item_type
+
+    def __eq__(self, other):
+        return isinstance(other, SortedSet) and self.item_type == other.item_type
+
+    def __hash__(self):
+        return hash(('SortedSet', self.item_type))
+
+    def __str__(self):
+        return f'SortedSet({self.item_type})'
+
+
 class CompileError(Exception):
 
     def __init__(self, message, node):
@@ -70,16 +128,30 @@ BUILTIN_ERRORS = {
     'UnreachableError'
 }
 
+# Builtins that functions and classes defined in or imported into a
+# module take precedence over, as they were added after applications
+# may have defined them.
+SHADOWABLE_BUILTIN_CALLS = set([
+    'any',
+    'map',
+    'filter',
+    'take',
+    'chain',
+    'regexset'
+])
+
 BUILTIN_CALLS = set(
     list(INTEGER_TYPES)
     + list(BUILTIN_ERRORS) + [
         'print',
+        'any',
         'bytes',
         'char',
         'list',
         'input',
         'set',
         'regex',
+        'regexset',
         'str',
         'min',
         'max',
@@ -90,6 +162,10 @@ BUILTIN_CALLS = set(
         'enumerate',
         'range',
         'reversed',
+        'map',
+        'filter',
+        'take',
+        'chain',
         'slice',
         'sum',
         'zip',
@@ -209,12 +285,52 @@ LIST_METHODS = {
     'clear': [[], None]
 }
 
+DEQUE_METHODS = {
+    'append': [['<dequetype>'], None],
+    'append_left': [['<dequetype>'], None],
+    'extend': [['list<dequetype>'], None],
+    'pop': [[], '<dequetype>'],
+    'pop_left': [[], '<dequetype>'],
+    'front': [[], '<dequetype>'],
+    'back': [[], '<dequetype>'],
+    'clear': [[], None]
+}
+
+SORTED_DICT_METHODS = {
+    'get': [['<keytype>', '<valuetype>'], '<valuetype>'],
+    'pop': [['<keytype>', '<valuetype>'], '<valuetype>'],
+    'keys': [[], ['<keytype>']],
+    'values': [[], ['<valuetype>']],
+    'floor': [['<keytype>'], '<keytype>'],
+    'ceiling': [['<keytype>'], '<keytype>'],
+    'rank': [['<keytype>'], 'i64'],
+    'key_at': [['i64'], '<keytype>'],
+    'clear': [[], None]
+}
+
+SORTED_SET_METHODS = {
+    'add': [['<keytype>'], None],
+    'discard': [['<keytype>'], None],
+    'remove': [['<keytype>'], None],
+    'floor': [['<keytype>'], '<keytype>'],
+    'ceiling': [['<keytype>'], '<keytype>'],
+    'rank': [['<keytype>'], 'i64'],
+    'at': [['i64'], '<keytype>'],
+    'clear': [[], None]
+}
+
 REGEX_METHODS = {
     'split': [['string'], ['string']],
+    'find_all': [['string'], ['string']],
     'match': [['string'], 'regexmatch'],
     'replace': [['string', 'string'], 'string']
 }
 
+REGEXSET_METHODS = {
+    'matches': [['string'], ['i64']],
+    'is_match': [['string'], 'bool']
+}
+
 REGEXMATCH_METHODS = {
     'span': [[None], ('i64', 'i64')],
     'start': [[None], 'i64'],
@@ -265,6 +381,79 @@ def is_float_type(mys_type):
     return mys_type in ['f32', 'f64']
 
 
+BUILTIN_GENERIC_TYPES = ['Deque', 'SortedDict', 'SortedSet']
+
+
+def is_builtin_generic_subscript(node):
+    """Returns true if given subscript node is ``Deque[T]``,
+    ``SortedDict[K, V]`` or ``SortedSet[T]``.
+
+    """
+
+    return (isinstance(node.value, ast.Name)
+            and node.value.id in BUILTIN_GENERIC_TYPES)
+
+
+def make_builtin_generic_type(node, types):
+    """Returns the builtin generic type of given subscript node with given
+    visited types.
+
+    """
+
+    name = node.value.id
+
+    if name == 'SortedDict':
+        if not isinstance(types, tuple) or len(types) != 2:
+            raise CompileError("expected key and value types", node.slice)
+
+        return SortedDict(types[0], types[1])
+    elif isinstance(types, tuple):
+        raise CompileError("expected one type", node.slice)
+    elif name == 'SortedSet':
+        return SortedSet(types)
+    else:
+        return Deque(types)
+
+
+def sorted_method_types(spec, mys_type):
+    """Returns parameter and return types of given sorted dict or sorted
+    set method spec.
+
+    """
+
+    if isinstance(mys_type, SortedDict):
+        replacements = {
+            '<keytype>': mys_type.key_type,
+            '<valuetype>': mys_type.value_type
+        }
+    else:
+        replacements = {'<keytype>': mys_type.item_type}
+
+    def replace(spec_type):
+        if isinstance(spec_type, list):
+            return [replace(spec_type[0])]
+        else:
+            return replacements.get(spec_type, spec_type)
+
+    return [replace(param) for param in spec[0]], replace(spec[1])
+
+
+def is_name_assigned(nodes, name):
+    """Returns true if given variable is assigned to in any of given
+    nodes.
+
+    """
+
+    for node in nodes:
+        for item in ast.walk(node):
+            if (isinstance(item, ast.Name)
+                and item.id == name
+                and isinstance(item.ctx, ast.Store)):
+                return True
+
+    return False
+
+
 def dot2ns(name):
     # Hack...
     if name not in BUILTIN_CALLS and name != 'Error':
@@ -361,6 +550,18 @@ def shared_set_type(cpp_type):
     return f'SharedSet<{cpp_type}>'
 
 
+def shared_deque_type(cpp_type):
+    return f'SharedDeque<{cpp_type}>'
+
+
+def shared_sorted_dict_type(key_cpp_type, value_cpp_type):
+    return f'SharedSortedDict<{key_cpp_type}, {value_cpp_type}>'
+
+
+def shared_sorted_set_type(cpp_type):
+    return f'SharedSortedSet<{cpp_type}>'
+
+
 def shared_tuple_type(items):
     return f'SharedTuple<{items}>'
 
@@ -383,6 +584,19 @@ def mys_to_cpp_type(mys_type, context):
     elif isinstance(mys_type, set):
         item = mys_to_cpp_type(list(mys_type)[0], context)
         return shared_set_type(item)
+    elif isinstance(mys_type, Deque):
+        item = mys_to_cpp_type(mys_type.item_type, context)
+
+        return shared_deque_type(item)
+    elif isinstance(mys_type, SortedDict):
+        key = mys_to_cpp_type(mys_type.key_type, context)
+        value = mys_to_cpp_type(mys_type.value_type, context)
+
+        return shared_sorted_dict_type(key, value)
+    elif isinstance(mys_type, SortedSet):
+        item = mys_to_cpp_type(mys_type.item_type, context)
+
+        return shared_sorted_set_type(item)
     else:
         if mys_type == 'string':
             return 'mys::String'
@@ -396,6 +610,8 @@ def mys_to_cpp_type(mys_type, context):
             return 'mys::Regex'
         elif mys_type == 'regexmatch':
             return 'mys::RegexMatch'
+        elif mys_type == 'regexset':
+            return 'mys::SharedRegexSet'
         elif context.is_class_or_trait_defined(mys_type):
             return f'mys::shared_ptr<{dot2ns(mys_type)}>'
         elif context.is_enum_defined(mys_type):
@@ -638,6 +854,15 @@ def format_mys_type(mys_type):
     elif isinstance(mys_type, set):
         item = format_mys_type(list(mys_type)[0])
         return f'{{{item}}}'
+    elif isinstance(mys_type, Deque):
+        return f'Deque[{format_mys_type(mys_type.item_type)}]'
+    elif isinstance(mys_type, SortedDict):
+        key = format_mys_type(mys_type.key_type)
+        value = format_mys_type(mys_type.value_type)
+
+        return f'SortedDict[{key}, {value}]'
+    elif isinstance(mys_type, SortedSet):
+        return f'SortedSet[{format_mys_type(mys_type.item_type)}]'
     elif isinstance(mys_type, GenericType):
         types = ', '.join(format_mys_type(type) for type in mys_type.types)
 
@@ -696,6 +921,20 @@ def make_types_string_parts(mys_types):
             parts.append('cn')
             parts += make_types_string_parts([value_mys_type])
             parts.append('de')
+        elif isinstance(mys_type, Deque):
+            parts.append('qb')
+            parts += make_types_string_parts([mys_type.item_type])
+            parts.append('qe')
+        elif isinstance(mys_type, SortedDict):
+            parts.append('sdb')
+            parts += make_types_string_parts([mys_type.key_type])
+            parts.append('cn')
+            parts += make_types_string_parts([mys_type.value_type])
+            parts.append('sde')
+        elif isinstance(mys_type, SortedSet):
+            parts.append('ssb')
+            parts += make_types_string_parts([mys_type.item_type])
+            parts.append('sse')
         else:
             raise Exception(str(mys_type))
 
@@ -736,7 +975,8 @@ def raise_if_wrong_types(actual_mys_type, expected_mys_type, node, context):
             return
         elif expected_mys_type in ['string', 'bytes']:
             return
-        elif isinstance(expected_mys_type, (list, tuple, dict)):
+        elif isinstance(expected_mys_type,
+                        (list, tuple, dict, Deque, SortedDict, SortedSet)):
             return
 
     raise_wrong_types(actual_mys_type, expected_mys_type, node)
@@ -13,7 +13,6 @@ from .utils import is_integer_literal
 from .utils import is_primitive_type
 from .utils import make_float_literal
 from .utils import make_integer_literal
-from .utils import make_shared
 from .utils import make_shared_dict
 from .utils import make_shared_list
 from .utils import make_shared_set
@@ -23,11 +22,18 @@ from .utils import raise_if_wrong_visited_type
 from .utils import split_dict_mys_type
 
 
-def is_allowed_dict_key_type(mys_type):
+def is_allowed_dict_key_type(mys_type, context):
     if is_primitive_type(mys_type):
         return True
     elif mys_type == 'string':
         return True
+    elif isinstance(mys_type, tuple):
+        return all(is_allowed_dict_key_type(item_mys_type, context)
+                   for item_mys_type in mys_type)
+    elif context.is_class_defined(mys_type):
+        methods = context.get_class_definitions(mys_type).methods
+
+        return '__hash__' in methods and '__eq__' in methods
 
     return False
 
@@ -59,7 +65,7 @@ class ValueCheckTypeVisitor:
         cpp_type = self.mys_to_cpp_type(mys_type)
         values = ", ".join(values)
 
-        return make_shared(cpp_type[6:], values)
+        return f'{cpp_type}({values})'
 
     def visit_list(self, node, mys_type):
         if not isinstance(mys_type, list):
@@ -92,7 +98,7 @@ class ValueCheckTypeVisitor:
 
         key_mys_type, value_mys_type = split_dict_mys_type(mys_type)
 
-        if not is_allowed_dict_key_type(key_mys_type):
+        if not is_allowed_dict_key_type(key_mys_type, self.context):
             raise CompileError("invalid key type", node)
 
         keys = []
@@ -4,22 +4,30 @@ from .generics import TypeVisitor
 from .generics import add_generic_class
 from .generics import fix_chosen_types
 from .generics import replace_generic_types
-from .utils import BUILTIN_CALLS
 from .utils import BUILTIN_ERRORS
 from .utils import BYTES_METHODS
+from .utils import DEQUE_METHODS
 from .utils import LIST_METHODS
 from .utils import NUMBER_TYPES
 from .utils import OPERATORS_TO_METHOD
 from .utils import REGEX_METHODS
 from .utils import REGEXMATCH_METHODS
+from .utils import REGEXSET_METHODS
 from .utils import SET_METHODS
+from .utils import SORTED_DICT_METHODS
+from .utils import SORTED_SET_METHODS
 from .utils import STRING_METHODS
 from .utils import CompileError
+from .utils import Deque
 from .utils import InternalError
+from .utils import SortedDict
+from .utils import SortedSet
+from .utils import is_builtin_generic_subscript
 from .utils import is_primitive_type
 from .utils import is_snake_case
 from .utils import make_integer_literal
 from .utils import raise_if_types_differs
+from .utils import sorted_method_types
 from .utils import split_dict_mys_type
 
 
@@ -35,6 +43,13 @@ def mys_to_value_type(mys_type):
                     mys_to_value_type(value_mys_type))
     elif isinstance(mys_type, set):
         return Set(mys_to_value_type(list(mys_type)[0]))
+    elif isinstance(mys_type, Deque):
+        return Deque(mys_to_value_type(mys_type.item_type))
+    elif isinstance(mys_type, SortedDict):
+        return SortedDict(mys_to_value_type(mys_type.key_type),
+                          mys_to_value_type(mys_type.value_type))
+    elif isinstance(mys_type, SortedSet):
+        return SortedSet(mys_to_value_type(mys_type.item_type))
     else:
         return mys_type
 
@@ -221,6 +236,13 @@ def reduce_type(value_type):
         return {reduce_type(value_type.key_type): reduce_type(value_type.value_type)}
     elif isinstance(value_type, Set):
         return {reduce_type(value_type.value_type)}
+    elif isinstance(value_type, Deque):
+        return Deque(reduce_type(value_type.item_type))
+    elif isinstance(value_type, SortedDict):
+        return SortedDict(reduce_type(value_type.key_type),
+                          reduce_type(value_type.value_type))
+    elif isinstance(value_type, SortedSet):
+        return SortedSet(reduce_type(value_type.item_type))
     elif value_type is None:
         return None
     else:
@@ -302,10 +324,12 @@ class ValueTypeVisitor(ast.NodeVisitor):
 
         if isinstance(value_type, list):
             value_type = value_type[0]
+        elif isinstance(value_type, Deque):
+            value_type = value_type.item_type
         elif isinstance(value_type, tuple):
             index = make_integer_literal('i64', node.slice)
             value_type = value_type[int(index)]
-        elif isinstance(value_type, Dict):
+        elif isinstance(value_type, (Dict, SortedDict)):
             value_type = value_type.value_type
         elif value_type == 'string':
             slice_type = self.visit(node.slice)
@@ -593,6 +617,32 @@ class ValueTypeVisitor(ast.NodeVisitor):
     def visit_call_enum(self, mys_type, _node):
         return mys_type
 
+    def visit_item_type(self, node):
+        mys_type = self.visit(node)
+
+        if mys_type == 'string':
+            return 'char'
+        else:
+            return mys_type[0]
+
+    def visit_map_function(self, node):
+        """Returns the return type of the function given to map().
+
+        """
+
+        item_mys_type = self.visit_item_type(node.args[1])
+        item = self.context.unique('item')
+        self.context.push()
+        self.context.define_local_variable(item, item_mys_type, node)
+        mys_type = self.visit(ast.Call(func=node.args[0],
+                                       args=[ast.Name(id=item)],
+                                       keywords=[],
+                                       lineno=node.lineno,
+                                       col_offset=node.col_offset))
+        self.context.pop()
+
+        return mys_type
+
     def visit_call_builtin(self, name, node):
         if name in NUMBER_TYPES:
             return name
@@ -604,6 +654,8 @@ class ValueTypeVisitor(ast.NodeVisitor):
             return 'char'
         elif name == 'regex':
             return 'regex'
+        elif name == 'regexset':
+            return 'regexset'
         elif name == 'set':
             value_type = self.visit(node.args[0])
             if isinstance(value_type, list):
@@ -628,14 +680,21 @@ class ValueTypeVisitor(ast.NodeVisitor):
                 return value_type
         elif name == 'abs':
             return self.visit(node.args[0])
+        elif name == 'any':
+            return 'bool'
+        elif name == 'map':
+            return [self.visit_map_function(node)]
+        elif name == 'filter':
+            return self.visit(node.args[1])
+        elif name in ['take', 'chain']:
+            return self.visit(node.args[0])
         elif name == 'range':
             return ['i64']
         elif name == 'enumerate':
             # ???
             return [('i64', self.visit(node.args[0]))]
         elif name == 'zip':
-            # ???
-            return [self.visit(node.args[0])]
+            return [tuple(self.visit_item_type(arg) for arg in node.args)]
         elif name == 'slice':
             # ???
             return [self.visit(node.args[0])]
@@ -669,6 +728,25 @@ class ValueTypeVisitor(ast.NodeVisitor):
         else:
             return spec[1]
 
+    def visit_call_method_deque(self, name, value_type, node):
+        spec = DEQUE_METHODS.get(name, None)
+
+        if spec is None:
+            raise InternalError(f"deque method '{name}' not supported", node)
+
+        if spec[1] == '<dequetype>':
+            return value_type.item_type
+        else:
+            return spec[1]
+
+    def visit_call_method_sorted(self, name, methods, value_type, node):
+        spec = methods.get(name, None)
+
+        if spec is None:
+            raise InternalError(f"method '{name}' not supported", node)
+
+        return sorted_method_types(spec, value_type)[1]
+
     def visit_call_method_dict(self, name, value_type, node):
         if name in ['get', 'pop']:
             return value_type.value_type
@@ -722,6 +800,14 @@ class ValueTypeVisitor(ast.NodeVisitor):
 
         return spec[1]
 
+    def visit_call_method_regexset(self, name, node):
+        spec = REGEXSET_METHODS.get(name, None)
+
+        if spec is None:
+            raise InternalError(f"regexset method '{name}' not supported", node)
+
+        return spec[1]
+
     def visit_call_method_class(self, name, value_type, node):
         method = self.find_called_method(value_type, name, node)
         returns = method.returns
@@ -758,12 +844,26 @@ class ValueTypeVisitor(ast.NodeVisitor):
             return self.visit_call_method_set(name, value_type, node.func)
         elif isinstance(value_type, Dict):
             return self.visit_call_method_dict(name, value_type, node.func)
+        elif isinstance(value_type, Deque):
+            return self.visit_call_method_deque(name, value_type, node.func)
+        elif isinstance(value_type, SortedDict):
+            return self.visit_call_method_sorted(name,
+                                                 SORTED_DICT_METHODS,
+                                                 value_type,
+                                                 node.func)
+        elif isinstance(value_type, SortedSet):
+            return self.visit_call_method_sorted(name,
+                                                 SORTED_SET_METHODS,
+                                                 value_type,
+                                                 node.func)
         elif value_type == 'string':
             return self.visit_call_method_string(name, node.func)
         elif value_type == 'regexmatch':
             return self.visit_call_method_regexmatch(name, node.func)
         elif value_type == 'regex':
             return self.visit_call_method_regex(name, node.func)
+        elif value_type == 'regexset':
+            return self.visit_call_method_regexset(name, node.func)
         elif value_type == 'bytes':
             return self.visit_call_method_bytes(name, node.func)
         elif self.context.is_class_defined(value_type):
@@ -793,7 +893,9 @@ class ValueTypeVisitor(ast.NodeVisitor):
         return add_generic_class(node.func, self.context)[1]
 
     def visit_call_generic(self, node):
-        if isinstance(node.func.value, ast.Name):
+        if is_builtin_generic_subscript(node.func):
+            return mys_to_value_type(TypeVisitor(self.context).visit(node.func))
+        elif isinstance(node.func.value, ast.Name):
             if self.context.is_class_defined(node.func.value.id):
                 return self.visit_call_generic_class(node)
             else:
@@ -806,7 +908,7 @@ class ValueTypeVisitor(ast.NodeVisitor):
         if isinstance(node.func, ast.Name):
             name = node.func.id
 
-            if name in BUILTIN_CALLS:
+            if self.context.is_builtin_call(name):
                 return self.visit_call_builtin(name, node)
             else:
                 full_name = self.context.make_full_name(name)
@@ -853,6 +955,8 @@ class ValueTypeVisitor(ast.NodeVisitor):
             item_type = iter_type[0]
         elif isinstance(iter_type, Dict):
             item_type = (iter_type.key_type, iter_type.value_type)
+        elif iter_type == 'string':
+            item_type = 'char'
         else:
             raise CompileError("unsupported type", node)
 
@@ -863,6 +967,9 @@ class ValueTypeVisitor(ast.NodeVisitor):
 
         return result_type
 
+    def visit_GeneratorExp(self, node):
+        return self.visit_ListComp(node)
+
     def visit_DictComp(self, node):
         if len(node.generators) != 1:
             raise CompileError("only one for-loop allowed", node)
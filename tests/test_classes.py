@@ -377,6 +377,16 @@ class Test(TestCase):
             '        ^\n'
             "CompileError: __add__ must return a value\n")
 
+    def test_hash_wrong_return_type(self):
+        self.assert_transpile_raises(
+            'class Foo:\n'
+            '    def __hash__(self) -> u64:\n'
+            '        return 1\n',
+            '  File "", line 2\n'
+            '        def __hash__(self) -> u64:\n'
+            '        ^\n'
+            "CompileError: __hash__ must return i64\n")
+
     def test_operator_not_overloaded(self):
         self.assert_transpile_raises(
             'class Foo:\n'
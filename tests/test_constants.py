@@ -49,7 +49,8 @@ class Test(TestCase):
         self.assert_in(
             'static const SharedTuple<mys::Bool, SharedList<mys::String>, '
             'SharedTuple<u8, i8>> '
-            '__constant_1 = mys::make_shared',
+            '__constant_1 = SharedTuple<mys::Bool, SharedList<mys::String>, '
+            'SharedTuple<u8, i8>>(mys::Bool(true), ',
             source)
         self.assert_in('if (mys::Bool(v != __constant_1)) {', source)
 
@@ -59,7 +60,7 @@ class Test(TestCase):
                                   '        print(v)\n')
 
         self.assertNotIn('static const SharedTuple', source)
-        self.assert_in('if (mys::Bool(v != mys::make_shared<', source)
+        self.assert_in('if (mys::Bool(v != SharedTuple<mys::Bool, ', source)
 
     def test_if_primitive_types_not_constant(self):
         source = transpile_source('def foo(v: i64):\n'
@@ -0,0 +1,27 @@
+from .utils import TestCase
+from .utils import build_and_test_module
+
+
+class Test(TestCase):
+
+    def test_deque(self):
+        build_and_test_module('deque')
+
+    def test_deque_wrong_item_type(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    v = Deque[i64](["a"])\n',
+            '  File "", line 2\n'
+            '        v = Deque[i64](["a"])\n'
+            '                        ^\n'
+            "CompileError: expected a 'i64', got a 'string'\n")
+
+    def test_deque_method_not_implemented(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    v = Deque[i64]()\n'
+            '    v.foo()\n',
+            '  File "", line 3\n'
+            '        v.foo()\n'
+            '        ^\n'
+            "CompileError: deque method not implemented\n")
@@ -1,5 +1,6 @@
 from .utils import TestCase
 from .utils import build_and_test_module
+from .utils import transpile_source
 
 
 class Test(TestCase):
@@ -7,6 +8,42 @@ class Test(TestCase):
     def test_dict(self):
         build_and_test_module('dict')
 
+    def test_iterate_over_dict_keys_without_creating_a_list(self):
+        source = transpile_source('def foo(v: {i64: string}) -> i64:\n'
+                                  '    total = 0\n'
+                                  '    for key in v.keys():\n'
+                                  '        total += key\n'
+                                  '    return total\n')
+
+        self.assert_in('->keys_view()', source)
+        self.assert_not_in('->keys()', source)
+
+    def test_iterate_over_dict_keys_list_if_body_may_change_dict(self):
+        source = transpile_source('def foo(v: {i64: string}):\n'
+                                  '    for key in v.keys():\n'
+                                  '        v.pop(key, "")\n')
+
+        self.assert_in('->keys()', source)
+        self.assert_not_in('->keys_view()', source)
+
+    def test_iterate_over_dict_items_walk_if_body_may_change_dict(self):
+        source = transpile_source('def foo(v: {i64: string}):\n'
+                                  '    for key, value in v:\n'
+                                  '        print(key, value)\n')
+
+        self.assert_in('__items_1->walk_items()', source)
+        self.assert_not_in('mys::snapshot', source)
+
+    def test_lookup_string_key_with_view(self):
+        source = transpile_source('def foo(v: {string: i64}, s: string):\n'
+                                  '    print(v["a"])\n'
+                                  '    print(v.get(s[1:], 0))\n'
+                                  '    print("b" in v)\n')
+
+        self.assert_in('get(mys::StringLiteral("a"))', source)
+        self.assert_in('get(s.view(1, std::nullopt), 0)', source)
+        self.assert_in('contains(mys::StringLiteral("b"), v)', source)
+
     def test_return_dict_from_function_returning_list(self):
         self.assert_transpile_raises(
             'class Foo:\n'
@@ -100,6 +137,19 @@ class Test(TestCase):
             '                        ^\n'
             "CompileError: invalid key type\n")
 
+    def test_dict_class_key_type_without_hash(self):
+        self.assert_transpile_raises(
+            'class Foo:\n'
+            '    def __eq__(self, other: Foo) -> bool:\n'
+            '        return True\n'
+            'def foo():\n'
+            '    v: {Foo: i64} = {}\n'
+            '    print(v)\n',
+            '  File "", line 5\n'
+            '        v: {Foo: i64} = {}\n'
+            '                        ^\n'
+            "CompileError: invalid key type\n")
+
     def test_dict_init_value_types_mismatch_2(self):
         self.assert_transpile_raises(
             'def foo():\n'
@@ -1,8 +1,19 @@
+import os
+from unittest.mock import patch
+
 from .utils import TestCase
 from .utils import build_and_test_module
+from .utils import create_new_package_with_files
+from .utils import test_package
 
 
 class Test(TestCase):
 
     def test_fibers(self):
         build_and_test_module('fibers')
+
+    def test_fibers_multi_core(self):
+        create_new_package_with_files('test_fibers_multi_core', 'fibers')
+
+        with patch.dict(os.environ, {'MYS_FIBER_WORKERS': '4'}):
+            test_package('test_fibers_multi_core', ['--multi-core'])
@@ -0,0 +1,31 @@
+import os
+from unittest.mock import patch
+
+from .utils import TestCase
+from .utils import create_new_package_with_files
+from .utils import test_package
+
+
+class Test(TestCase):
+
+    # The test module can not be called file as it would hide the file
+    # package in generated code.
+
+    def test_file(self):
+        create_new_package_with_files('test_file', 'file', 'lib')
+        test_package('test_file', [])
+
+    def test_file_io_uring(self):
+        create_new_package_with_files('test_file_io_uring', 'file', 'lib')
+
+        with patch.dict(os.environ, {'MYS_IO_URING': 'yes'}):
+            test_package('test_file_io_uring', [])
+
+    def test_file_io_uring_multi_core(self):
+        create_new_package_with_files('test_file_io_uring_multi_core',
+                                      'file',
+                                      'lib')
+
+        with patch.dict(os.environ,
+                        {'MYS_IO_URING': 'yes', 'MYS_FIBER_WORKERS': '4'}):
+            test_package('test_file_io_uring_multi_core', ['--multi-core'])
@@ -2,6 +2,8 @@ from mys.parser import ast
 from mys.transpiler.iterators import transform
 
 from .utils import TestCase
+from .utils import build_and_test_module
+from .utils import transpile_source
 
 
 def remove_whitespace_lines(text):
@@ -332,3 +334,95 @@ class Test(TestCase):
             '                        self._state = 1\n'
             '                case 1:\n'
             '                    raise RuntimeError()')
+
+    def test_iterators(self):
+        build_and_test_module('iterators')
+
+    def test_large_loop_body_is_not_inlined_at_each_yield(self):
+        body = ''.join([f'        total += {i} * x\n' for i in range(30)])
+        source = transpile_source('@iterator\n'
+                                  'def foo() -> i64:\n'
+                                  '    yield 1\n'
+                                  '    yield 2\n'
+                                  '    yield 3\n'
+                                  'def bar() -> i64:\n'
+                                  '    total = 0\n'
+                                  '    for x in foo():\n'
+                                  + body +
+                                  '    return total\n')
+
+        self.assertEqual(source.count('(29 * x)'), 1)
+        self.assert_in('auto __body_', source)
+
+    def test_small_loop_body_is_inlined_at_each_yield(self):
+        source = transpile_source('@iterator\n'
+                                  'def foo() -> i64:\n'
+                                  '    yield 1\n'
+                                  '    yield 2\n'
+                                  'def bar() -> i64:\n'
+                                  '    total = 0\n'
+                                  '    for x in foo():\n'
+                                  '        total += 7 * x\n'
+                                  '    return total\n')
+
+        self.assertEqual(source.count('(7 * x)'), 2)
+        self.assertNotIn('auto __body_', source)
+
+    def test_iterator_outside_of_for_loop(self):
+        self.assert_transpile_raises(
+            '@iterator\n'
+            'def foo() -> i64:\n'
+            '    yield 1\n'
+            'def bar():\n'
+            '    x = foo()\n',
+            '  File "", line 5\n'
+            '        x = foo()\n'
+            '            ^\n'
+            "CompileError: iterator functions can only be used in for-loops\n")
+
+    def test_yield_outside_iterator(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    yield 1\n',
+            '  File "", line 2\n'
+            '        yield 1\n'
+            '        ^\n'
+            "CompileError: 'yield' outside iterator function\n")
+
+    def test_return_in_iterator(self):
+        self.assert_transpile_raises(
+            '@iterator\n'
+            'def foo() -> i64:\n'
+            '    yield 1\n'
+            '    return\n'
+            'def bar():\n'
+            '    for x in foo():\n'
+            '        print(x)\n',
+            '  File "", line 4\n'
+            '        return\n'
+            '        ^\n'
+            "CompileError: 'return' is not allowed in iterators\n")
+
+    def test_iterator_does_not_see_caller_variables(self):
+        self.assert_transpile_raises(
+            '@iterator\n'
+            'def foo() -> i64:\n'
+            '    yield count\n'
+            'def bar():\n'
+            '    count = 2\n'
+            '    for x in foo():\n'
+            '        print(x)\n',
+            '  File "", line 3\n'
+            '        yield count\n'
+            '              ^\n'
+            "CompileError: undefined variable 'count'\n")
+
+    def test_iterator_without_return_type(self):
+        self.assert_transpile_raises(
+            '@iterator\n'
+            'def foo():\n'
+            '    yield 1\n',
+            '  File "", line 2\n'
+            '    def foo():\n'
+            '    ^\n'
+            "CompileError: iterator functions must have a return type\n")
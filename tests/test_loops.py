@@ -1,5 +1,6 @@
 from .utils import TestCase
 from .utils import build_and_test_module
+from .utils import transpile_source
 
 
 class Test(TestCase):
@@ -30,3 +31,41 @@ class Test(TestCase):
             '        while False:\n'
             '        ^\n'
             "CompileError: while else clause not supported\n")
+
+    def test_map_outside_of_for_loop(self):
+        self.assert_transpile_raises(
+            'def square(v: i64) -> i64:\n'
+            '    return v * v\n'
+            'def foo():\n'
+            '    x = map(square, [1, 2])\n',
+            '  File "", line 4\n'
+            '        x = map(square, [1, 2])\n'
+            '            ^\n'
+            "CompileError: function can only be used in for-loops, any(), min(), "
+            "max() and sum()\n")
+
+    def test_filter_function_not_returning_bool(self):
+        self.assert_transpile_raises(
+            'def square(v: i64) -> i64:\n'
+            '    return v * v\n'
+            'def foo():\n'
+            '    for x in filter(square, [1, 2]):\n'
+            '        pass\n',
+            '  File "", line 4\n'
+            '        for x in filter(square, [1, 2]):\n'
+            '                        ^\n'
+            "CompileError: filter function must return a bool\n")
+
+    def test_functions_shadow_iterator_builtins(self):
+        source = transpile_source('def map(v: i64) -> i64:\n'
+                                  '    return 2 * v\n'
+                                  'def take(values: [i64]) -> bool:\n'
+                                  '    return len(values) > 0\n'
+                                  'def foo():\n'
+                                  '    print(map(1))\n'
+                                  '    for v in [1]:\n'
+                                  '        print(take([v]))\n')
+
+        self.assert_in('map(1)', source)
+        self.assert_in('take(', source)
+        self.assertNotIn('MapIter', source)
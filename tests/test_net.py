@@ -0,0 +1,28 @@
+import os
+from unittest.mock import patch
+
+from .utils import TestCase
+from .utils import create_new_package_with_files
+from .utils import test_package
+
+
+class Test(TestCase):
+
+    # The test module can not be called net as it would hide the net
+    # package in generated code.
+
+    def test_net(self):
+        create_new_package_with_files('test_net', 'net', 'lib')
+        test_package('test_net', [])
+
+    def test_net_multi_core(self):
+        create_new_package_with_files('test_net_multi_core', 'net', 'lib')
+
+        with patch.dict(os.environ, {'MYS_FIBER_WORKERS': '4'}):
+            test_package('test_net_multi_core', ['--multi-core'])
+
+    def test_net_io_uring(self):
+        create_new_package_with_files('test_net_io_uring', 'net', 'lib')
+
+        with patch.dict(os.environ, {'MYS_IO_URING': 'yes'}):
+            test_package('test_net_io_uring', [])
@@ -79,3 +79,43 @@ class Test(TestCase):
             '    print(er"b")\n'
             "            ^\n"
             'SyntaxError: invalid syntax\n')
+
+    def test_invalid_regex_literal(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    print(re"(a")\n',
+            '  File "", line 2\n'
+            '        print(re"(a")\n'
+            '              ^\n'
+            "CompileError: invalid regex: missing ), unterminated subpattern "
+            "at offset 0\n")
+
+    def test_invalid_regex_call(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    print(regex("[a", "i"))\n',
+            '  File "", line 2\n'
+            '        print(regex("[a", "i"))\n'
+            '              ^\n'
+            "CompileError: invalid regex: unterminated character set "
+            "at offset 0\n")
+
+    def test_pcre_only_regex_literal(self):
+        transpile_source('def foo():\n'
+                         '    print(re"\\p{L}++")\n')
+
+    def test_pcre_verbs_regex_literal(self):
+        transpile_source('def foo():\n'
+                         '    print(re"(*UTF)abc")\n'
+                         '    print(re"a(*SKIP)(*F)|b")\n'
+                         '    print(re"a(*ACCEPT)b")\n'
+                         '    print(regex("(*UCP)\\\\w", ""))\n')
+
+    def test_regex_set_of_strings(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    print(regexset(["a"]))\n',
+            '  File "", line 2\n'
+            '        print(regexset(["a"]))\n'
+            '                        ^\n'
+            "CompileError: expected a 'regex', got a 'string'\n")
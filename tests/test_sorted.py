@@ -0,0 +1,28 @@
+from .utils import TestCase
+from .utils import build_and_test_module
+
+
+class Test(TestCase):
+
+    def test_sorted(self):
+        build_and_test_module('sorted')
+
+    def test_sorted_dict_wrong_key_type(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    v = SortedDict[i64, string]()\n'
+            '    v["a"] = "b"\n',
+            '  File "", line 3\n'
+            '        v["a"] = "b"\n'
+            '          ^\n'
+            "CompileError: expected a 'i64', got a 'string'\n")
+
+    def test_sorted_set_method_not_implemented(self):
+        self.assert_transpile_raises(
+            'def foo():\n'
+            '    v = SortedSet[i64]()\n'
+            '    v.foo()\n',
+            '  File "", line 3\n'
+            '        v.foo()\n'
+            '        ^\n'
+            "CompileError: sorted set method not implemented\n")
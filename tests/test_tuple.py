@@ -1,8 +1,56 @@
+from mys.transpiler import Features
+from mys.transpiler import Source
+from mys.transpiler import transpile
+
 from .utils import TestCase
 from .utils import build_and_test_module
 
 
+def transpile_features(source):
+    features = Features()
+    transpile([Source(source,
+                      module='foo.lib',
+                      module_hpp='foo/lib.mys.hpp')],
+              features=features)
+
+    return features
+
+
 class Test(TestCase):
 
     def test_tuple(self):
         build_and_test_module('tuple')
+
+    def test_shared_tuples(self):
+        self.assertFalse(
+            transpile_features('def foo(a: (i64, i64)) -> i64:\n'
+                               '    b = a\n'
+                               '    return b[0]\n').shared_tuples)
+        self.assertTrue(
+            transpile_features('def foo(a: (i64, i64)):\n'
+                               '    a[0] = 1\n').shared_tuples)
+        self.assertTrue(
+            transpile_features('def foo(a: (i64, i64)):\n'
+                               '    a[1] += 1\n').shared_tuples)
+        self.assertTrue(
+            transpile_features('def foo(a: (i64, i64), b: (i64, i64)) -> bool:\n'
+                               '    return a is b\n').shared_tuples)
+        self.assertFalse(
+            transpile_features('def foo(a: (i64, i64)) -> bool:\n'
+                               '    return a is None\n').shared_tuples)
+
+    def test_shared_tuples_uses(self):
+        features = transpile_features('def foo(a: (i64, i64), b: (i64, i64)):\n'
+                                      '    a[0] = 1\n'
+                                      '    assert a is not b\n')
+
+        self.assertEqual(features.format_hpp(),
+                         '#pragma once\n'
+                         '\n'
+                         '// Tuples are shared instead of copied, as tuple items '
+                         'are assigned\n'
+                         '// to or tuples are compared with "is" by:\n'
+                         '//   foo.lib:2: a[0] = 1\n'
+                         '//   foo.lib:3: assert a is not b\n'
+                         '#define MYS_SHARED_TUPLES\n')
+        self.assertEqual(Features().format_hpp(), '#pragma once\n\n')
@@ -67,6 +67,8 @@ class Test(TestCase):
             self.run_safe_test_none('test_tuple_acces_none')
             self.run_safe_test_none('test_tuple_unpack_in_for_loop_none_element')
             self.run_safe_test_none('test_string_none')
+            self.run_safe_test_none('test_dict_lookup_slice_of_none_string')
+            self.run_safe_test_none('test_map_list_none')
             self.run_safe_test_none('test_string_len_of_none')
             self.run_safe_test_none('test_compare_dicts_3')
             self.run_safe_test_none('test_dict_acces_none')
@@ -103,6 +105,8 @@ class Test(TestCase):
             self.run_unsafe_test_none('test_tuple_acces_none')
             self.run_unsafe_test_none('test_tuple_unpack_in_for_loop_none_element')
             self.run_unsafe_test_none('test_string_none')
+            self.run_unsafe_test_none('test_dict_lookup_slice_of_none_string')
+            self.run_unsafe_test_none('test_map_list_none')
             self.run_unsafe_test_none('test_string_len_of_none')
             self.run_unsafe_test_none('test_compare_dicts_3')
             self.run_unsafe_test_none('test_dict_acces_none')